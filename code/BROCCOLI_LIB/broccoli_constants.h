@@ -65,6 +65,15 @@
 #define VALID_FILTER_RESPONSES_Y_SEPARABLE_CONVOLUTION_RODS 8
 #define VALID_FILTER_RESPONSES_Z_SEPARABLE_CONVOLUTION_RODS 8
 
+#define SEPARABLE_CONVOLUTION_16KB_512THREADS 0
+#define SEPARABLE_CONVOLUTION_16KB_256THREADS 1
+#define SEPARABLE_CONVOLUTION_GLOBAL_MEMORY 2
+
+#define NONSEPARABLE_CONVOLUTION_32KB_512THREADS 0
+#define NONSEPARABLE_CONVOLUTION_24KB_1024THREADS 1
+#define NONSEPARABLE_CONVOLUTION_32KB_256THREADS 2
+#define NONSEPARABLE_CONVOLUTION_GLOBAL_MEMORY 3
+
 #define NOT_SKULL_STRIPPED 1
 #define SKULL_STRIPPED 0
 
@@ -82,6 +91,31 @@
 #define TWOSAMPLE 0
 #define CORRELATION 1
 
+#define SEARCHLIGHT_PERCEPTRON 0
+#define SEARCHLIGHT_LDA 1
+#define SEARCHLIGHT_RIDGE 2
+
+#define BAYESIAN_MCMC 0
+#define BAYESIAN_VB 1
+
+#define INFOMAX 0
+#define FASTICA 1
+
+#define FASTICA_LOGCOSH 0
+#define FASTICA_CUBE 1
+
+#define NUMBER_OF_ICA_TILE_VOXELS 4096
+#define NUMBER_OF_ICA_COVARIANCE_PARTS 16
+
+#define MCMC_MAX_SEGMENTS 64
+#define NUMBER_OF_MCMC_DIAGNOSTICS 3
+
+// Random streams used by the host, voxel indices (used as streams in the kernels) are always smaller
+#define RANDOM_STREAM_PERMUTATIONS 0x80000000u
+#define RANDOM_STREAM_SIGN_FLIPS 0x80000001u
+#define RANDOM_STREAM_SEARCHLIGHT 0x80000002u
+#define RANDOM_STREAM_ICA 0x80000003u
+
 
 #define UP 0
 #define DOWN 1
@@ -90,6 +124,24 @@
 #define CUSTOM 4
 #define UNDEFINED 5
 
+#define SLICE_TIMING_CUBIC 0
+#define SLICE_TIMING_SINC 1
+#define SLICE_TIMING_PERIODIC_SINC 2
+
+#define NUMBER_OF_VOLUME_STATISTICS 8
+#define STATISTICS_VOXELS 0
+#define STATISTICS_MEAN 1
+#define STATISTICS_VARIANCE 2
+#define STATISTICS_MIN 3
+#define STATISTICS_MAX 4
+#define STATISTICS_CENTER_X 5
+#define STATISTICS_CENTER_Y 6
+#define STATISTICS_CENTER_Z 7
+
+#define MASKING_MEAN 0
+#define MASKING_OTSU 1
+#define MASKING_MIXTURE 2
+
 #define TRANSLATION 0
 #define RIGID 1
 #define AFFINE 2
@@ -97,6 +149,12 @@
 #define NEAREST 0
 #define LINEAR 1
 #define CUBIC 2
+#define SINC 3
+
+#define PHASE_BASED 0
+#define MUTUAL_INFORMATION 1
+
+#define NUMBER_OF_MUTUAL_INFORMATION_BINS 32
 
 #define DO_OVERWRITE 0
 #define NO_OVERWRITE 1
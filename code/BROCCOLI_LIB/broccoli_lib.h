@@ -27,10 +27,12 @@
 #define BROCCOLILIB_H
 
 #include "broccoli_constants.h"
+#include "../Kernels/kernelRandom.h"
 
 #include <opencl.h>
 #include <string>
 #include <vector>
+#include <map>
 #include <Dense>
 
 typedef unsigned int uint;
@@ -123,11 +125,18 @@ class BROCCOLI_LIB
 		void SetVerbose(bool verbos);
 		void SetWrapper(int wrapper);
 		void SetAllocatedHostMemory(size_t allocated);
+		void SetDeviceMemoryBudget(size_t budget);
+		void SetCompactVoxelLayout(bool compact);
+		void SetAutoTuning(bool tune);
+		void SetDeviceMemoryLimit(size_t limit);
+		void SetCheckMutualInformationGradient(bool check);
 
 		void SetMask(float* input);
 		void SetEPIMask(float* input);
 		void SetSmoothedEPIMask(float* input);
 		void SetAutoMask(bool);
+		void SetMaskingMethod(int method);
+		void SetMaskClosingIterations(int iterations);
 
 		// Statistics
 		void SetTemporalDerivatives(size_t TD);
@@ -148,11 +157,22 @@ class BROCCOLI_LIB
 		void SetNumberOfContrasts(size_t NC);
 		void SetDesignMatrix(float* X_GLM, float* xtxxt_GLM);
         void SetCorrectClasses(float* C, float *D);
+		void SetSearchlightClassifier(int classifier);
+		void SetSearchlightRadius(float radius);
+		void SetSearchlightFolds(int folds);
+		void SetSearchlightRegularization(float regularization);
+		void SetSearchlightBlocks(float* blocks);
+		void SetRandomSeed(unsigned int seed);
 		void SetContrasts(float* contrasts);
 		void SetGLMScalars(float* ctxtxc);
 		void SetNumberOfPermutations(size_t);
 		void SetNumberOfGroupPermutations(size_t*);
 		void SetNumberOfMCMCIterations(int);
+		void SetNumberOfMCMCChains(int);
+		void SetMCMCConvergenceCriteria(float rhat, float ess);
+		void SetBayesianAROrder(int);
+		void SetBayesianInference(int method);
+		void SetNumberOfVBIterations(int);
 		void SetBetaSpace(int space);
 		void SetStatisticalTest(int test);
 		void SetGroupDesigns(int *designs);
@@ -168,6 +188,9 @@ class BROCCOLI_LIB
 		void SetCustomReferenceSlice(int);
 		void SetNumberOfICAComponents(int);
 		void SetVarianceToSaveBeforeICA(double);
+		void SetICAAlgorithm(int);
+		void SetFastICANonlinearity(int);
+		void SetNumberOfICASubjectComponents(int);
 		void SetZScore(bool);
 
 		// Smoothing
@@ -193,6 +216,7 @@ class BROCCOLI_LIB
 		void SetNumberOfIterationsForNonLinearImageRegistration(int N);
 		void SetNumberOfIterationsForMotionCorrection(int N);
 		void SetChangeMotionCorrectionReferenceVolume(bool);
+		void SetMotionCorrectionTwoPass(bool);
 		void SetMotionCorrectionReferenceVolume(float*);
 		void SetApplyMotionCorrection(bool);
 		void SetCoarsestScaleT1MNI(int N);
@@ -200,6 +224,7 @@ class BROCCOLI_LIB
 		void SetMMT1ZCUT(int mm);
 		void SetMMEPIZCUT(int mm);
 		void SetInterpolationMode(int mode);
+		void SetLinearRegistrationCostEPIT1(int cost);
 		void SetTsigma(float);
 		void SetEsigma(float);
 		void SetDsigma(float);
@@ -208,6 +233,9 @@ class BROCCOLI_LIB
 
 		// Slice timing
 		void SetCustomSliceTimes(float *times);
+		void SetSliceTimingInterpolation(int mode);
+		void SetSliceTimingSincHalfWidth(int halfWidth);
+		void SetMultibandFactor(int factor);
 		void SetApplySliceTimingCorrection(bool);
 
 		// EPI data
@@ -285,6 +313,10 @@ class BROCCOLI_LIB
 		void SetOutputPValuesMNI(float* output);
 		void SetOutputEPIMask(float*);
 		void SetOutputMNIMask(float*);
+		void SetOutputGroupICAMaps(float*);
+		void SetOutputSubjectICAMaps(float*);
+		void SetOutputSubjectICATimeCourses(float*);
+		void SetOutputSubjectICAZMaps(float*);
 		void SetOutputClusterIndices(int*);
 		void SetOutputLargestCluster(int*);
 		void SetOutputDesignMatrix(float* X_GLM, float* xtxxt_GLM);
@@ -321,6 +353,8 @@ class BROCCOLI_LIB
 		void SetOutputPermutedfMRIVolumes(float*);
 		void SetOutputPermutedFirstLevelResults(float*);
 		void SetOutputAREstimatesEPI(float*, float*, float*, float*);
+		void SetOutputMCMCDiagnosticsEPI(float*);
+		void SetOutputPosteriorVariancesEPI(float*);
 		void SetOutputAREstimatesT1(float*, float*, float*, float*);
 		void SetOutputAREstimatesMNI(float*, float*, float*, float*);
 		void SetOutputSliceSums(float*);
@@ -358,6 +392,7 @@ class BROCCOLI_LIB
 
 		bool GetOpenCLInitiated();
 		int GetNumberOfOpenCLKernels();		
+		bool GetMutualInformationGradientCorrect();
 
 		// EPI data
 		float GetEPIVoxelSizeX();
@@ -437,6 +472,9 @@ class BROCCOLI_LIB
 		void TransformVolumesNonLinearWrapper();
 		void TransformVolumesLinearWrapper();
 		void CenterVolumesWrapper();
+		void StartBatchedTransformation(bool NONLINEAR);
+		void TransformVolumesBatchedWrapper();
+		void StopBatchedTransformation();
 		void PerformSliceTimingCorrectionWrapper();
 		void PerformMotionCorrectionWrapper();
 		void PerformSmoothingWrapper();
@@ -449,6 +487,7 @@ class BROCCOLI_LIB
 		void PerformGLMTTestFirstLevelPermutationWrapper();
 		void PerformGLMFTestFirstLevelPermutationWrapper();
         void PerformSearchlightWrapper();
+        void PerformSearchlightPermutationWrapper();
 		void PerformMeanSecondLevelPermutationWrapper();
 		void PerformGLMTTestSecondLevelPermutationWrapper();
 		void PerformGLMFTestSecondLevelPermutationWrapper();
@@ -460,9 +499,17 @@ class BROCCOLI_LIB
 		void PerformICADoubleWrapper();
 		void PerformICACPUWrapper();
 		void PerformICADoubleCPUWrapper();
+		void PerformGroupICASubjectReductionCPUWrapper();
+		void PerformGroupICACPUWrapper();
+		void PerformGroupICADualRegressionCPUWrapper();
+		void PerformGroupICADualRegressionWrapper();
 
 		void GetOpenCLInfo();
 		void GetBandwidth();
+		void TuneWorkGroupSizes();
+		void TrimDeviceMemoryPool();
+		void PrintDeviceMemoryPoolReport();
+		bool RunBenchmarks(const char* filename, int* h_Sizes, int numberOfSizes, int DATA_T, int* h_Regressors, int numberOfRegressors, int* h_Work_Group_Sizes, int numberOfWorkGroupSizes, int repetitions);
 
 		bool OpenCLInitiate(cl_uint OPENCL_PLATFORM, cl_uint OPENCL_DEVICE);
 
@@ -488,10 +535,15 @@ class BROCCOLI_LIB
 		void PerformRegistrationT1MNINoSkullstrip();
 		void SegmentEPIData();
 		void SegmentEPIData(cl_mem Volume);
-		void PerformSliceTimingCorrection();
+		void CreateBrainMask(cl_mem d_Mask, cl_mem d_Volume, int DATA_W, int DATA_H, int DATA_D, float VOXEL_SIZE_X, float VOXEL_SIZE_Y, float VOXEL_SIZE_Z);
 		void PerformSliceTimingCorrectionHost(float* h_Volumes);
+		void CalculateSliceTimingDifferences();
+		void CalculateSliceTimingGroups();
+		void CalculateSliceTimingPeriodicSincFilters(float* h_Filters, int FILTER_LENGTH);
+		void PerformSliceTimingCorrectionSlabs(float* h_Volumes);
 		void PerformMotionCorrection(cl_mem Volumes);
 		void PerformMotionCorrectionHost(float* h_Volumes);
+		void CreateMotionCorrectionTemplate(cl_mem d_Template, float* h_Volumes, size_t startVolume);
 
 		void PerformRegression(cl_mem, cl_mem, size_t, size_t, size_t, size_t);
 		void PerformRegressionSlice(cl_mem, cl_mem, size_t, size_t, size_t, size_t, size_t);
@@ -504,16 +556,34 @@ class BROCCOLI_LIB
 		void CalculateBetaWeightsAndContrastsFirstLevelSlices(float* h_Volumes);
 		cl_int CalculateStatisticalMapsGLMTTestFirstLevel(float *h_Volumes, int iterations);
 		void CalculateStatisticalMapsGLMTTestFirstLevelSlices(float* h_Volumes, int iterations);
+		cl_int CalculateStatisticalMapsGLMTTestFirstLevelChunks(float* h_Volumes, int iterations);
 		void CalculateStatisticalMapsGLMFTestFirstLevel(float *h_Volumes, int iterations);
 		void CalculateStatisticalMapsGLMFTestFirstLevelSlices(float* h_Volumes, int iterations);
 		void CalculateStatisticalMapsGLMTTestSecondLevel(cl_mem Volumes, cl_mem Mask);
 		void CalculateStatisticalMapsGLMFTestSecondLevel(cl_mem Volumes, cl_mem Mask);
 
 		void CalculateStatisticalMapsGLMBayesianFirstLevel(float* h_Volumes);
+		void CalculateStatisticalMapsGLMBayesianVBFirstLevel(float* h_Volumes);
+
+		int CalculateSearchlightOffsets(int* h_Offsets, float RADIUS);
+		int CalculateSearchlightFolds(int* h_Fold_Boundaries, float* h_Classes, int NUMBER_OF_VOLUMES, int NUMBER_OF_FOLDS);
+		bool SearchlightLinearSetup(cl_mem d_Mask, int DATA_W, int DATA_H, int DATA_D, int NUMBER_OF_PERMUTATIONS_PER_RUN);
+		void CalculateStatisticalMapSearchlightLinear(cl_mem d_Classifier_Performance, cl_mem d_Volumes, cl_mem d_Classes, cl_mem d_d_Values, int DATA_W, int DATA_H, int DATA_D, int NUMBER_OF_VOLUMES, int NUMBER_OF_PERMUTATIONS_IN_RUN, bool WRITE_PERFORMANCE);
+		void SearchlightLinearCleanup();
+		void CalculateStatisticalMapSearchlightPerceptron(cl_mem d_Classifier_Performance, cl_mem d_Max_Performance, cl_mem d_Volumes, cl_mem d_Mask, cl_mem d_Classes, cl_mem d_d_Values, int DATA_W, int DATA_H, int DATA_D, int NUMBER_OF_VOLUMES, int NUMBER_OF_PERMUTATIONS_IN_RUN, bool WRITE_PERFORMANCE);
+		void GeneratePermutedClassesSearchlight(float* h_Permuted_Classes, float* h_Permuted_d, int NUMBER_OF_VOLUMES);
+		void ApplyPermutationTestSearchlight(cl_mem d_Volumes, cl_mem d_Mask, int DATA_W, int DATA_H, int DATA_D, int NUMBER_OF_VOLUMES);
 
 		void CalculateNumberOfBrainVoxels(cl_mem d_Mask, size_t DATA_W, size_t DATA_H, size_t DATA_D);
 		void CreateVoxelNumbers(cl_mem d_Voxel_Numbers, cl_mem d_Mask, size_t DATA_W, size_t DATA_H, size_t DATA_D);
 		void CreateVoxelNumbersSlice(cl_mem d_Voxel_Numbers, cl_mem d_Mask, size_t slice, size_t DATA_W, size_t DATA_H, size_t DATA_D);
+		size_t CreateVoxelIndices(int* h_Voxel_Indices, cl_mem d_Mask, size_t DATA_W, size_t DATA_H, size_t DATA_D);
+		size_t GetDeviceMemoryBudget();
+		size_t CalculateVoxelChunkSize(size_t DATA_T, size_t NUMBER_OF_REGRESSORS, size_t NUMBER_OF_CONTRASTS);
+		void GatherVoxelChunk(float* h_Chunk, float* h_Volumes, int* h_Voxel_Indices, size_t firstVoxel, size_t NUMBER_OF_VOXELS, size_t VOLUME_SIZE, size_t DATA_T);
+		cl_int UploadVoxelChunk(cl_command_queue queue, cl_mem d_Chunk, float* h_Chunk, float* h_Volumes, int* h_Voxel_Indices, size_t firstVoxel, size_t NUMBER_OF_VOXELS, size_t VOLUME_SIZE, size_t DATA_T, cl_event* event);
+		void ScatterVoxelValues(cl_mem d_Volumes, cl_mem d_Values, cl_mem d_Voxel_Indices, size_t NUMBER_OF_VOXELS, size_t VOLUME_SIZE, size_t NUMBER_OF_VOLUMES);
+		void GatherVoxelValues(cl_mem d_Values, cl_mem d_Volumes, cl_mem d_Voxel_Indices, size_t NUMBER_OF_VOXELS, size_t VOLUME_SIZE, size_t NUMBER_OF_VOLUMES);
 
 		void WhitenDesignMatricesInverse(cl_mem d_xtxxt_GLM, float* h_X_GLM, cl_mem d_AR1_Estimates, cl_mem d_AR2_Estimates, cl_mem d_AR3_Estimates, cl_mem d_AR4_Estimates, cl_mem d_Mask, cl_mem d_Voxel_Numbers, size_t DATA_W, size_t DATA_H, size_t DATA_D, size_t DATA_T, size_t NUMBER_OF_REGRESSORS, size_t NUMBER_OF_INVALID_TIMEPOINTS);
 		void WhitenDesignMatricesInverseSlice(cl_mem d_xtxxt_GLM, float* h_X_GLM, cl_mem d_AR1_Estimates, cl_mem d_AR2_Estimates, cl_mem d_AR3_Estimates, cl_mem d_AR4_Estimates, cl_mem d_Mask, cl_mem d_Voxel_Numbers, size_t slice, size_t DATA_W, size_t DATA_H, size_t DATA_D, size_t DATA_T, size_t NUMBER_OF_REGRESSORS, size_t NUMBER_OF_INVALID_TIMEPOINTS);
@@ -521,6 +591,8 @@ class BROCCOLI_LIB
 		void WhitenDesignMatricesTTestSlice(cl_mem d_xtxxt_GLM, cl_mem d_GLM_Scalars, float* h_X_GLM, float* h_Contrasts, cl_mem d_AR1_Estimates, cl_mem d_AR2_Estimates, cl_mem d_AR3_Estimates, cl_mem d_AR4_Estimates, cl_mem d_Mask, cl_mem d_Voxel_Numbers, size_t slice, size_t EPI_DATA_W, size_t EPI_DATA_H, size_t DATA_D, size_t EPI_DATA_T, size_t NUMBER_OF_GLM_REGRESSORS, size_t NUMBER_OF_INVALID_TIMEPOINTS, size_t NUMBER_OF_CONTRASTS);
 		void WhitenDesignMatricesFTest(cl_mem d_xtxxt_GLM, cl_mem d_GLM_Scalars, float* h_X_GLM, float* h_Contrasts, cl_mem d_AR1_Estimates, cl_mem d_AR2_Estimates, cl_mem d_AR3_Estimates, cl_mem d_AR4_Estimates, cl_mem d_Mask, cl_mem d_Voxel_Numbers, size_t EPI_DATA_W, size_t EPI_DATA_H, size_t EPI_DATA_D, size_t EPI_DATA_T, size_t NUMBER_OF_GLM_REGRESSORS, size_t NUMBER_OF_INVALID_TIMEPOINTS, size_t NUMBER_OF_CONTRASTS);
 		void WhitenDesignMatricesFTestSlice(cl_mem d_xtxxt_GLM, cl_mem d_GLM_Scalars, float* h_X_GLM, float* h_Contrasts, cl_mem d_AR1_Estimates, cl_mem d_AR2_Estimates, cl_mem d_AR3_Estimates, cl_mem d_AR4_Estimates, cl_mem d_Mask, cl_mem d_Voxel_Numbers, size_t slice, size_t EPI_DATA_W, size_t EPI_DATA_H, size_t EPI_DATA_D, size_t EPI_DATA_T, size_t NUMBER_OF_GLM_REGRESSORS, size_t NUMBER_OF_INVALID_TIMEPOINTS, size_t NUMBER_OF_CONTRASTS);
+		void WhitenDesignMatricesInverseChunk(cl_mem d_xtxxt_GLM, float* h_X_GLM, float* h_AR1_Estimates, float* h_AR2_Estimates, float* h_AR3_Estimates, float* h_AR4_Estimates, size_t NUMBER_OF_VOXELS, size_t DATA_T, size_t NUMBER_OF_REGRESSORS, size_t NUMBER_OF_INVALID_TIMEPOINTS);
+		void WhitenDesignMatricesTTestChunk(cl_mem d_X_GLM, cl_mem d_GLM_Scalars, float* h_X_GLM, float* h_Contrasts, float* h_AR1_Estimates, float* h_AR2_Estimates, float* h_AR3_Estimates, float* h_AR4_Estimates, size_t NUMBER_OF_VOXELS, size_t DATA_T, size_t NUMBER_OF_REGRESSORS, size_t NUMBER_OF_INVALID_TIMEPOINTS, size_t NUMBER_OF_CONTRASTS);
 		
 		void PutWhitenedModelsIntoVolumes(cl_mem d_Mask, cl_mem d_xtxxt_GLM, size_t DATA_W, size_t DATA_H, size_t DATA_D, size_t DATA_T, size_t NUMBER_OF_REGRESSORS);
 		void PutWhitenedModelsIntoVolumes2(cl_mem d_Mask, cl_mem d_AR1_Estimates, cl_mem d_AR2_Estimates, cl_mem d_AR3_Estimates, cl_mem d_AR4_Estimates, float* Regressors, size_t DATA_W, size_t DATA_H, size_t DATA_D, size_t DATA_T, size_t NUMBER_OF_REGRESSORS);
@@ -538,6 +610,10 @@ class BROCCOLI_LIB
 		void CalculateStatisticalMapsFirstLevelPermutation(int contrast);
 		void CalculateStatisticalMapsGLMTTestFirstLevelPermutation(int contrast);
 		void CalculateStatisticalMapsGLMFTestFirstLevelPermutation();
+		void SetupPermutationTestFirstLevelCompact(cl_mem Whitened_Volumes);
+		void CleanupPermutationTestFirstLevelCompact();
+		void GeneratePermutedVolumesFirstLevelCompact(int permutation);
+		void CalculateStatisticalMapsGLMTTestFirstLevelPermutationCompact(int contrast);
 
 		// Permutation second level
 		void SetupPermutationTestSecondLevel(cl_mem Volumes, cl_mem Mask);
@@ -576,13 +652,30 @@ class BROCCOLI_LIB
 		void PCADimensionalityReductionEigen(Eigen::MatrixXd &, Eigen::MatrixXd &, int, bool);
 		void InfomaxICAEigen(Eigen::MatrixXd & whitenedData, Eigen::MatrixXd & weights, Eigen::MatrixXd & sourceMatrix);
 		void InfomaxICAEigen(Eigen::MatrixXf & whitenedData, Eigen::MatrixXf & weights, Eigen::MatrixXf & sourceMatrix);
-		int UpdateInfomaxWeightsEigen(Eigen::MatrixXd & weights, Eigen::MatrixXd & whitenedData, Eigen::MatrixXd & bias, Eigen::MatrixXd & shuffledWhitenedData, double updateRate);
-		int UpdateInfomaxWeightsEigen(Eigen::MatrixXf & weights, Eigen::MatrixXf & whitenedData, Eigen::MatrixXf & bias, Eigen::MatrixXf & shuffledWhitenedData, double updateRate);
+		std::vector<size_t> GetICAMaskVoxels();
+		void GetICADataTile(Eigen::MatrixXf & tile, std::vector<size_t> & voxels, size_t firstVoxel);
+		Eigen::MatrixXf CalculateICACovarianceMatrix(std::vector<size_t> & voxels);
+		Eigen::MatrixXf CalculateICACovarianceMatrixOpenCL(std::vector<size_t> & voxels);
+		Eigen::MatrixXf CalculateICAWhiteningMatrix(Eigen::MatrixXf & covarianceMatrix);
+		Eigen::MatrixXf WhitenICADataTiles(std::vector<size_t> & voxels, Eigen::MatrixXf & covarianceMatrix);
+		Eigen::MatrixXf PCAWhitenTilesEigen();
+		Eigen::MatrixXf PCAWhitenTiles();
+		void PutICAComponentsIntoVolumes(float* h_Volumes, Eigen::MatrixXf & components);
+		void FastICAEigen(Eigen::MatrixXd & whitenedData, Eigen::MatrixXd & weights, Eigen::MatrixXd & sourceMatrix);
+		void FastICAEigen(Eigen::MatrixXf & whitenedData, Eigen::MatrixXf & weights, Eigen::MatrixXf & sourceMatrix);
+		void FastICANonlinearityEigen(Eigen::MatrixXd & unmixed, Eigen::MatrixXd & derivatives);
+		void FastICANonlinearityEigen(Eigen::MatrixXf & unmixed, Eigen::MatrixXf & derivatives);
+		void InitializeFastICAWeights(Eigen::MatrixXd & weights);
+		void SymmetricDecorrelation(Eigen::MatrixXd & weights);
+		double FastICAStep(Eigen::MatrixXd & weights, Eigen::MatrixXd & expectedProducts, Eigen::VectorXd & expectedDerivatives);
+		int UpdateInfomaxWeightsEigen(Eigen::MatrixXd & weights, Eigen::MatrixXd & whitenedData, Eigen::MatrixXd & bias, std::vector<int> & perm, Eigen::MatrixXd & subWhitenedData, Eigen::MatrixXd & unmixed, Eigen::MatrixXd & unmLogit, Eigen::MatrixXd & partialProducts, Eigen::MatrixXd & partialBias, double updateRate);
+		int UpdateInfomaxWeightsEigen(Eigen::MatrixXf & weights, Eigen::MatrixXf & whitenedData, Eigen::MatrixXf & bias, std::vector<int> & perm, Eigen::MatrixXf & subWhitenedData, Eigen::MatrixXf & unmixed, Eigen::MatrixXf & unmLogit, Eigen::MatrixXf & partialProducts, Eigen::MatrixXf & partialBias, double updateRate);
 
 		void PCAWhiten(Eigen::MatrixXd &, Eigen::MatrixXd &, int, bool);
-		Eigen::MatrixXf PCAWhiten(Eigen::MatrixXf &, bool);
 		void InfomaxICA(Eigen::MatrixXf & whitenedData, Eigen::MatrixXf & weights, Eigen::MatrixXf & sourceMatrix);
 		void InfomaxICADouble(Eigen::MatrixXd & whitenedData, Eigen::MatrixXd & weights, Eigen::MatrixXd & sourceMatrix);
+		void FastICA(Eigen::MatrixXf & whitenedData, Eigen::MatrixXf & weights, Eigen::MatrixXf & sourceMatrix);
+		void FastICADouble(Eigen::MatrixXd & whitenedData, Eigen::MatrixXd & weights, Eigen::MatrixXd & sourceMatrix);
 		int UpdateInfomaxWeights(cl_mem d_Weights, cl_mem d_Whitened_Data, cl_mem d_Bias, cl_mem d_Permutation, cl_mem d_Shuffled_Whitened_Data, double updateRate);
 		int UpdateInfomaxWeightsDouble(cl_mem d_Weights, cl_mem d_Whitened_Data, cl_mem d_Bias, cl_mem d_Permutation, cl_mem d_Shuffled_Whitened_Data, double updateRate);
 
@@ -606,8 +699,18 @@ class BROCCOLI_LIB
 
 		void AlignTwoVolumesLinearSetup(int DATA_W, int DATA_H, int DATA_D);
 		void AlignTwoVolumesLinear(float* h_Registration_Parameters, float* h_Rotations, int DATA_W, int DATA_H, int DATA_D, int NUMBER_OF_ITERATIONS, int ALIGNMENT_TYPE, int INTERPOLATION_MODE);
+		void AlignTwoVolumesLinear(float* h_Registration_Parameters, float* h_Rotations, int DATA_W, int DATA_H, int DATA_D, int NUMBER_OF_ITERATIONS, int ALIGNMENT_TYPE, int INTERPOLATION_MODE, int COST);
+		void AlignTwoVolumesLinearMutualInformation(float* h_Registration_Parameters, float* h_Rotations, int DATA_W, int DATA_H, int DATA_D, int NUMBER_OF_ITERATIONS, int ALIGNMENT_TYPE, int INTERPOLATION_MODE);
+		float CalculateNormalizedMutualInformation(float* h_Histogram_Derivatives, unsigned int* h_Joint_Histogram, int NUMBER_OF_BINS);
+		bool CheckMutualInformationGradient(float* h_Analytic_Gradient, float* h_Parameters, cl_mem d_Joint_Histogram, unsigned int* h_Joint_Histogram, int NUMBER_OF_BINS, int INTERPOLATION_MODE);
 		void AlignTwoVolumesLinearSeveralScales(float *h_Registration_Parameters, float* h_Rotations, cl_mem d_Al_Volume, cl_mem d_Ref_Volume, int DATA_W, int DATA_H, int DATA_D, int NUMBER_OF_SCALES, int NUMBER_OF_ITERATIONS, int ALIGNMENT_TYPE, int OVERWRITE, int INTERPOLATION_MODE);
+		void AlignTwoVolumesLinearSeveralScales(float *h_Registration_Parameters, float* h_Rotations, cl_mem d_Al_Volume, cl_mem d_Ref_Volume, int DATA_W, int DATA_H, int DATA_D, int NUMBER_OF_SCALES, int NUMBER_OF_ITERATIONS, int ALIGNMENT_TYPE, int OVERWRITE, int INTERPOLATION_MODE, int COST);
 		void AlignTwoVolumesLinearCleanup(int DATA_W, int DATA_H, int DATA_D);
+		void CalculateReferenceFilterResponsesLinear(int DATA_W, int DATA_H, int DATA_D);
+		void ReferenceVolumeChanged();
+		void StartReferenceFilterResponseCache();
+		void SetCachedReferenceFilterResponsesLinear(int SCALE, int DATA_W, int DATA_H, int DATA_D);
+		void StopReferenceFilterResponseCache();
 
 		void AlignTwoVolumesNonLinearSetup(int DATA_W, int DATA_H, int DATA_D);
 		void AlignTwoVolumesNonLinear(int DATA_W, int DATA_H, int DATA_D, int NUMBER_OF_ITERATIONS, int INTERPOLATION_MODE);
@@ -619,8 +722,22 @@ class BROCCOLI_LIB
 		void ChangeVolumesResolutionAndSize(cl_mem d_New_Volumes, cl_mem d_Volumes, int DATA_W, int DATA_H, int DATA_D, int NUMBER_OF_VOLUMES, int NEW_DATA_W, int NEW_DATA_H, int NEW_DATA_D, float VOXEL_SIZE_X, float VOXEL_SIZE_Y, float VOXEL_SIZE_Z, float NEW_VOXEL_SIZE_X, float NEW_VOXEL_SIZE_Y, float NEW_VOXEL_SIZE_Z, int MM_Z_CUT, int INTERPOLATION_MODE, int offset);
 		void CalculateTensorMagnitude(cl_mem d_Tensor_Magnitudes, cl_mem d_Volume, int DATA_W, int DATA_H, int DATA_D);
 
+		void CalculateBSplineCoefficients(cl_mem d_Volume, int DATA_W, int DATA_H, int DATA_D);
+		void CopyVolumeToInterpolationTexture(cl_mem d_Texture, cl_mem d_Volumes, size_t offset, int DATA_W, int DATA_H, int DATA_D, int INTERPOLATION_MODE);
 		void TransformVolumesLinear(cl_mem d_Volumes, float* h_Registration_Parameters, int DATA_W, int DATA_H, int DATA_D, int NUMBER_OF_VOLUMES, int INTERPOLATION_MODE);
 		void TransformVolumesNonLinear(cl_mem d_Volumes, cl_mem d_Displacement_Field_X, cl_mem d_Displacement_Field_Y, cl_mem d_Displacement_Field_Z, int DATA_W, int DATA_H, int DATA_D, int NUMBER_OF_VOLUMES, int INTERPOLATION_MODE);
+		void CreateComposedSamplingMap(cl_mem d_Sampling_Map_X, cl_mem d_Sampling_Map_Y, cl_mem d_Sampling_Map_Z, float* h_Start_Parameters, float* h_Start_Parameters_Registration, float* h_Registration_Parameters, int NEW_DATA_W, int NEW_DATA_H, int NEW_DATA_D, float NEW_VOXEL_SIZE_X, float NEW_VOXEL_SIZE_Y, float NEW_VOXEL_SIZE_Z, bool DISPLACEMENT_FIELD);
+		void CreateComposedSamplingMapEPIMNI();
+		void ReleaseComposedSamplingMapEPIMNI();
+		void CreateComposedSamplingMapEPIT1();
+		void ReleaseComposedSamplingMapEPIT1();
+		void ReleaseBatchedTransformationInput();
+		void TransformVolumesComposed(cl_mem d_New_Volumes, cl_mem d_EPI_Volumes, cl_mem d_Sampling_Map_X, cl_mem d_Sampling_Map_Y, cl_mem d_Sampling_Map_Z, int NEW_DATA_W, int NEW_DATA_H, int NEW_DATA_D, int START_VOLUME, int NUMBER_OF_VOLUMES, int INTERPOLATION_MODE);
+		void TransformVolumesEPIMNIComposed(cl_mem d_MNI_Volumes, cl_mem d_EPI_Volumes, int START_VOLUME, int NUMBER_OF_VOLUMES, int INTERPOLATION_MODE);
+		void TransformDeviceVolumesEPIMNIComposed(float* h_MNI_Volumes, cl_mem d_EPI_Volumes, int NUMBER_OF_VOLUMES, int INTERPOLATION_MODE);
+		void TransformHostVolumesEPIMNIComposed(float* h_MNI_Volumes, float* h_EPI_Volumes, int NUMBER_OF_VOLUMES, int INTERPOLATION_MODE);
+		void TransformDeviceVolumesEPIT1Composed(float* h_T1_Volumes, cl_mem d_EPI_Volumes, int NUMBER_OF_VOLUMES, int INTERPOLATION_MODE);
+		int GetComposedTransformBatchSize(int NUMBER_OF_VOLUMES, size_t NEW_VOLUME_SIZE);
 		void TransformFirstLevelResultsToMNI(bool WHITENED);
 		void TransformResidualsToMNI();
 		void TransformfMRIVolumesToMNI();
@@ -665,6 +782,10 @@ class BROCCOLI_LIB
 		void SubtractArraysDouble(cl_mem d_Array_1, cl_mem d_Array_2, size_t N);
 		void LogitMatrix(cl_mem d_Array, size_t N);
 		void LogitMatrixDouble(cl_mem d_Array, size_t N);
+		void FastICANonlinearity(cl_mem d_Array, cl_mem d_Derivatives, size_t N);
+		void FastICANonlinearityDouble(cl_mem d_Array, cl_mem d_Derivatives, size_t N);
+		void TransformTToZ(cl_mem d_Statistical_Maps, cl_mem d_Mask, int DATA_W, int DATA_H, int DATA_D, int NUMBER_OF_MAPS, float degreesOfFreedom);
+		float TransformTToZ(float t, float degreesOfFreedom);
 		void AddVolume(cl_mem d_Volume, float value, size_t DATA_W, size_t DATA_H, size_t DATA_D);
 		void AddVolumes(cl_mem d_Volume_1, cl_mem d_Volume_2, size_t DATA_W, size_t DATA_H, size_t DATA_D);
 		void AddVolumes(cl_mem d_Result, cl_mem d_Volume_1, cl_mem d_Volume_2, size_t DATA_W, size_t DATA_H, size_t DATA_D);
@@ -675,10 +796,26 @@ class BROCCOLI_LIB
 
 		float CalculateMaxAtomic(cl_mem Array, size_t N);
 		float CalculateMaxAtomic(cl_mem Volume, cl_mem Mask, size_t DATA_W, size_t DATA_H, size_t DATA_D);
+		float CalculateMaxAtomicCompact(cl_mem Values, size_t NUMBER_OF_VOXELS);
+
+		void CalculateVolumeStatistics(cl_mem d_Statistics, cl_mem d_Histogram, int NUMBER_OF_BINS, cl_mem d_Volume, cl_mem d_Mask, int DATA_W, int DATA_H, int DATA_D);
+		void CalculateVolumeStatistics(float* h_Statistics, unsigned int* h_Histogram, int NUMBER_OF_BINS, cl_mem d_Volume, cl_mem d_Mask, int DATA_W, int DATA_H, int DATA_D);
+		float CalculatePercentile(unsigned int* h_Histogram, int NUMBER_OF_BINS, float minValue, float maxValue, float fraction);
+		void NormalizeVolumeIntensity(cl_mem d_Volume, cl_mem d_Mask, int DATA_W, int DATA_H, int DATA_D);
+		void CalculateRobustIntensityRange(cl_mem d_Statistics, cl_mem d_Volume, int DATA_W, int DATA_H, int DATA_D);
+
+		double TimeKernel(cl_kernel kernel, cl_uint dimensions, size_t* globalWorkSize, size_t* localWorkSize, int repetitions, double& latency);
+		void WriteBenchmarkResult(FILE* file, const char* name, size_t DATA_W, size_t DATA_H, size_t DATA_D, size_t DATA_T, size_t NUMBER_OF_VOXELS, size_t NUMBER_OF_REGRESSORS, size_t workGroupSize, double time, double latency, double bytes, double flops);
 		float CalculateMax(float *data, size_t N);
 		int   CalculateMax(int *data, size_t N);
 		float CalculateMin(float *data, size_t N);
 		void ThresholdVolume(cl_mem d_Thresholded_Volume, cl_mem d_Volume, float threshold, int DATA_W, int DATA_H, int DATA_D);
+		float CalculateBrainMaskThreshold(cl_mem d_Volume, int DATA_W, int DATA_H, int DATA_D);
+		float CalculateOtsuThreshold(unsigned int* h_Histogram, int NUMBER_OF_BINS);
+		float CalculateMixtureThreshold(unsigned int* h_Histogram, int NUMBER_OF_BINS);
+		void KeepLargestCluster(cl_mem d_Mask, cl_mem d_Volume, float threshold, int DATA_W, int DATA_H, int DATA_D);
+		void CloseMask(cl_mem d_Mask, int ITERATIONS, int DATA_W, int DATA_H, int DATA_D);
+		void FillHolesInMask(cl_mem d_Mask, int DATA_W, int DATA_H, int DATA_D);
 
 
 		void CreateProgramFromBinary(cl_context context, cl_device_id device, std::string filename);
@@ -715,6 +852,12 @@ class BROCCOLI_LIB
 
 		void PrintMemoryStatus(const char* text);
 
+		size_t GetDeviceMemorySizeClass(size_t size);
+		cl_mem AllocateDeviceMemory(size_t size, cl_int* error);
+		void ReleaseDeviceMemory(cl_mem memory);
+		void ReleaseDeviceMemoryPool();
+		void ReleaseGroupICAMapsPseudoInverse();
+
 		//------------------------------------------------
 		// Set functions
 		//------------------------------------------------
@@ -724,9 +867,11 @@ class BROCCOLI_LIB
 		void SetGlobalAndLocalWorkSizesImageRegistration(int DATA_W, int DATA_H, int DATA_D);
 		void SetGlobalAndLocalWorkSizesStatisticalCalculations(int DATA_W, int DATA_H, int DATA_D);
         void SetGlobalAndLocalWorkSizesSearchlight(int DATA_W, int DATA_H, int DATA_D);
+		void SetGlobalAndLocalWorkSizesSearchlightLinear(int NUMBER_OF_VOXELS);
 		void SetGlobalAndLocalWorkSizesInterpolateVolume(int DATA_W, int DATA_H, int DATA_D);
 		void SetGlobalAndLocalWorkSizesCopyVolumeToNew(int DATA_W, int DATA_H, int DATA_D);
 		void SetGlobalAndLocalWorkSizesMemset(int N);
+		void SetGlobalAndLocalWorkSizesChunk(int N);
 		void SetGlobalAndLocalWorkSizesMultiplyVolumes(int DATA_W, int DATA_H, int DATA_D);
 		void SetGlobalAndLocalWorkSizesAddVolumes(int DATA_W, int DATA_H, int DATA_D);
 		void SetGlobalAndLocalWorkSizesCalculateSum(int DATA_W, int DATA_H, int DATA_D);
@@ -734,6 +879,17 @@ class BROCCOLI_LIB
 		void SetGlobalAndLocalWorkSizesThresholdVolume(int DATA_W, int DATA_H, int DATA_D);
 		void SetGlobalAndLocalWorkSizesCalculateMagnitudes(int DATA_W, int DATA_H, int DATA_D);
 		void SetGlobalAndLocalWorkSizesClusterize(int DATA_W, int DATA_H, int DATA_D);
+		void SetGlobalAndLocalWorkSizesBSplinePrefilter(int DATA_W, int DATA_H, int DATA_D);
+		void SetGlobalAndLocalWorkSizesVolumeStatistics(int DATA_W, int DATA_H, int DATA_D);
+
+		bool SeparableConvolutionVariantSupported(int variant);
+		bool NonseparableConvolutionVariantSupported(int variant);
+		bool LocalWorkSizeSupported(size_t* localWorkSize);
+		void SetDefaultWorkGroupSizes();
+		bool LoadTuningFile();
+		bool SaveTuningFile();
+		void CreateConvolutionKernels();
+		void RecreateConvolutionKernels();
 
 		//------------------------------------------------
 		// OpenCL help functions
@@ -770,11 +926,25 @@ class BROCCOLI_LIB
 
 		cl_ulong localMemorySize;
 		size_t globalMemorySize;
+		size_t DEVICE_MEMORY_BUDGET;
+		int NUMBER_OF_BENCHMARK_RESULTS;
+
+		// Device memory pool, cached buffers by size class, and buffers in use with their size class
+		std::multimap<size_t,cl_mem> freeDeviceBuffers;
+		std::map<cl_mem,size_t> usedDeviceBuffers;
+		size_t DEVICE_MEMORY_LIMIT;
+		size_t deviceMemoryPoolSize, deviceMemoryPoolUsed, deviceMemoryPoolPeak, deviceMemoryPoolPeakUsed;
+		size_t deviceMemoryPoolReuses, deviceMemoryPoolCreations, deviceMemoryPoolCacheLimit;
 		size_t maxThreadsPerBlock;
 		size_t maxThreadsPerDimension[3];
 
 		std::string binaryPathAndFilename;
 		std::string binaryFilename;
+		std::string tuningPathAndFilename;
+		bool AUTO_TUNE;
+		bool TUNING_FILE_FOUND;
+		int SEPARABLE_CONVOLUTION_VARIANT;
+		int NONSEPARABLE_CONVOLUTION_VARIANT;
 		std::string deviceInfo;
 		std::string deviceName;
 		std::string platformName;
@@ -867,6 +1037,48 @@ class BROCCOLI_LIB
 		cl_kernel EstimateAR4ModelsKernel, EstimateAR4ModelsSliceKernel, ApplyWhiteningAR4Kernel, ApplyWhiteningAR4SliceKernel, GeneratePermutedVolumesFirstLevelKernel;
 		cl_kernel CalculatePermutationPValuesVoxelLevelInferenceKernel, CalculatePermutationPValuesClusterExtentInferenceKernel, CalculatePermutationPValuesClusterMassInferenceKernel;
 
+		// Chunked GLM kernels
+		cl_kernel CalculateBetaWeightsGLMFirstLevelChunkKernel, CalculateGLMResidualsChunkKernel, CalculateStatisticalMapsGLMTTestFirstLevelChunkKernel, EstimateAR4ModelsChunkKernel, ApplyWhiteningAR4ChunkKernel, ScatterVoxelValuesKernel;
+
+		// Compact voxel layout kernels
+		cl_kernel GatherVoxelValuesKernel, CalculateMaxAtomicCompactKernel, GeneratePermutedVolumesFirstLevelCompactKernel, CalculateStatisticalMapsGLMTTestFirstLevelPermutationCompactKernel;
+
+		// Composed transformation kernels
+		cl_kernel CalculateComposedSamplingMapKernel, InterpolateVolumeNearestComposedKernel, InterpolateVolumeLinearComposedKernel, InterpolateVolumeCubicComposedKernel;
+
+		// Slice timing correction kernels
+		cl_kernel SliceTimingCorrectionCubicVolumesKernel, SliceTimingCorrectionSincVolumesKernel, SliceTimingCorrectionPeriodicSincVolumesKernel;
+
+		// Brain masking kernels
+		cl_kernel InvertMaskKernel, DilateMaskKernel, ErodeMaskKernel, SelectClusterKernel, MarkBorderClustersKernel, FillMaskHolesKernel;
+
+		// B-spline prefiltering and sinc interpolation kernels
+		cl_kernel BSplinePrefilterXKernel, BSplinePrefilterYKernel, BSplinePrefilterZKernel, InterpolateVolumeSincLinearKernel, InterpolateVolumeSincNonLinearKernel;
+
+		// Sinc interpolation with composed sampling map kernels
+		cl_kernel InterpolateVolumeSincComposedKernel;
+
+		// Volume statistics kernels
+		cl_kernel CalculateVolumeStatisticsKernel, ReduceVolumeStatisticsKernel, CalculateVolumeHistogramKernel, NormalizeVolumeIntensityKernel;
+
+		// Mutual information registration kernels
+		cl_kernel CalculateJointHistogramKernel, CalculateMutualInformationGradientKernel;
+
+		// Searchlight kernels
+		cl_kernel CalculateStatisticalMapSearchlightLinearKernel;
+
+		// Bayesian chains kernels
+		cl_kernel CalculateStatisticalMapsGLMBayesianChainsKernel;
+
+		// Bayesian variational kernels
+		cl_kernel CalculateLagProductsBayesianVBKernel, UpdateGLMBayesianVBKernel, CalculateSpatialPriorBayesianVBKernel;
+
+		// FastICA kernels
+		cl_kernel FastICANonlinearityKernel, FastICANonlinearityDoubleKernel;
+
+		// Dual regression kernels
+		cl_kernel TransformTToZKernel;
+
 		// Create kernel errors
 
 		// Help kernels
@@ -941,6 +1153,48 @@ class BROCCOLI_LIB
 		cl_int createKernelErrorRemoveLinearFit, createKernelErrorRemoveLinearFitSlice;
 		cl_int createKernelErrorCalculatePermutationPValuesVoxelLevelInference, createKernelErrorCalculatePermutationPValuesClusterExtentInference, createKernelErrorCalculatePermutationPValuesClusterMassInference;
 
+		// Chunked GLM kernels
+		cl_int createKernelErrorCalculateBetaWeightsGLMFirstLevelChunk, createKernelErrorCalculateGLMResidualsChunk, createKernelErrorCalculateStatisticalMapsGLMTTestFirstLevelChunk, createKernelErrorEstimateAR4ModelsChunk, createKernelErrorApplyWhiteningAR4Chunk, createKernelErrorScatterVoxelValues;
+
+		// Compact voxel layout kernels
+		cl_int createKernelErrorGatherVoxelValues, createKernelErrorCalculateMaxAtomicCompact, createKernelErrorGeneratePermutedVolumesFirstLevelCompact, createKernelErrorCalculateStatisticalMapsGLMTTestFirstLevelPermutationCompact;
+
+		// Composed transformation kernels
+		cl_int createKernelErrorCalculateComposedSamplingMap, createKernelErrorInterpolateVolumeNearestComposed, createKernelErrorInterpolateVolumeLinearComposed, createKernelErrorInterpolateVolumeCubicComposed;
+
+		// Slice timing correction kernels
+		cl_int createKernelErrorSliceTimingCorrectionCubicVolumes, createKernelErrorSliceTimingCorrectionSincVolumes, createKernelErrorSliceTimingCorrectionPeriodicSincVolumes;
+
+		// Brain masking kernels
+		cl_int createKernelErrorInvertMask, createKernelErrorDilateMask, createKernelErrorErodeMask, createKernelErrorSelectCluster, createKernelErrorMarkBorderClusters, createKernelErrorFillMaskHoles;
+
+		// B-spline prefiltering and sinc interpolation kernels
+		cl_int createKernelErrorBSplinePrefilterX, createKernelErrorBSplinePrefilterY, createKernelErrorBSplinePrefilterZ, createKernelErrorInterpolateVolumeSincLinear, createKernelErrorInterpolateVolumeSincNonLinear;
+
+		// Sinc interpolation with composed sampling map kernels
+		cl_int createKernelErrorInterpolateVolumeSincComposed;
+
+		// Volume statistics kernels
+		cl_int createKernelErrorCalculateVolumeStatistics, createKernelErrorReduceVolumeStatistics, createKernelErrorCalculateVolumeHistogram, createKernelErrorNormalizeVolumeIntensity;
+
+		// Mutual information registration kernels
+		cl_int createKernelErrorCalculateJointHistogram, createKernelErrorCalculateMutualInformationGradient;
+
+		// Searchlight kernels
+		cl_int createKernelErrorCalculateStatisticalMapSearchlightLinear;
+
+		// Bayesian chains kernels
+		cl_int createKernelErrorCalculateStatisticalMapsGLMBayesianChains;
+
+		// Bayesian variational kernels
+		cl_int createKernelErrorCalculateLagProductsBayesianVB, createKernelErrorUpdateGLMBayesianVB, createKernelErrorCalculateSpatialPriorBayesianVB;
+
+		// FastICA kernels
+		cl_int createKernelErrorFastICANonlinearity, createKernelErrorFastICANonlinearityDouble;
+
+		// Dual regression kernels
+		cl_int createKernelErrorTransformTToZ;
+
 		// Create buffer errors
 		cl_int createBufferErrorAlignedVolume, createBufferErrorReferenceVolume;
 		cl_int createBufferErrorq11Real, createBufferErrorq11Imag, createBufferErrorq12Real, createBufferErrorq12Imag, createBufferErrorq13Real, createBufferErrorq13Imag, createBufferErrorq14Real, createBufferErrorq14Imag, createBufferErrorq15Real, createBufferErrorq15Imag, createBufferErrorq16Real, createBufferErrorq16Imag;
@@ -1039,6 +1293,48 @@ class BROCCOLI_LIB
 		cl_int runKernelErrorCalculatePermutationPValuesVoxelLevelInference, runKernelErrorCalculatePermutationPValuesClusterExtentInference, runKernelErrorCalculatePermutationPValuesClusterMassInference;
 
 
+		// Chunked GLM kernels
+		cl_int runKernelErrorCalculateBetaWeightsGLMFirstLevelChunk, runKernelErrorCalculateGLMResidualsChunk, runKernelErrorCalculateStatisticalMapsGLMTTestFirstLevelChunk, runKernelErrorEstimateAR4ModelsChunk, runKernelErrorApplyWhiteningAR4Chunk, runKernelErrorScatterVoxelValues;
+
+		// Compact voxel layout kernels
+		cl_int runKernelErrorGatherVoxelValues, runKernelErrorCalculateMaxAtomicCompact, runKernelErrorGeneratePermutedVolumesFirstLevelCompact, runKernelErrorCalculateStatisticalMapsGLMTTestFirstLevelPermutationCompact;
+
+		// Composed transformation kernels
+		cl_int runKernelErrorCalculateComposedSamplingMap, runKernelErrorInterpolateVolumeNearestComposed, runKernelErrorInterpolateVolumeLinearComposed, runKernelErrorInterpolateVolumeCubicComposed;
+
+		// Slice timing correction kernels
+		cl_int runKernelErrorSliceTimingCorrectionCubicVolumes, runKernelErrorSliceTimingCorrectionSincVolumes, runKernelErrorSliceTimingCorrectionPeriodicSincVolumes;
+
+		// Brain masking kernels
+		cl_int runKernelErrorInvertMask, runKernelErrorDilateMask, runKernelErrorErodeMask, runKernelErrorSelectCluster, runKernelErrorMarkBorderClusters, runKernelErrorFillMaskHoles;
+
+		// B-spline prefiltering and sinc interpolation kernels
+		cl_int runKernelErrorBSplinePrefilterX, runKernelErrorBSplinePrefilterY, runKernelErrorBSplinePrefilterZ, runKernelErrorInterpolateVolumeSincLinear, runKernelErrorInterpolateVolumeSincNonLinear;
+
+		// Sinc interpolation with composed sampling map kernels
+		cl_int runKernelErrorInterpolateVolumeSincComposed;
+
+		// Volume statistics kernels
+		cl_int runKernelErrorCalculateVolumeStatistics, runKernelErrorReduceVolumeStatistics, runKernelErrorCalculateVolumeHistogram, runKernelErrorNormalizeVolumeIntensity;
+
+		// Mutual information registration kernels
+		cl_int runKernelErrorCalculateJointHistogram, runKernelErrorCalculateMutualInformationGradient;
+
+		// Searchlight kernels
+		cl_int runKernelErrorCalculateStatisticalMapSearchlightLinear;
+
+		// Bayesian chains kernels
+		cl_int runKernelErrorCalculateStatisticalMapsGLMBayesianChains;
+
+		// Bayesian variational kernels
+		cl_int runKernelErrorCalculateLagProductsBayesianVB, runKernelErrorUpdateGLMBayesianVB, runKernelErrorCalculateSpatialPriorBayesianVB;
+
+		// FastICA kernels
+		cl_int runKernelErrorFastICANonlinearity, runKernelErrorFastICANonlinearityDouble;
+
+		// Dual regression kernels
+		cl_int runKernelErrorTransformTToZ;
+
 		int OpenCLCreateBufferErrors[200];
 		int OpenCLRunKernelErrors[200];
 		int OpenCLCreateKernelErrors[200];
@@ -1047,8 +1343,16 @@ class BROCCOLI_LIB
 		cl_event event;
 		cl_ulong time_start, time_end;
 
+		// Tuned local work sizes, for the kernels that do not depend on a specific work group size
+		size_t tunedLocalWorkSizeSeparableConvolution[3];
+		size_t tunedLocalWorkSizeNonseparableConvolution[3];
+		size_t tunedLocalWorkSizeInterpolateVolume[3];
+		size_t tunedLocalWorkSizeStatisticalCalculations[3];
+		size_t tunedLocalWorkSizeChunk;
+
 		// OpenCL local work sizes
 		size_t localWorkSizeMemset[3];
+		size_t localWorkSizeChunk[3];
 		size_t localWorkSizeSeparableConvolutionRows[3];
 		size_t localWorkSizeSeparableConvolutionColumns[3];
 		size_t localWorkSizeSeparableConvolutionRods[3];
@@ -1072,11 +1376,14 @@ class BROCCOLI_LIB
 		size_t localWorkSizeCalculateRowSums[3];
 		size_t localWorkSizeCalculateColumnMaxs[3];
 		size_t localWorkSizeCalculateRowMaxs[3];
+		size_t localWorkSizeBSplinePrefilter[3];
+		size_t localWorkSizeVolumeStatistics[3];
 		size_t localWorkSizeCalculateMaxAtomic[3];
 		size_t localWorkSizeThresholdVolume[3];
 		size_t localWorkSizeCalculateBetaWeightsGLM[3];
 		size_t localWorkSizeCalculateStatisticalMapsGLM[3];
         size_t localWorkSizeCalculateStatisticalMapSearchlight[3];
+		size_t localWorkSizeCalculateStatisticalMapSearchlightLinear[3];
 		size_t localWorkSizeRemoveLinearFit[3];
 		size_t localWorkSizeEstimateAR4Models[3];
 		size_t localWorkSizeApplyWhiteningAR4[3];
@@ -1090,6 +1397,7 @@ class BROCCOLI_LIB
 		// OpenCL global work sizes
 
 		size_t globalWorkSizeMemset[3];
+		size_t globalWorkSizeChunk[3];
 		size_t globalWorkSizeSeparableConvolutionRows[3];
 		size_t globalWorkSizeSeparableConvolutionColumns[3];
 		size_t globalWorkSizeSeparableConvolutionRods[3];
@@ -1113,11 +1421,16 @@ class BROCCOLI_LIB
 		size_t globalWorkSizeCalculateRowSums[3];
 		size_t globalWorkSizeCalculateColumnMaxs[3];
 		size_t globalWorkSizeCalculateRowMaxs[3];
+		size_t globalWorkSizeBSplinePrefilterX[3];
+		size_t globalWorkSizeBSplinePrefilterY[3];
+		size_t globalWorkSizeBSplinePrefilterZ[3];
+		size_t globalWorkSizeVolumeStatistics[3];
 		size_t globalWorkSizeCalculateMaxAtomic[3];
 		size_t globalWorkSizeThresholdVolume[3];
 		size_t globalWorkSizeCalculateBetaWeightsGLM[3];
 		size_t globalWorkSizeCalculateStatisticalMapsGLM[3];
         size_t globalWorkSizeCalculateStatisticalMapSearchlight[3];
+		size_t globalWorkSizeCalculateStatisticalMapSearchlightLinear[3];
 		size_t globalWorkSizeRemoveLinearFit[3];
 		size_t globalWorkSizeEstimateAR4Models[3];
 		size_t globalWorkSizeApplyWhiteningAR4[3];
@@ -1137,6 +1450,7 @@ class BROCCOLI_LIB
 		int BETA_SPACE;
 		int FILE_TYPE, DATA_TYPE;
 		bool DEBUG;
+		bool CHECK_MUTUAL_INFORMATION_GRADIENT, MUTUAL_INFORMATION_GRADIENT_CORRECT;
 		int WRAPPER;
 		bool PRINT;
 		bool VERBOS;
@@ -1196,10 +1510,18 @@ class BROCCOLI_LIB
 
 		int SLICE_ORDER;
 		int SLICE_CUSTOM_REF;
+		int SLICE_TIMING_INTERPOLATION;
+		int SLICE_TIMING_SINC_HALF_WIDTH;
+		int MULTIBAND_FACTOR;
+		int NUMBER_OF_SLICE_TIMING_GROUPS;
 
 		// Image registration variables
 		bool PRECENTER_REGISTRATION;
 		bool CHANGE_MOTION_CORRECTION_REFERENCE_VOLUME;
+		bool MOTION_CORRECTION_TWO_PASS;
+		bool REFERENCE_FILTER_RESPONSES_VALID;
+		bool CACHE_REFERENCE_FILTER_RESPONSES;
+		unsigned int REFERENCE_VOLUME_GENERATION;
 		int INTERPOLATION_MODE;
 		int IMAGE_REGISTRATION_FILTER_SIZE;
 		int NUMBER_OF_IMAGE_REGISTRATION_PARAMETERS;
@@ -1231,6 +1553,9 @@ class BROCCOLI_LIB
 		float EPI_Smoothing_FWHM;
 		float AR_Smoothing_FWHM;
 		bool AUTO_MASK;
+		int MASKING_METHOD;
+		int MASK_CLOSING_ITERATIONS;
+		int LINEAR_REGISTRATION_COST_EPI_T1;
 
 		// Statistical analysis variables
 		size_t NUMBER_OF_SUBJECTS;
@@ -1257,6 +1582,7 @@ class BROCCOLI_LIB
 		size_t REGRESS_GLOBALMEAN;
 		size_t REGRESS_CONFOUNDS;
 		bool PERMUTE_FIRST_LEVEL;
+		bool COMPACT_VOXEL_LAYOUT;
 		float CLUSTER_DEFINING_THRESHOLD;
 		int NUMBER_OF_CLUSTERS;
 		float MAX_CLUSTER;
@@ -1276,6 +1602,18 @@ class BROCCOLI_LIB
 		size_t NUMBER_OF_ICA_VARIABLES;
 		size_t NUMBER_OF_ICA_OBSERVATIONS;
 		double PROPORTION_OF_VARIANCE_TO_SAVE_BEFORE_ICA;
+		int ICA_ALGORITHM;
+		int FASTICA_NONLINEARITY;
+
+		// Group ICA variables, the reduced group data (components x voxels) is updated for every subject
+		size_t NUMBER_OF_ICA_SUBJECT_COMPONENTS;
+		size_t NUMBER_OF_GROUP_ICA_SUBJECTS;
+		Eigen::MatrixXf groupICAReducedData;
+		Eigen::MatrixXf groupICAMaps;
+
+		// Pseudo inverse of the group maps (components x voxels, all voxels in the volume), kept on the device for all subjects
+		cl_mem d_Group_ICA_Maps_Pseudo_Inverse;
+		bool GROUP_ICA_DEVICE_DUAL_REGRESSION_FAILED;
 
 		// Random permutation variables
 		size_t NUMBER_OF_PERMUTATIONS;
@@ -1285,6 +1623,14 @@ class BROCCOLI_LIB
 
 		// MCMC variables
 		int NUMBER_OF_MCMC_ITERATIONS;
+		int NUMBER_OF_MCMC_CHAINS;
+		int BAYESIAN_AR_ORDER;
+		float MCMC_RHAT_THRESHOLD;
+		float MCMC_MIN_ESS;
+
+		// Variational Bayes variables
+		int BAYESIAN_INFERENCE;
+		int NUMBER_OF_VB_ITERATIONS;
 
 		//--------------------------------------------------
 		// Host pointers
@@ -1297,6 +1643,10 @@ class BROCCOLI_LIB
 		float		*h_Mask;
 		float		*h_EPI_Mask;
 		float		*h_MNI_Mask;
+		float		*h_Group_ICA_Maps;
+		float		*h_Subject_ICA_Maps;
+		float		*h_Subject_ICA_Time_Courses;
+		float		*h_Subject_ICA_Z_Maps;
 		float		*h_Smoothed_EPI_Mask;
         	float       	*h_T1_Volume;
 		float		*h_MNI_Volume;
@@ -1393,6 +1743,8 @@ class BROCCOLI_LIB
 		float       	*h_Residuals_MNI;
 		float       	*h_Residual_Variances;
 		float		*h_AR1_Estimates_EPI, *h_AR2_Estimates_EPI, *h_AR3_Estimates_EPI, *h_AR4_Estimates_EPI;
+		float		*h_MCMC_Diagnostics_EPI;
+		float		*h_Posterior_Variances_EPI;
 		float		*h_AR1_Estimates_T1, *h_AR2_Estimates_T1, *h_AR3_Estimates_T1, *h_AR4_Estimates_T1;
 		float		*h_AR1_Estimates_MNI, *h_AR2_Estimates_MNI, *h_AR3_Estimates_MNI, *h_AR4_Estimates_MNI;
 		int		*h_Cluster_Indices;
@@ -1426,6 +1778,8 @@ class BROCCOLI_LIB
 
 		// Slice timing correction
 		float*		h_Slice_Differences;
+		float*		h_Slice_Group_Differences;
+		int*		h_Slice_Groups;
 		cl_mem		c_Slice_Differences;
 		cl_mem		d_Slice_Timing_Corrected_fMRI_Volumes;
 
@@ -1446,6 +1800,16 @@ class BROCCOLI_LIB
 		cl_mem		d_Update_Displacement_Field_X, d_Update_Displacement_Field_Y, d_Update_Displacement_Field_Z, d_Update_Certainty;
 		cl_mem		d_Temp_Displacement_Field_X, d_Temp_Displacement_Field_Y, d_Temp_Displacement_Field_Z;
 		cl_mem		d_Total_Displacement_Field_X, d_Total_Displacement_Field_Y, d_Total_Displacement_Field_Z, d_Total_Certainty;
+
+		// Batched transformation
+		bool		BATCHED_TRANSFORMATION_NONLINEAR;
+		cl_mem		d_Batch_Parameters;
+		cl_mem		d_Batch_Input_Volume, d_Batch_Interpolated_Volume, d_Batch_Reference_Volume, d_Batch_Output_Volume;
+		cl_mem		d_Batch_Input_Texture, d_Batch_Reference_Texture;
+		size_t		BATCH_INPUT_DATA_W, BATCH_INPUT_DATA_H, BATCH_INPUT_DATA_D;
+		float		BATCH_INPUT_VOXEL_SIZE_X, BATCH_INPUT_VOXEL_SIZE_Y, BATCH_INPUT_VOXEL_SIZE_Z;
+		cl_mem		d_Sampling_Map_EPI_MNI_X, d_Sampling_Map_EPI_MNI_Y, d_Sampling_Map_EPI_MNI_Z;
+		cl_mem		d_Sampling_Map_EPI_T1_X, d_Sampling_Map_EPI_T1_Y, d_Sampling_Map_EPI_T1_Z;
 		cl_mem		d_t11, d_t12, d_t13, d_t22, d_t23, d_t33;
 		cl_mem		d_Tensor_Norms, d_Smoothed_Tensor_Norms;
 		cl_mem		d_a11, d_a12, d_a13, d_a22, d_a23, d_a33;
@@ -1456,6 +1820,11 @@ class BROCCOLI_LIB
 		double		TENSOR_NORM_SIGMA;
 		double		EQUATION_SYSTEM_SIGMA;
 
+		// Cached filter responses of the reference volume, one set per scale (1, 2, 4, 8, 16)
+		unsigned int	CACHED_REFERENCE_GENERATION;
+		cl_mem		d_Cached_q11[5], d_Cached_q12[5], d_Cached_q13[5];
+		int			CACHED_REFERENCE_DATA_W[5], CACHED_REFERENCE_DATA_H[5], CACHED_REFERENCE_DATA_D[5];
+
 		// Motion correction
 		cl_mem		d_Motion_Corrected_fMRI_Volumes;
 
@@ -1487,6 +1856,19 @@ class BROCCOLI_LIB
 		cl_mem		c_Censor;
 		cl_mem		c_xtxxt_GLM, c_X_GLM, c_Contrasts, c_ctxtxc_GLM, c_Transformation_Matrix;
         cl_mem      c_Correct_Classes, c_d;
+
+		// Searchlight
+		int			SEARCHLIGHT_CLASSIFIER;
+		float		SEARCHLIGHT_RADIUS;
+		int			SEARCHLIGHT_FOLDS;
+		float		SEARCHLIGHT_REGULARIZATION;
+		int			NUMBER_OF_SEARCHLIGHT_FEATURES, NUMBER_OF_SEARCHLIGHT_FOLDS, NUMBER_OF_SEARCHLIGHT_VOXELS, NUMBER_OF_SEARCHLIGHT_TILE_VOLUMES;
+		int			SEARCHLIGHT_VOXELS_PER_RUN, SEARCHLIGHT_PERMUTATIONS_PER_RUN;
+		float*		h_Searchlight_Blocks_In;
+
+		unsigned int	RANDOM_SEED;
+		RandomState	icaRandomState;
+		cl_mem		c_Searchlight_Offsets, c_Searchlight_Fold_Boundaries, d_Searchlight_Voxels, d_Searchlight_Scratch, d_Searchlight_Max_Performance;
 		cl_mem		d_Residuals;
 		cl_mem		d_Residual_Variances, d_Residual_Variances_T1, d_Residual_Variances_MNI;
 		cl_mem		c_Censored_Timepoints, c_Censored_Volumes;
@@ -1498,6 +1880,12 @@ class BROCCOLI_LIB
 		cl_mem		d_AR1_Estimates_T1, d_AR2_Estimates_T1, d_AR3_Estimates_T1, d_AR4_Estimates_T1;
 		cl_mem		d_AR1_Estimates_MNI, d_AR2_Estimates_MNI, d_AR3_Estimates_MNI, d_AR4_Estimates_MNI;
 
+		// Brain voxels only, stored as [voxel + time * NUMBER_OF_BRAIN_VOXELS]
+		cl_mem		d_Compact_Voxel_Indices;
+		cl_mem		d_Compact_Whitened_fMRI_Volumes, d_Compact_Permuted_fMRI_Volumes;
+		cl_mem		d_Compact_AR1_Estimates, d_Compact_AR2_Estimates, d_Compact_AR3_Estimates, d_Compact_AR4_Estimates;
+		cl_mem		d_Compact_Statistical_Maps;
+
 		cl_mem		d_BOLD_Regressed_fMRI_Volumes;
 		cl_mem		d_Whitened_fMRI_Volumes;
 		cl_mem		d_Permuted_fMRI_Volumes;
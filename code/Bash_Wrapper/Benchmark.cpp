@@ -0,0 +1,318 @@
+/*
+ * BROCCOLI: Software for fast fMRI analysis on many-core CPUs and GPUs
+ * Copyright (C) <2013>  Anders Eklund, andek034@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "broccoli_lib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+
+#define MAX_VALUES 50
+
+// Reads a comma separated list of positive integers, returns the number of values or -1 for invalid input
+int ReadIntegerList(const char* input, int* values)
+{
+    int numberOfValues = 0;
+    const char* position = input;
+
+    while (*position != 0)
+    {
+        char *p;
+        long value = strtol(position, &p, 10);
+
+        if ( (p == position) || (value <= 0) || (numberOfValues >= MAX_VALUES) )
+        {
+            return -1;
+        }
+
+        values[numberOfValues] = (int)value;
+        numberOfValues++;
+
+        if (*p == ',')
+        {
+            p++;
+        }
+        else if (*p != 0)
+        {
+            return -1;
+        }
+        position = p;
+    }
+
+    return numberOfValues;
+}
+
+int main(int argc, char **argv)
+{
+    // Default parameters
+    int     OPENCL_PLATFORM = 0;
+    int     OPENCL_DEVICE = 0;
+    bool    VERBOS = false;
+    bool    AUTO_TUNE = false;
+
+    int     SIZES[MAX_VALUES] = {64, 128};
+    int     NUMBER_OF_SIZES = 2;
+    int     REGRESSORS[MAX_VALUES] = {4, 16};
+    int     NUMBER_OF_REGRESSORS = 2;
+    int     WORK_GROUP_SIZES[MAX_VALUES] = {64, 128, 256};
+    int     NUMBER_OF_WORK_GROUP_SIZES = 3;
+    int     DATA_T = 100;
+    int     REPETITIONS = 10;
+    const char* outputFilename = "benchmark.json";
+
+    // No inputs, so print help text
+    if (argc == 1)
+    {        
+        printf("Usage:\n\n");
+        printf("Benchmark -platform x -device y [options]\n\n");
+        printf("Runs the major BROCCOLI kernels for synthetic data, and saves time, bandwidth (GB/s) and throughput (GFLOP/s) as JSON.\n");
+        printf("The number of floating point operations are approximate, and are mainly intended for comparing devices and versions.\n\n");
+        printf("Options:\n\n");
+        printf(" -platform           The OpenCL platform to use (default 0) \n");
+        printf(" -device             The OpenCL device to use for the specificed platform (default 0) \n");
+        printf(" -sizes              Comma separated list of volume sizes, x means a volume of x * x * x voxels (default 64,128) \n");
+        printf(" -timepoints         Number of timepoints for the time series kernels (default 100) \n");
+        printf(" -regressors         Comma separated list of the number of regressors, at most 25 (default 4,16) \n");
+        printf(" -workgroups         Comma separated list of work group sizes for the time series kernels (default 64,128,256) \n");
+        printf(" -repetitions        Number of times each kernel is run (default 10) \n");
+        printf(" -output             Filename of the JSON output (default benchmark.json) \n");
+        printf(" -autotune           Tune work group sizes and kernel variants before running the benchmarks, if not already done for the device (default false) \n");
+        printf(" -verbose            Print extra stuff (default false) \n");
+        printf("\n\n");
+        
+        return EXIT_SUCCESS;
+    }
+
+ 	// Loop over additional inputs
+    int i = 1;
+    while (i < argc)
+    {
+        char *input = argv[i];
+        char *p;
+        if (strcmp(input,"-platform") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -platform !\n");
+                return EXIT_FAILURE;
+			}
+
+            OPENCL_PLATFORM = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("OpenCL platform must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (OPENCL_PLATFORM < 0)
+            {
+                printf("OpenCL platform must be >= 0!\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-device") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -device !\n");
+                return EXIT_FAILURE;
+			}
+
+            OPENCL_DEVICE = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("OpenCL device must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (OPENCL_DEVICE < 0)
+            {
+                printf("OpenCL device must be >= 0!\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-sizes") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -sizes !\n");
+                return EXIT_FAILURE;
+			}
+
+            NUMBER_OF_SIZES = ReadIntegerList(argv[i+1], SIZES);
+
+            if (NUMBER_OF_SIZES <= 0)
+            {
+                printf("Sizes must be a comma separated list of positive integers! You provided %s \n",argv[i+1]);
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-timepoints") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -timepoints !\n");
+                return EXIT_FAILURE;
+			}
+
+            DATA_T = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Number of timepoints must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (DATA_T < 10)
+            {
+                printf("Number of timepoints must be >= 10!\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-regressors") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -regressors !\n");
+                return EXIT_FAILURE;
+			}
+
+            NUMBER_OF_REGRESSORS = ReadIntegerList(argv[i+1], REGRESSORS);
+
+            if (NUMBER_OF_REGRESSORS <= 0)
+            {
+                printf("Regressors must be a comma separated list of positive integers! You provided %s \n",argv[i+1]);
+                return EXIT_FAILURE;
+            }
+            for (int r = 0; r < NUMBER_OF_REGRESSORS; r++)
+            {
+                if (REGRESSORS[r] > 25)
+                {
+                    printf("The number of regressors must be <= 25!\n");
+                    return EXIT_FAILURE;
+                }
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-workgroups") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -workgroups !\n");
+                return EXIT_FAILURE;
+			}
+
+            NUMBER_OF_WORK_GROUP_SIZES = ReadIntegerList(argv[i+1], WORK_GROUP_SIZES);
+
+            if (NUMBER_OF_WORK_GROUP_SIZES <= 0)
+            {
+                printf("Work group sizes must be a comma separated list of positive integers! You provided %s \n",argv[i+1]);
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-repetitions") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -repetitions !\n");
+                return EXIT_FAILURE;
+			}
+
+            REPETITIONS = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Number of repetitions must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (REPETITIONS <= 0)
+            {
+                printf("Number of repetitions must be > 0!\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-output") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read name after -output !\n");
+                return EXIT_FAILURE;
+			}
+
+            outputFilename = argv[i+1];
+            i += 2;
+        }
+        else if (strcmp(input,"-autotune") == 0)
+        {
+            AUTO_TUNE = true;
+            i += 1;
+        }
+        else if (strcmp(input,"-verbose") == 0)
+        {
+            VERBOS = true;
+            i += 1;
+        }
+        else
+        {
+            printf("Unrecognized option! %s \n",argv[i]);
+            return EXIT_FAILURE;
+        }   
+	}
+
+	BROCCOLI_LIB BROCCOLI(OPENCL_PLATFORM,OPENCL_DEVICE,2,VERBOS); // 2 = Bash wrapper
+
+    // Something went wrong...
+    if (!BROCCOLI.GetOpenCLInitiated())
+    {              
+        printf("Initialization error is \"%s\" \n",BROCCOLI.GetOpenCLInitializationError().c_str());
+		printf("OpenCL error is \"%s\" \n",BROCCOLI.GetOpenCLError());
+
+        // Print create kernel errors
+        int* createKernelErrors = BROCCOLI.GetOpenCLCreateKernelErrors();
+        for (int i = 0; i < BROCCOLI.GetNumberOfOpenCLKernels(); i++)
+        {
+            if (createKernelErrors[i] != 0)
+            {
+                printf("Create kernel error for kernel '%s' is '%s' \n",BROCCOLI.GetOpenCLKernelName(i),BROCCOLI.GetOpenCLErrorMessage(createKernelErrors[i]));
+            }
+        }                        
+                
+        printf("OpenCL initialization failed, aborting!\n");      
+        return EXIT_FAILURE;
+    }
+
+    BROCCOLI.SetPrint(true);
+    BROCCOLI.SetVerbose(VERBOS);
+    BROCCOLI.SetAutoTuning(AUTO_TUNE);
+
+    printf("Running benchmarks on %s\n\n",BROCCOLI.GetOpenCLDeviceName());
+
+	if (!BROCCOLI.RunBenchmarks(outputFilename, SIZES, NUMBER_OF_SIZES, DATA_T, REGRESSORS, NUMBER_OF_REGRESSORS, WORK_GROUP_SIZES, NUMBER_OF_WORK_GROUP_SIZES, REPETITIONS))
+	{
+		return EXIT_FAILURE;
+	}
+
+    printf("\nSaved benchmark results to %s\n",outputFilename);
+            
+    return EXIT_SUCCESS;
+}
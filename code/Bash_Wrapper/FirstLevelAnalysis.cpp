@@ -78,6 +78,8 @@ int main(int argc, char **argv)
     float           *h_AR1_Estimates_EPI, *h_AR2_Estimates_EPI, *h_AR3_Estimates_EPI, *h_AR4_Estimates_EPI;
     float           *h_AR1_Estimates_T1, *h_AR2_Estimates_T1, *h_AR3_Estimates_T1, *h_AR4_Estimates_T1;
     float           *h_AR1_Estimates_MNI, *h_AR2_Estimates_MNI, *h_AR3_Estimates_MNI, *h_AR4_Estimates_MNI;
+	float			*h_MCMC_Diagnostics_EPI;
+	float			*h_Posterior_Variances_EPI;
         
 	float			*h_Residuals_EPI;
 	float			*h_Residuals_MNI;
@@ -129,11 +131,16 @@ int main(int argc, char **argv)
     
     int             OPENCL_PLATFORM = 0;
     int             OPENCL_DEVICE = 0;
+    int             DEVICE_MEMORY_BUDGET = 0;
+    bool            COMPACT_VOXEL_LAYOUT = false;
+    bool            AUTO_TUNE = false;
     
     int             NUMBER_OF_ITERATIONS_FOR_LINEAR_IMAGE_REGISTRATION = 10;
     int             NUMBER_OF_ITERATIONS_FOR_NONLINEAR_IMAGE_REGISTRATION = 10;
     int 			COARSEST_SCALE_T1_MNI = 4;
 	int				COARSEST_SCALE_EPI_T1 = 4;
+	int				LINEAR_REGISTRATION_COST_EPI_T1 = 0;
+	bool			CHECK_GRADIENT = false;
 	int				MM_T1_Z_CUT = 0;
 	int				MM_EPI_Z_CUT = 0;
     float           SIGMA = 5.0f;
@@ -146,7 +153,14 @@ int main(int argc, char **argv)
 	bool			DEFINED_SLICE_PATTERN = false;
 	bool			DEFINED_SLICE_CUSTOM_REF = false;
 	int				SLICE_CUSTOM_REF = 0;
+	int				SLICE_TIMING_INTERPOLATION = 0;
+	int				SLICE_TIMING_SINC_HALF_WIDTH = 4;
+	int				MULTIBAND_FACTOR = 1;
+	bool			SLICE_TIMINGS_JSON = false;
     int             NUMBER_OF_ITERATIONS_FOR_MOTION_CORRECTION = 5;
+	bool			MOTION_CORRECTION_TWO_PASS = false;
+	int				MASKING_METHOD = 0;
+	int				MASK_CLOSING_ITERATIONS = 2;
 
 	bool			FOUND_REGRESSORS = false;
 
@@ -169,11 +183,18 @@ int main(int argc, char **argv)
     size_t          USE_TEMPORAL_DERIVATIVES = 0;
     bool            PERMUTE = false;
     size_t			NUMBER_OF_PERMUTATIONS = 1000;
+    unsigned int	RANDOM_SEED = 0;
 
     int				INFERENCE_MODE = 1;
     float           CLUSTER_DEFINING_THRESHOLD = 2.5f;
     bool            BAYESIAN = false;
     int             NUMBER_OF_MCMC_ITERATIONS = 1000;
+    int             NUMBER_OF_MCMC_CHAINS = 4;
+    int             BAYESIAN_AR_ORDER = 1;
+    float           MCMC_RHAT_THRESHOLD = 1.01f;
+    float           MCMC_MIN_ESS = 400.0f;
+    bool            VARIATIONAL_BAYES = false;
+    int             NUMBER_OF_VB_ITERATIONS = 100;
 	bool			MASK = false;
 	const char*		MASK_NAME;
 	const char*		SLICE_TIMINGS_FILE;
@@ -234,11 +255,16 @@ int main(int argc, char **argv)
         
         printf("OpenCL options:\n\n");
         printf(" -platform                  The OpenCL platform to use (default 0) \n");
-        printf(" -device                    The OpenCL device to use for the specificed platform (default 0) \n\n");
+        printf(" -device                    The OpenCL device to use for the specificed platform (default 0) \n");
+        printf(" -memorybudget              Amount of device memory (in MB) to use, larger datasets are processed as chunks of brain voxels. Buffers from the device memory pool (the GLM, the permutation test) are not allocated beyond the budget, most preprocessing buffers (registration, motion correction, smoothing) are not limited (default all global memory) \n");
+        printf(" -compact                   Store brain voxels only, in a compact layout, for the GLM and for permutation tests with voxel inference (default no) \n");
+        printf(" -autotune                  Time candidate work group sizes and kernel variants the first time a device is used, and save the fastest ones for later runs (default no) \n\n");
         
         printf("Registration options:\n\n");
         printf(" -iterationslinear          Number of iterations for the linear registration (default 10) \n");        
         printf(" -iterationsnonlinear       Number of iterations for the non-linear registration (default 10), 0 means that no non-linear registration is performed \n");        
+        printf(" -costepit1                 Cost function for the linear registration of the fMRI volume to the T1 volume, 0 = phase based, 1 = normalized mutual information (default 0) \n");
+        printf(" -checkgradient             Compare the analytic gradient of the normalized mutual information with finite differences in the first iteration, exit with an error if they differ (default no) \n");
         //printf(" -lowestscalet1             The lowest scale for the linear and non-linear registration of the T1 volume to MNI, should be 1, 2, 4 or 8 (default 4), x means downsampling a factor x in each dimension  \n");        
         //printf(" -lowestscaleepi            The lowest scale for the linear registration of the fMRI volume to the T1 volume, should be 1, 2, 4 or 8 (default 4), x means downsampling a factor x in each dimension  \n");        
         printf(" -zcutt1                    Number of mm to cut from the bottom of the T1 volume, can be negative, useful if the head in the volume is placed very high or low (default 0) \n\n");
@@ -255,7 +281,14 @@ int main(int argc, char **argv)
 		printf("                            (no slice timing correction is performed if pattern in NIFTI file is unknown and no pattern is provided) \n");        
         printf(" -slicecustom               Provide a text file with the slice times, one value per slice, in milli seconds (0 - TR) (overrides pattern provided in NIFTI file)\n");
 		printf(" -slicecustomref            Reference slice for the custom slice times (0 - (#slices-1)) (default #slices/2)\n");
+		printf(" -sliceinterpolation        Interpolation used for slice timing correction, 0 = cubic, 1 = windowed sinc, 2 = periodic sinc (exact Fourier shift, slow for long time series) (default 0)\n");
+		printf(" -sincwidth                 Half width (in time points) of the windowed sinc interpolation (default 4)\n");
+		printf(" -multiband                 Multiband factor, the slice pattern is applied to the slices of one band (default 1)\n");
+		printf(" -slicetimingjson           Read the slice times (in seconds) from the SliceTiming field of a BIDS json file (overrides pattern provided in NIFTI file)\n");
         printf(" -iterationsmc              Number of iterations for motion correction (default 5) \n");
+        printf(" -twopassmc                 Motion correction to the mean of the volumes aligned to the first volume, instead of to the first volume (default no) \n");
+		printf(" -maskmethod                Method for the automatic brain mask, 0 = 90%% of mean intensity, 1 = Otsu threshold, 2 = two class Gaussian mixture (default 0)\n");
+		printf(" -maskclosing               Number of closing iterations for the automatic brain mask, only used by mask methods 1 and 2 (default 2)\n");
         printf(" -smoothing                 Amount of smoothing to apply to the fMRI data (default 6.0 mm) \n\n");
         
         printf("Statistical options:\n\n");
@@ -272,10 +305,17 @@ int main(int argc, char **argv)
         printf(" -temporalderivatives       Use temporal derivatives for the activity regressors (default no) \n");
         printf(" -permute                   Apply a permutation test to get p-values (default no) \n");
         printf(" -permutations              Number of permutations to use for permutation test (default 1,000) \n");
+        printf(" -seed                      Seed for the random permutations, MCMC (default 0) \n");
         printf(" -inferencemode             Inference mode to use for permutation test, 0 = voxel, 1 = cluster extent, 2 = cluster mass, 3 = TFCE (default 1) \n");
         printf(" -cdt                       Cluster defining threshold for cluster inference (default 2.5) \n");
-        printf(" -bayesian                  Do Bayesian analysis using MCMC, currently only supports 2 regressors (default no) \n");
-        printf(" -iterationsmcmc            Number of iterations for MCMC chains (default 1,000) \n");
+        printf(" -bayesian                  Do Bayesian analysis using MCMC, supports at most 25 regressors (including temporal derivatives) (default no) \n");
+        printf(" -iterationsmcmc            Maximum number of iterations for each MCMC chain (default 1,000) \n");
+        printf(" -chainsmcmc                Number of MCMC chains per voxel, at most the maximum work-group size of the device (default 4) \n");
+        printf(" -arordermcmc               Order of the AR noise model for the Bayesian analysis, 1 - 4 (default 1) \n");
+        printf(" -rhatmcmc                  Stop the chains of a voxel when the split-R-hat of all contrasts is below this value (default 1.01) \n");
+        printf(" -essmcmc                   and the effective sample size is at least this value (default 400) \n");
+        printf(" -bayesianvb                Do Bayesian analysis using variational Bayes and a spatial prior instead of MCMC, much faster (default no) \n");
+        printf(" -iterationsvb              Maximum number of variational Bayes iterations (default 100) \n");
         printf(" -mask                      Apply a mask to the statistical maps after the statistical analysis, in MNI space (default none) \n\n");
 
         printf("Misc options:\n\n");
@@ -481,6 +521,38 @@ int main(int argc, char **argv)
             }
             i += 2;
         }
+        else if (strcmp(input,"-memorybudget") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -memorybudget !\n");
+                return EXIT_FAILURE;
+			}
+
+            DEVICE_MEMORY_BUDGET = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Memory budget must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (DEVICE_MEMORY_BUDGET <= 0)
+            {
+                printf("Memory budget must be > 0!\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-compact") == 0)
+        {
+            COMPACT_VOXEL_LAYOUT = true;
+            i += 1;
+        }
+        else if (strcmp(input,"-autotune") == 0)
+        {
+            AUTO_TUNE = true;
+            i += 1;
+        }
         
         // Registration options
         else if (strcmp(input,"-iterationslinear") == 0)
@@ -573,6 +645,33 @@ int main(int argc, char **argv)
             i += 2;
         }
 		*/
+        else if (strcmp(input,"-costepit1") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -costepit1 !\n");
+                return EXIT_FAILURE;
+			}
+
+            LINEAR_REGISTRATION_COST_EPI_T1 = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Registration cost must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if ((LINEAR_REGISTRATION_COST_EPI_T1 != 0) && (LINEAR_REGISTRATION_COST_EPI_T1 != 1))
+            {
+                printf("Registration cost must be 0 or 1 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-checkgradient") == 0)
+        {
+            CHECK_GRADIENT = true;
+            i += 1;
+        }
  		else if (strcmp(input,"-zcutt1") == 0)
         {
 			if ( (i+1) >= argc  )
@@ -713,6 +812,136 @@ int main(int argc, char **argv)
             i += 2;
 			DEFINED_SLICE_CUSTOM_REF = true;
         }
+        else if (strcmp(input,"-sliceinterpolation") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -sliceinterpolation !\n");
+                return EXIT_FAILURE;
+			}
+
+            SLICE_TIMING_INTERPOLATION = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Slice timing interpolation must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if ((SLICE_TIMING_INTERPOLATION < 0) || (SLICE_TIMING_INTERPOLATION > 2))
+            {
+                printf("Slice timing interpolation must be 0, 1 or 2 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-sincwidth") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -sincwidth !\n");
+                return EXIT_FAILURE;
+			}
+
+            SLICE_TIMING_SINC_HALF_WIDTH = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Sinc width must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (SLICE_TIMING_SINC_HALF_WIDTH < 1)
+            {
+                printf("Sinc width must be >= 1 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-multiband") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -multiband !\n");
+                return EXIT_FAILURE;
+			}
+
+            MULTIBAND_FACTOR = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Multiband factor must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (MULTIBAND_FACTOR < 1)
+            {
+                printf("Multiband factor must be >= 1 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-maskmethod") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -maskmethod !\n");
+                return EXIT_FAILURE;
+			}
+
+            MASKING_METHOD = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Mask method must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if ((MASKING_METHOD < 0) || (MASKING_METHOD > 2))
+            {
+                printf("Mask method must be 0, 1 or 2 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-maskclosing") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -maskclosing !\n");
+                return EXIT_FAILURE;
+			}
+
+            MASK_CLOSING_ITERATIONS = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Number of mask closing iterations must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (MASK_CLOSING_ITERATIONS < 0)
+            {
+                printf("Number of mask closing iterations must be >= 0 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-slicetimingjson") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -slicetimingjson !\n");
+                return EXIT_FAILURE;
+			}
+
+			SLICE_ORDER = CUSTOM;
+			SLICE_TIMINGS_FILE = argv[i+1];
+			SLICE_TIMINGS_JSON = true;
+
+            i += 2;
+			DEFINED_SLICE_PATTERN = true;
+        }
+        else if (strcmp(input,"-twopassmc") == 0)
+        {
+            MOTION_CORRECTION_TWO_PASS = true;
+            i += 1;
+        }
         else if (strcmp(input,"-iterationsmc") == 0)
         {
 			if ( (i+1) >= argc  )
@@ -892,6 +1121,34 @@ int main(int argc, char **argv)
             BAYESIAN = true;
             i += 1;
         }
+        else if (strcmp(input,"-bayesianvb") == 0)
+        {
+            BAYESIAN = true;
+            VARIATIONAL_BAYES = true;
+            i += 1;
+        }
+        else if (strcmp(input,"-iterationsvb") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -iterationsvb !\n");
+                return EXIT_FAILURE;
+			}
+            
+            NUMBER_OF_VB_ITERATIONS = (int)strtol(argv[i+1], &p, 10);
+            
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Number of iterations for variational Bayes must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (NUMBER_OF_VB_ITERATIONS <= 0)
+            {
+                printf("Number of iterations for variational Bayes must be > 0 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
         else if (strcmp(input,"-iterationsmcmc") == 0)
         {
 			if ( (i+1) >= argc  )
@@ -914,6 +1171,94 @@ int main(int argc, char **argv)
             }
             i += 2;
         }
+        else if (strcmp(input,"-chainsmcmc") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -chainsmcmc !\n");
+                return EXIT_FAILURE;
+			}
+            
+            NUMBER_OF_MCMC_CHAINS = (int)strtol(argv[i+1], &p, 10);
+            
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Number of MCMC chains must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (NUMBER_OF_MCMC_CHAINS < 2)
+            {
+                printf("Number of MCMC chains must be >= 2 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-arordermcmc") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -arordermcmc !\n");
+                return EXIT_FAILURE;
+			}
+            
+            BAYESIAN_AR_ORDER = (int)strtol(argv[i+1], &p, 10);
+            
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("AR order for MCMC must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if ((BAYESIAN_AR_ORDER < 1) || (BAYESIAN_AR_ORDER > 4))
+            {
+                printf("AR order for MCMC must be 1 - 4 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-rhatmcmc") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -rhatmcmc !\n");
+                return EXIT_FAILURE;
+			}
+            
+            MCMC_RHAT_THRESHOLD = strtod(argv[i+1], &p);
+            
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("R-hat threshold for MCMC must be a float! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (MCMC_RHAT_THRESHOLD <= 1.0f)
+            {
+                printf("R-hat threshold for MCMC must be > 1 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-essmcmc") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -essmcmc !\n");
+                return EXIT_FAILURE;
+			}
+            
+            MCMC_MIN_ESS = strtod(argv[i+1], &p);
+            
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Effective sample size for MCMC must be a float! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (MCMC_MIN_ESS < 0.0f)
+            {
+                printf("Effective sample size for MCMC must be >= 0 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
         else if (strcmp(input,"-mask") == 0)
         {
 			if ( (i+1) >= argc  )
@@ -1082,6 +1427,23 @@ int main(int argc, char **argv)
 			WRITE_MOTION_CORRECTED = true;
             i += 1;
         }
+        else if (strcmp(input,"-seed") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -seed !\n");
+                return EXIT_FAILURE;
+			}
+
+            RANDOM_SEED = (unsigned int)strtoul(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Seed must be a non-negative integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            i += 2;
+        }
         else if (strcmp(input,"-quiet") == 0)
         {
             PRINT = false;
@@ -1277,10 +1639,10 @@ int main(int argc, char **argv)
 	        printf("Number of regressors must be <= 25 when permuting ! You provided %zu regressors in the design file %s. Aborting! \n",NUMBER_OF_GLM_REGRESSORS,argv[argument]);
 	        return EXIT_FAILURE;
 	    }
-	    else if ( BAYESIAN && (NUMBER_OF_GLM_REGRESSORS != 2) )
+	    else if ( BAYESIAN && ((NUMBER_OF_GLM_REGRESSORS * (USE_TEMPORAL_DERIVATIVES+1)) > 25) )
 	    {
 	        design.close();
-	        printf("Number of regressors must currently be exactly 2 for Bayesian fMRI analysis! You provided %zu regressors in the design file %s. Aborting! \n",NUMBER_OF_GLM_REGRESSORS,argv[argument]);
+	        printf("Number of regressors (including temporal derivatives) must be <= 25 for Bayesian fMRI analysis! You provided %zu regressors in the design file %s. Aborting! \n",NUMBER_OF_GLM_REGRESSORS,argv[argument]);
 	        return EXIT_FAILURE;
 	    }
 	    design.close();
@@ -1295,68 +1657,60 @@ int main(int argc, char **argv)
 
 	if (!REGRESS_ONLY && !PREPROCESSING_ONLY)
 	{
-		if (!BAYESIAN)
-		{
 		int argument;
 
-			if (!MULTIPLE_RUNS)
-			{
-				argument = 5;
-			}
-			else
-			{
-				argument = 5 + NUMBER_OF_RUNS*2;
-			}
+		if (!MULTIPLE_RUNS)
+		{
+			argument = 5;
+		}
+		else
+		{
+			argument = 5 + NUMBER_OF_RUNS*2;
+		}
 
-		    contrasts.open(argv[argument]);
+	    contrasts.open(argv[argument]);
     
-		    if (!contrasts.good())
-		    {
-		        contrasts.close();
-		        printf("Unable to open contrasts file %s. Aborting! \n",argv[argument]);
-		        return EXIT_FAILURE;
-		    }
+	    if (!contrasts.good())
+	    {
+	        contrasts.close();
+	        printf("Unable to open contrasts file %s. Aborting! \n",argv[argument]);
+	        return EXIT_FAILURE;
+	    }
     
-		    contrasts >> tempString; // NumRegressors as string
-		    if (tempString.compare(NR) != 0)
-		    {
-		        contrasts.close();
-		        printf("First element of the contrasts file should be the string 'NumRegressors', but it is %s. Aborting! \n",tempString.c_str());
-		        return EXIT_FAILURE;
-		    }
-		    contrasts >> tempNumber;
+	    contrasts >> tempString; // NumRegressors as string
+	    if (tempString.compare(NR) != 0)
+	    {
+	        contrasts.close();
+	        printf("First element of the contrasts file should be the string 'NumRegressors', but it is %s. Aborting! \n",tempString.c_str());
+	        return EXIT_FAILURE;
+	    }
+	    contrasts >> tempNumber;
     
-		    // Check for consistency
-		    if ( tempNumber != NUMBER_OF_GLM_REGRESSORS )
+	    // Check for consistency
+	    if ( tempNumber != NUMBER_OF_GLM_REGRESSORS )
     		{
-		        contrasts.close();
-		        printf("Design file says that number of regressors is %zu, while contrast file says there are %i regressors. Aborting! \n",NUMBER_OF_GLM_REGRESSORS,tempNumber);
-		        return EXIT_FAILURE;
-		    }
+	        contrasts.close();
+	        printf("Design file says that number of regressors is %zu, while contrast file says there are %i regressors. Aborting! \n",NUMBER_OF_GLM_REGRESSORS,tempNumber);
+	        return EXIT_FAILURE;
+	    }
     
-		    contrasts >> tempString; // NumContrasts as string
-		    std::string NC("NumContrasts");
-		    if (tempString.compare(NC) != 0)
-		    {
-		        contrasts.close();
-		        printf("Third element of the contrasts file should be the string 'NumContrasts', but it is %s. Aborting! \n",tempString.c_str());
-		        return EXIT_FAILURE;
-		    }
-		    contrasts >> NUMBER_OF_CONTRASTS;
-			
-		    if (NUMBER_OF_CONTRASTS <= 0)
-		    {
-		        contrasts.close();
+	    contrasts >> tempString; // NumContrasts as string
+	    std::string NC("NumContrasts");
+	    if (tempString.compare(NC) != 0)
+	    {
+	        contrasts.close();
+	        printf("Third element of the contrasts file should be the string 'NumContrasts', but it is %s. Aborting! \n",tempString.c_str());
+	        return EXIT_FAILURE;
+	    }
+	    contrasts >> NUMBER_OF_CONTRASTS;
+		
+	    if (NUMBER_OF_CONTRASTS <= 0)
+	    {
+	        contrasts.close();
     		    printf("Number of contrasts must be > 0 ! You provided %zu in the contrasts file. Aborting! \n",NUMBER_OF_CONTRASTS);
-		        return EXIT_FAILURE;
-		    }
-		    contrasts.close();
-		}
-		else if (BAYESIAN)
-		{
-			NUMBER_OF_CONTRASTS = 6;
-    	    printf("Warning: Your contrasts are not used for the Bayesian fMRI analysis. Since only 2 regressors are currently supported, all the 6 possible contrasts are always calculated\n");
-		}
+	        return EXIT_FAILURE;
+	    }
+	    contrasts.close();
     }
 	else
 	{
@@ -1590,7 +1944,33 @@ int main(int argc, char **argv)
     //------------------------------------------	
 	// Read slice timing information from text file
 	
-	if (SLICE_ORDER == CUSTOM)
+	if ((SLICE_ORDER == CUSTOM) && SLICE_TIMINGS_JSON)
+	{
+		int numberOfSliceTimes = ReadBIDSSliceTiming(SLICE_TIMINGS_FILE, h_Custom_Slice_Times, 1000);
+
+		if (numberOfSliceTimes != EPI_DATA_D)
+		{
+	        printf("Unable to read %zu slice times from the SliceTiming field in %s, aborting! \n",EPI_DATA_D,SLICE_TIMINGS_FILE);
+			FreeAllNiftiImages(allNiftiImages,numberOfNiftiImages);
+	        return EXIT_FAILURE;
+		}
+
+		for (int slice = 0; slice < EPI_DATA_D; slice++)
+		{
+			if ((h_Custom_Slice_Times[slice] < 0.0f) || (h_Custom_Slice_Times[slice] > TR))
+			{
+	            printf("Slice time must be between 0 and the TR! Check the time for slice %i in %s ! \n",slice,SLICE_TIMINGS_FILE);
+				FreeAllNiftiImages(allNiftiImages,numberOfNiftiImages);
+	            return EXIT_FAILURE;
+			}
+
+			if (DEBUG)
+			{
+				printf("Slice time for slice %i is %f seconds \n",slice,h_Custom_Slice_Times[slice]);
+			}
+		}
+	}
+	else if (SLICE_ORDER == CUSTOM)
 	{		
 		std::ifstream slicetimes;
 		slicetimes.open(SLICE_TIMINGS_FILE);
@@ -1704,7 +2084,7 @@ int main(int argc, char **argv)
 	}
 	else if (BAYESIAN)
 	{
-		NUMBER_OF_TOTAL_GLM_REGRESSORS = 2;
+		NUMBER_OF_TOTAL_GLM_REGRESSORS = NUMBER_OF_GLM_REGRESSORS * (USE_TEMPORAL_DERIVATIVES+1);
 	}
     
     if ((NUMBER_OF_TOTAL_GLM_REGRESSORS > 25) && PERMUTE)
@@ -2017,6 +2397,15 @@ int main(int argc, char **argv)
 	    AllocateMemory(h_AR4_Estimates_EPI, EPI_VOLUME_SIZE, allMemoryPointers, numberOfMemoryPointers, allNiftiImages, numberOfNiftiImages, allocatedHostMemory, "AR4_ESTIMATES");
 	}
 
+	if (BAYESIAN && !VARIATIONAL_BAYES && !REGRESS_ONLY && !PREPROCESSING_ONLY)
+	{
+	    AllocateMemory(h_MCMC_Diagnostics_EPI, EPI_VOLUME_SIZE * 3, allMemoryPointers, numberOfMemoryPointers, allNiftiImages, numberOfNiftiImages, allocatedHostMemory, "MCMC_DIAGNOSTICS");
+	}
+	else if (BAYESIAN && VARIATIONAL_BAYES && !REGRESS_ONLY && !PREPROCESSING_ONLY)
+	{
+	    AllocateMemory(h_Posterior_Variances_EPI, EPI_VOLUME_SIZE * NUMBER_OF_TOTAL_GLM_REGRESSORS, allMemoryPointers, numberOfMemoryPointers, allNiftiImages, numberOfNiftiImages, allocatedHostMemory, "POSTERIOR_VARIANCES");
+	}
+
     if (WRITE_AR_ESTIMATES_MNI)
     {
         AllocateMemory(h_AR1_Estimates_MNI, MNI_VOLUME_SIZE, allMemoryPointers, numberOfMemoryPointers, allNiftiImages, numberOfNiftiImages, allocatedHostMemory, "AR1_ESTIMATES_MNI");
@@ -2304,44 +2693,41 @@ int main(int argc, char **argv)
 
 	if (!REGRESS_ONLY && !PREPROCESSING_ONLY)
 	{
-    	if (!BAYESIAN)
+		int contrastfile;
+		if (!MULTIPLE_RUNS)
 		{
-			int contrastfile;
-			if (!MULTIPLE_RUNS)
-			{
-				contrastfile = 5;
-			}
-			else
-			{
-				contrastfile = 5 + NUMBER_OF_RUNS*2;
-			}
+			contrastfile = 5;
+		}
+		else
+		{
+			contrastfile = 5 + NUMBER_OF_RUNS*2;
+		}
 
-		    // Open contrast file again
-		    contrasts.open(argv[contrastfile]);
+	    // Open contrast file again
+	    contrasts.open(argv[contrastfile]);
 
-		    // Read first two values again
-			contrasts >> tempString; // NumRegressors as string
-		    contrasts >> tempNumber;
-		    contrasts >> tempString; // NumContrasts as string
-		    contrasts >> tempNumber;
+	    // Read first two values again
+		contrasts >> tempString; // NumRegressors as string
+	    contrasts >> tempNumber;
+	    contrasts >> tempString; // NumContrasts as string
+	    contrasts >> tempNumber;
    
-			// Read all contrast values
-			for (size_t c = 0; c < NUMBER_OF_CONTRASTS; c++)
+		// Read all contrast values
+		for (size_t c = 0; c < NUMBER_OF_CONTRASTS; c++)
+		{
+			for (size_t r = 0; r < NUMBER_OF_GLM_REGRESSORS; r++)
 			{
-				for (size_t r = 0; r < NUMBER_OF_GLM_REGRESSORS; r++)
+				if (! (contrasts >> h_Contrasts[r + c * NUMBER_OF_GLM_REGRESSORS]) )
 				{
-					if (! (contrasts >> h_Contrasts[r + c * NUMBER_OF_GLM_REGRESSORS]) )
-					{
-					    contrasts.close();
-		                printf("Unable to read all the contrast values, aborting! Check the contrasts file. \n");
-		                FreeAllMemory(allMemoryPointers,numberOfMemoryPointers);
-		                FreeAllNiftiImages(allNiftiImages,numberOfNiftiImages);
-		                return EXIT_FAILURE;
-					}
+				    contrasts.close();
+	                printf("Unable to read all the contrast values, aborting! Check the contrasts file. \n");
+	                FreeAllMemory(allMemoryPointers,numberOfMemoryPointers);
+	                FreeAllNiftiImages(allNiftiImages,numberOfNiftiImages);
+	                return EXIT_FAILURE;
 				}
 			}
-			contrasts.close();
 		}
+		contrasts.close();
 
 		endTime = GetWallTime();
 
@@ -2820,6 +3206,12 @@ int main(int argc, char **argv)
         BROCCOLI.SetEPISliceOrder(SLICE_ORDER); 
 		BROCCOLI.SetCustomSliceTimes(h_Custom_Slice_Times);
 		BROCCOLI.SetCustomReferenceSlice(SLICE_CUSTOM_REF);
+		BROCCOLI.SetSliceTimingInterpolation(SLICE_TIMING_INTERPOLATION);
+		BROCCOLI.SetSliceTimingSincHalfWidth(SLICE_TIMING_SINC_HALF_WIDTH);
+		BROCCOLI.SetMultibandFactor(MULTIBAND_FACTOR);
+		BROCCOLI.SetMotionCorrectionTwoPass(MOTION_CORRECTION_TWO_PASS);
+		BROCCOLI.SetMaskingMethod(MASKING_METHOD);
+		BROCCOLI.SetMaskClosingIterations(MASK_CLOSING_ITERATIONS);
 
 		BROCCOLI.SetApplySliceTimingCorrection(APPLY_SLICE_TIMING_CORRECTION);
 		BROCCOLI.SetApplyMotionCorrection(APPLY_MOTION_CORRECTION);
@@ -2866,6 +3258,8 @@ int main(int argc, char **argv)
         BROCCOLI.SetNumberOfIterationsForMotionCorrection(NUMBER_OF_ITERATIONS_FOR_MOTION_CORRECTION);    
         BROCCOLI.SetCoarsestScaleT1MNI(COARSEST_SCALE_T1_MNI);
         BROCCOLI.SetCoarsestScaleEPIT1(COARSEST_SCALE_EPI_T1);
+        BROCCOLI.SetLinearRegistrationCostEPIT1(LINEAR_REGISTRATION_COST_EPI_T1);
+        BROCCOLI.SetCheckMutualInformationGradient(CHECK_GRADIENT);
         BROCCOLI.SetMMT1ZCUT(MM_T1_Z_CUT);   
         BROCCOLI.SetMMEPIZCUT(MM_EPI_Z_CUT);   
         BROCCOLI.SetEPISmoothingAmount(EPI_SMOOTHING_AMOUNT);
@@ -2898,6 +3292,7 @@ int main(int argc, char **argv)
     
 		BROCCOLI.SetPermuteFirstLevel(PERMUTE);
         BROCCOLI.SetNumberOfPermutations(NUMBER_OF_PERMUTATIONS);
+        BROCCOLI.SetRandomSeed(RANDOM_SEED);
 		BROCCOLI.SetPermutationMatrix(h_Permutation_Matrix);      
         BROCCOLI.SetOutputPermutationDistribution(h_Permutation_Distribution);
 
@@ -2909,6 +3304,11 @@ int main(int argc, char **argv)
         //BROCCOLI.SetRegressConfounds(REGRESS_CONFOUNDS);
 
         BROCCOLI.SetNumberOfMCMCIterations(NUMBER_OF_MCMC_ITERATIONS);
+        BROCCOLI.SetNumberOfMCMCChains(NUMBER_OF_MCMC_CHAINS);
+        BROCCOLI.SetBayesianAROrder(BAYESIAN_AR_ORDER);
+        BROCCOLI.SetMCMCConvergenceCriteria(MCMC_RHAT_THRESHOLD, MCMC_MIN_ESS);
+        BROCCOLI.SetBayesianInference(VARIATIONAL_BAYES ? BAYESIAN_VB : BAYESIAN_MCMC);
+        BROCCOLI.SetNumberOfVBIterations(NUMBER_OF_VB_ITERATIONS);
     
         if (REGRESS_CONFOUNDS == 1)
         {
@@ -2981,11 +3381,24 @@ int main(int argc, char **argv)
 
         //BROCCOLI.SetOutputResidualVariances(h_Residual_Variances);
         BROCCOLI.SetOutputAREstimatesEPI(h_AR1_Estimates_EPI, h_AR2_Estimates_EPI, h_AR3_Estimates_EPI, h_AR4_Estimates_EPI);
+		if (BAYESIAN && !VARIATIONAL_BAYES)
+		{
+			BROCCOLI.SetOutputMCMCDiagnosticsEPI(h_MCMC_Diagnostics_EPI);
+		}
+		else if (BAYESIAN && VARIATIONAL_BAYES)
+		{
+			BROCCOLI.SetOutputPosteriorVariancesEPI(h_Posterior_Variances_EPI);
+		}
         BROCCOLI.SetOutputAREstimatesMNI(h_AR1_Estimates_MNI, h_AR2_Estimates_MNI, h_AR3_Estimates_MNI, h_AR4_Estimates_MNI);
         BROCCOLI.SetOutputAREstimatesT1(h_AR1_Estimates_T1, h_AR2_Estimates_T1, h_AR3_Estimates_T1, h_AR4_Estimates_T1);
         //BROCCOLI.SetOutputWhitenedModels(h_Whitened_Models);
 		    
 		BROCCOLI.SetPrint(PRINT);
+		// The memory budget sizes the chunks and is also the hard limit of the memory pool
+		BROCCOLI.SetDeviceMemoryBudget(DEVICE_MEMORY_BUDGET);
+		BROCCOLI.SetDeviceMemoryLimit(DEVICE_MEMORY_BUDGET);
+		BROCCOLI.SetCompactVoxelLayout(COMPACT_VOXEL_LAYOUT);
+		BROCCOLI.SetAutoTuning(AUTO_TUNE);
 
         BROCCOLI.SetOutputDesignMatrix(h_Design_Matrix, h_Design_Matrix2);
         
@@ -3262,10 +3675,10 @@ int main(int argc, char **argv)
     //----------------------------
     
     // Create new nifti image	
-    nifti_image *outputNiftifMRI = nifti_copy_nim_info(inputfMRI);
+    nifti_image *outputNiftifMRI = nifti_copy_nim_info(inputfMRI);
 	outputNiftifMRI->nt = EPI_DATA_T;
     outputNiftifMRI->dim[4] = EPI_DATA_T;
-    outputNiftifMRI->nvox = EPI_DATA_W * EPI_DATA_H * EPI_DATA_D * EPI_DATA_T;
+    outputNiftifMRI->nvox = EPI_DATA_W * EPI_DATA_H * EPI_DATA_D * EPI_DATA_T;
     allNiftiImages[numberOfNiftiImages] = outputNiftifMRI;
 	numberOfNiftiImages++;
     
@@ -4151,6 +4564,43 @@ int main(int argc, char **argv)
     	    WriteNifti(outputNiftiStatisticsEPI,h_AR1_Estimates_EPI,"_ar1_estimates_EPI",ADD_FILENAME,DONT_CHECK_EXISTING_FILE);
     	}    
 
+		// Convergence of the MCMC chains, largest split-R-hat, smallest effective sample size and number of iterations per chain
+		if (BAYESIAN && !VARIATIONAL_BAYES)
+		{
+    	    WriteNifti(outputNiftiStatisticsEPI,&h_MCMC_Diagnostics_EPI[0 * EPI_DATA_W * EPI_DATA_H * EPI_DATA_D],"_mcmc_rhat_EPI",ADD_FILENAME,DONT_CHECK_EXISTING_FILE);
+    	    WriteNifti(outputNiftiStatisticsEPI,&h_MCMC_Diagnostics_EPI[1 * EPI_DATA_W * EPI_DATA_H * EPI_DATA_D],"_mcmc_ess_EPI",ADD_FILENAME,DONT_CHECK_EXISTING_FILE);
+    	    WriteNifti(outputNiftiStatisticsEPI,&h_MCMC_Diagnostics_EPI[2 * EPI_DATA_W * EPI_DATA_H * EPI_DATA_D],"_mcmc_iterations_EPI",ADD_FILENAME,DONT_CHECK_EXISTING_FILE);
+		}
+		// Posterior variance of each regression weight, for variational Bayes
+		else if (BAYESIAN && VARIATIONAL_BAYES)
+		{
+    	    for (size_t i = 0; i < NUMBER_OF_TOTAL_GLM_REGRESSORS; i++)
+    	    {
+    	        std::string temp = "_posterior_variance";
+    	        std::stringstream ss;
+				if ((i+1) < 10)
+				{
+    	            ss << "_regressor000";
+				}
+				else if ((i+1) < 100)
+				{
+					ss << "_regressor00";
+				}
+				else if ((i+1) < 1000)
+				{
+					ss << "_regressor0";
+				}
+				else
+				{
+					ss << "_regressor";
+				}						
+				ss << i + 1;
+    	        temp.append(ss.str());
+    	        temp.append(epi);
+    	        WriteNifti(outputNiftiStatisticsEPI,&h_Posterior_Variances_EPI[i * EPI_DATA_W * EPI_DATA_H * EPI_DATA_D],temp.c_str(),ADD_FILENAME,DONT_CHECK_EXISTING_FILE);
+    	    }
+		}
+
 		if (WRITE_RESIDUALS_EPI && !BAYESIAN && !BETAS_ONLY)
 		{
 		    outputNiftiStatisticsEPI->ndim = 4;
@@ -4591,6 +5041,12 @@ int main(int argc, char **argv)
     FreeAllNiftiImages(allNiftiImages,numberOfNiftiImages);
 
 	free(EPI_DATA_T_PER_RUN);
+
+    if (!BROCCOLI.GetMutualInformationGradientCorrect())
+    {
+        printf("The analytic gradient of the normalized mutual information does not agree with the finite differences!\n");
+        return EXIT_FAILURE;
+    }
     
     return EXIT_SUCCESS;
 }
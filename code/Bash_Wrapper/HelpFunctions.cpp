@@ -428,3 +428,57 @@ double GetWallTime()
     return (double)time.tv_sec + (double)time.tv_usec * .000001;
 }
 
+// Reads the SliceTiming array (in seconds) from a BIDS json sidecar, returns the number of slice times that were read, or -1 if the file or the array could not be read
+int ReadBIDSSliceTiming(const char* filename, float* sliceTimes, int maxSlices)
+{
+    std::ifstream file;
+    file.open(filename);
+
+    if (!file.good())
+    {
+        file.close();
+        return -1;
+    }
+
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+
+    size_t position = content.find("\"SliceTiming\"");
+    if (position == std::string::npos)
+    {
+        return -1;
+    }
+
+    position = content.find('[', position);
+    size_t end = content.find(']', position);
+    if ((position == std::string::npos) || (end == std::string::npos))
+    {
+        return -1;
+    }
+
+    const char* p = content.c_str() + position + 1;
+    const char* stop = content.c_str() + end;
+    int numberOfSlices = 0;
+
+    while (p < stop)
+    {
+        char* next;
+        double time = strtod(p, &next);
+        if (next == p)
+        {
+            // Skip separators
+            p++;
+            continue;
+        }
+        if (numberOfSlices >= maxSlices)
+        {
+            return -1;
+        }
+        sliceTimes[numberOfSlices] = (float)time;
+        numberOfSlices++;
+        p = next;
+    }
+
+    return numberOfSlices;
+}
+
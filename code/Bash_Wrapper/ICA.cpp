@@ -36,6 +36,84 @@
 #define CHECK_EXISTING_FILE true
 #define DONT_CHECK_EXISTING_FILE false
 
+// Reads one subject for group ICA and converts the data to floats, only the header is kept in the nifti image
+float* ReadGroupICASubject(nifti_image *& subjectData, const char* filename, size_t DATA_W, size_t DATA_H, size_t DATA_D)
+{
+	subjectData = nifti_image_read(filename,1);
+	if (subjectData == NULL)
+	{
+		printf("Could not open nifti file %s !\n",filename);
+		return NULL;
+	}
+
+	if ( (subjectData->nx != DATA_W) || (subjectData->ny != DATA_H) || (subjectData->nz != DATA_D) )
+	{
+		printf("%s has the dimensions %i x %i x %i, while the first subject has the dimensions %zu x %zu x %zu. Aborting! \n",filename,subjectData->nx,subjectData->ny,subjectData->nz,DATA_W,DATA_H,DATA_D);
+		nifti_image_free(subjectData);
+		subjectData = NULL;
+		return NULL;
+	}
+
+	size_t N = DATA_W * DATA_H * DATA_D * subjectData->nt;
+	float* h_Subject_Volumes = NULL;
+
+	// If the data is in float format, we can just copy the pointer
+	if ( subjectData->datatype == DT_FLOAT )
+	{
+		h_Subject_Volumes = (float*)subjectData->data;
+		subjectData->data = NULL;
+		return h_Subject_Volumes;
+	}
+
+	h_Subject_Volumes = (float*)malloc(N * sizeof(float));
+	if (h_Subject_Volumes == NULL)
+	{
+		printf("Could not allocate host memory for %s ! \n",filename);
+		nifti_image_free(subjectData);
+		subjectData = NULL;
+		return NULL;
+	}
+
+	if ( subjectData->datatype == DT_SIGNED_SHORT )
+	{
+		short int *p = (short int*)subjectData->data;
+		for (size_t i = 0; i < N; i++)
+		{
+			h_Subject_Volumes[i] = (float)p[i];
+		}
+	}
+	else if ( subjectData->datatype == DT_UINT8 )
+	{
+		unsigned char *p = (unsigned char*)subjectData->data;
+		for (size_t i = 0; i < N; i++)
+		{
+			h_Subject_Volumes[i] = (float)p[i];
+		}
+	}
+	else if ( subjectData->datatype == DT_UINT16 )
+	{
+		unsigned short int *p = (unsigned short int*)subjectData->data;
+		for (size_t i = 0; i < N; i++)
+		{
+			h_Subject_Volumes[i] = (float)p[i];
+		}
+	}
+	else
+	{
+		printf("Unknown data type in %s, aborting!\n",filename);
+		free(h_Subject_Volumes);
+		nifti_image_free(subjectData);
+		subjectData = NULL;
+		return NULL;
+	}
+
+	// Free input fMRI data, it has been converted to floats
+	free(subjectData->data);
+	subjectData->data = NULL;
+
+	return h_Subject_Volumes;
+}
+
 int main(int argc, char ** argv)
 {
     //-----------------------
@@ -43,6 +121,9 @@ int main(int argc, char ** argv)
     
     float           *h_fMRI_Volumes = NULL;
 	float			*h_EPI_Mask = NULL;
+	float			*h_Group_ICA_Maps = NULL;
+	float			*h_Subject_ICA_Maps = NULL;
+	float			*h_Subject_ICA_Z_Maps = NULL;
 
     float           *h_Quadrature_Filter_1_Real = NULL;
     float           *h_Quadrature_Filter_2_Real = NULL;
@@ -87,11 +168,18 @@ int main(int argc, char ** argv)
 
 	// Settings
 	bool			AUTO_MASK = true;
+	int				MASKING_METHOD = 0;
+	int				MASK_CLOSING_ITERATIONS = 2;
 	bool			MASK = false;
 	const char*		MASK_NAME;
 	bool			Z_SCORE = false;
 	bool			CPU = false;
 	bool			DOUBLEPRECISION = false;
+	int				ICA_ALGORITHM = INFOMAX;
+	int				FASTICA_NONLINEARITY = 0;
+	bool			GROUP = false;
+	size_t			NUMBER_OF_ICA_SUBJECT_COMPONENTS = 100;
+	std::vector<std::string> subjectFilenames;
 	
 	size_t			NUMBER_OF_ICA_COMPONENTS = 55;
 
@@ -113,6 +201,7 @@ int main(int argc, char ** argv)
     {        
         printf("Usage:\n\n");
         printf("ICA input.nii [options]\n\n");
+        printf("ICA subjects.txt -group [options]\n\n");
         printf("Options:\n\n");
         printf(" -platform           The OpenCL platform to use (default 0) \n");
         printf(" -device             The OpenCL device to use for the specificed platform (default 0) \n");
@@ -121,6 +210,12 @@ int main(int argc, char ** argv)
 		printf(" -zscore             Z-score each time series before ICA (default false) \n");
 		printf(" -cpu	             Use the CPU only (default false) \n");
 		printf(" -double             Use double precision (default false) \n");
+		printf(" -fastica            Use symmetric fixed point FastICA instead of Infomax (default false) \n");
+		printf(" -nonlinearity       Nonlinearity for FastICA, 0 = log cosh, 1 = cube (kurtosis) (default 0) \n");
+		printf(" -group              The input is a text file with one 4D nifti file per subject, temporal concatenation group ICA on the CPU followed by dual regression, which runs on the device unless -cpu or -zscore is used or there are more than 24 group components (default false) \n");
+		printf(" -subjectcomponents  Number of components kept for every subject, and for the reduced group data, in group ICA (default 100) \n");
+		printf(" -maskmethod         Method for the automatic brain mask, 0 = 90%% of mean intensity, 1 = Otsu threshold, 2 = two class Gaussian mixture (default 0)\n");
+		printf(" -maskclosing        Number of closing iterations for the automatic brain mask, only used by mask methods 1 and 2 (default 2)\n");
         printf(" -output             Set output filename (default input_ica.nii) \n");
         printf(" -quiet              Don't print anything to the terminal (default false) \n");
         printf(" -verbose            Print extra stuff (default false) \n");
@@ -246,6 +341,105 @@ int main(int argc, char ** argv)
             DOUBLEPRECISION = true;
             i += 1;
         }
+        else if (strcmp(input,"-fastica") == 0)
+        {
+            ICA_ALGORITHM = FASTICA;
+            i += 1;
+        }
+        else if (strcmp(input,"-nonlinearity") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -nonlinearity !\n");
+                return EXIT_FAILURE;
+			}
+
+            FASTICA_NONLINEARITY = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Nonlinearity must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if ((FASTICA_NONLINEARITY < 0) || (FASTICA_NONLINEARITY > 1))
+            {
+                printf("Nonlinearity must be 0 or 1 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-group") == 0)
+        {
+            GROUP = true;
+            i += 1;
+        }
+        else if (strcmp(input,"-subjectcomponents") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -subjectcomponents !\n");
+                return EXIT_FAILURE;
+			}
+
+            int components = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Number of subject components must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (components <= 0)
+            {
+                printf("Number of subject components must be > 0 !\n");
+                return EXIT_FAILURE;
+            }
+            NUMBER_OF_ICA_SUBJECT_COMPONENTS = (size_t)components;
+            i += 2;
+        }
+        else if (strcmp(input,"-maskmethod") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -maskmethod !\n");
+                return EXIT_FAILURE;
+			}
+
+            MASKING_METHOD = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Mask method must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if ((MASKING_METHOD < 0) || (MASKING_METHOD > 2))
+            {
+                printf("Mask method must be 0, 1 or 2 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-maskclosing") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -maskclosing !\n");
+                return EXIT_FAILURE;
+			}
+
+            MASK_CLOSING_ITERATIONS = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Number of mask closing iterations must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (MASK_CLOSING_ITERATIONS < 0)
+            {
+                printf("Number of mask closing iterations must be >= 0 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
         else if (strcmp(input,"-debug") == 0)
         {
             DEBUG = true;
@@ -288,12 +482,61 @@ int main(int argc, char ** argv)
         return EXIT_FAILURE;
 	}
 
+	// Read the names of all subjects, the first subject is read as the input data
+	const char* inputFilename = argv[1];
+	if (GROUP)
+	{
+		std::ifstream subjects;
+		subjects.open(argv[1]);
+
+	    if (!subjects.good())
+	    {
+	        subjects.close();
+	        printf("Unable to open subject file %s. Aborting! \n",argv[1]);
+	        return EXIT_FAILURE;
+	    }
+
+		std::string name;
+		while (subjects >> name)
+		{
+			std::string extension;
+			bool extensionOK;
+			CheckFileExtension(name.c_str(),extensionOK,extension);
+			if (!extensionOK)
+			{
+				subjects.close();
+	            printf("File extension of %s is not .nii or .nii.gz, %s is not allowed!\n",name.c_str(),extension.c_str());
+	            return EXIT_FAILURE;
+			}
+
+	        fp = fopen(name.c_str(),"r");
+	        if (fp == NULL)
+	        {
+				subjects.close();
+	            printf("Could not open file %s !\n",name.c_str());
+	            return EXIT_FAILURE;
+	        }
+	        fclose(fp);
+
+			subjectFilenames.push_back(name);
+		}
+		subjects.close();
+
+		if (subjectFilenames.size() == 0)
+		{
+	        printf("No subjects in %s. Aborting! \n",argv[1]);
+	        return EXIT_FAILURE;
+		}
+
+		inputFilename = subjectFilenames[0].c_str();
+	}
+
     double startTime = GetWallTime();
 
 	// ---------------------
     // Read data
 	// ---------------------
-    nifti_image *inputData = nifti_image_read(argv[1],1);
+    nifti_image *inputData = nifti_image_read(inputFilename,1);
     
     if (inputData == NULL)
     {
@@ -605,6 +848,8 @@ int main(int argc, char ** argv)
         BROCCOLI.SetEPITimepoints(DATA_T);  
 
 		BROCCOLI.SetAutoMask(AUTO_MASK);
+		BROCCOLI.SetMaskingMethod(MASKING_METHOD);
+		BROCCOLI.SetMaskClosingIterations(MASK_CLOSING_ITERATIONS);
 		BROCCOLI.SetZScore(Z_SCORE);
 
 		BROCCOLI.SetOutputEPIMask(h_EPI_Mask);
@@ -613,10 +858,190 @@ int main(int argc, char ** argv)
           
 		BROCCOLI.SetVarianceToSaveBeforeICA(PROPORTION_OF_VARIANCE_TO_SAVE_BEFORE_ICA);                  
 		BROCCOLI.SetNumberOfICAComponents(NUMBER_OF_ICA_COMPONENTS);
+		BROCCOLI.SetICAAlgorithm(ICA_ALGORITHM);
+		BROCCOLI.SetFastICANonlinearity(FASTICA_NONLINEARITY);
+		BROCCOLI.SetNumberOfICASubjectComponents(NUMBER_OF_ICA_SUBJECT_COMPONENTS);
    
         // Run the actual ICA
 		startTime = GetWallTime();   
-		if (DOUBLEPRECISION)
+		if (GROUP)
+		{
+			size_t NUMBER_OF_SUBJECTS = subjectFilenames.size();
+
+			// The reduced group data has at most NUMBER_OF_ICA_SUBJECT_COMPONENTS components, so this is enough for the group maps
+			AllocateMemory(h_Group_ICA_Maps, VOLUME_SIZE * NUMBER_OF_ICA_SUBJECT_COMPONENTS, allMemoryPointers, numberOfMemoryPointers, allNiftiImages, numberOfNiftiImages, allocatedHostMemory, "GROUP_ICA_MAPS");
+			AllocateMemory(h_Subject_ICA_Maps, VOLUME_SIZE * NUMBER_OF_ICA_SUBJECT_COMPONENTS, allMemoryPointers, numberOfMemoryPointers, allNiftiImages, numberOfNiftiImages, allocatedHostMemory, "SUBJECT_ICA_MAPS");
+			AllocateMemory(h_Subject_ICA_Z_Maps, VOLUME_SIZE * NUMBER_OF_ICA_SUBJECT_COMPONENTS, allMemoryPointers, numberOfMemoryPointers, allNiftiImages, numberOfNiftiImages, allocatedHostMemory, "SUBJECT_ICA_Z_MAPS");
+
+			BROCCOLI.SetOutputGroupICAMaps(h_Group_ICA_Maps);
+			BROCCOLI.SetOutputSubjectICAMaps(h_Subject_ICA_Maps);
+			BROCCOLI.SetOutputSubjectICAZMaps(h_Subject_ICA_Z_Maps);
+
+			// First pass, reduce every subject over time and add it to the reduced group data, only one subject is in memory at a time
+			for (size_t subject = 0; subject < NUMBER_OF_SUBJECTS; subject++)
+			{
+				nifti_image *subjectData = NULL;
+				float *h_Subject_Volumes = h_fMRI_Volumes;
+				size_t SUBJECT_T = DATA_T;
+
+				// The first subject has already been read
+				if (subject > 0)
+				{
+					h_Subject_Volumes = ReadGroupICASubject(subjectData, subjectFilenames[subject].c_str(), DATA_W, DATA_H, DATA_D);
+					if (h_Subject_Volumes == NULL)
+					{
+				        FreeAllMemory(allMemoryPointers,numberOfMemoryPointers);
+				        FreeAllNiftiImages(allNiftiImages,numberOfNiftiImages);
+				        return EXIT_FAILURE;
+					}
+					SUBJECT_T = subjectData->nt;
+				}
+
+				if (PRINT)
+				{
+					printf("Reducing subject %zu of %zu, %s \n",subject+1,NUMBER_OF_SUBJECTS,subjectFilenames[subject].c_str());
+				}
+
+				BROCCOLI.SetInputfMRIVolumes(h_Subject_Volumes);
+				BROCCOLI.SetEPITimepoints(SUBJECT_T);
+				BROCCOLI.PerformGroupICASubjectReductionCPUWrapper();
+
+				// Free the first subject as well, to not keep two subjects in memory
+				if (subject == 0)
+				{
+					for (int p = 0; p < numberOfMemoryPointers; p++)
+					{
+						if (allMemoryPointers[p] == (void*)h_fMRI_Volumes)
+						{
+							allMemoryPointers[p] = NULL;
+						}
+					}
+					h_fMRI_Volumes = NULL;
+				}
+				else
+				{
+					nifti_image_free(subjectData);
+				}
+				free(h_Subject_Volumes);
+			}
+
+			// Group PCA and ICA of the reduced group data
+			BROCCOLI.PerformGroupICACPUWrapper();
+
+			size_t NUMBER_OF_COMPONENTS = BROCCOLI.GetNumberOfICAComponents();
+
+			std::string groupFilename;
+			if (CHANGE_OUTPUT_FILENAME)
+			{
+				groupFilename = outputFilename;
+			}
+			else
+			{
+				groupFilename = argv[1];
+				size_t dot = groupFilename.find_last_of('.');
+				if (dot != std::string::npos)
+				{
+					groupFilename = groupFilename.substr(0,dot);
+				}
+				groupFilename.append("_group_ica.nii");
+			}
+
+			nifti_image *groupOutputData = nifti_copy_nim_info(inputData);
+			groupOutputData->nt = NUMBER_OF_COMPONENTS;
+			groupOutputData->dim[4] = NUMBER_OF_COMPONENTS;
+			groupOutputData->nvox = DATA_W * DATA_H * DATA_D * NUMBER_OF_COMPONENTS;
+			nifti_free_extensions(groupOutputData);
+			allNiftiImages[numberOfNiftiImages] = groupOutputData;
+			numberOfNiftiImages++;
+
+			nifti_set_filenames(groupOutputData, groupFilename.c_str(), 0, 1);
+			WriteNifti(groupOutputData,h_Group_ICA_Maps,"",DONT_ADD_FILENAME,DONT_CHECK_EXISTING_FILE);
+
+			// Second pass, dual regression of the group maps for every subject, the group maps stay on the device for all subjects
+			for (size_t subject = 0; subject < NUMBER_OF_SUBJECTS; subject++)
+			{
+				nifti_image *subjectData = NULL;
+				float *h_Subject_Volumes = ReadGroupICASubject(subjectData, subjectFilenames[subject].c_str(), DATA_W, DATA_H, DATA_D);
+				if (h_Subject_Volumes == NULL)
+				{
+			        FreeAllMemory(allMemoryPointers,numberOfMemoryPointers);
+			        FreeAllNiftiImages(allNiftiImages,numberOfNiftiImages);
+			        return EXIT_FAILURE;
+				}
+				size_t SUBJECT_T = subjectData->nt;
+
+				if (PRINT)
+				{
+					printf("Dual regression for subject %zu of %zu, %s \n",subject+1,NUMBER_OF_SUBJECTS,subjectFilenames[subject].c_str());
+				}
+
+				float *h_Subject_ICA_Time_Courses = (float*)malloc(SUBJECT_T * NUMBER_OF_COMPONENTS * sizeof(float));
+				if (h_Subject_ICA_Time_Courses == NULL)
+				{
+					perror ("The following error occurred");
+					printf("Could not allocate host memory for the time courses of subject %s ! \n",subjectFilenames[subject].c_str());
+					free(h_Subject_Volumes);
+					nifti_image_free(subjectData);
+			        FreeAllMemory(allMemoryPointers,numberOfMemoryPointers);
+			        FreeAllNiftiImages(allNiftiImages,numberOfNiftiImages);
+			        return EXIT_FAILURE;
+				}
+
+				BROCCOLI.SetInputfMRIVolumes(h_Subject_Volumes);
+				BROCCOLI.SetEPITimepoints(SUBJECT_T);
+				BROCCOLI.SetOutputSubjectICATimeCourses(h_Subject_ICA_Time_Courses);
+				if (CPU)
+				{
+					BROCCOLI.PerformGroupICADualRegressionCPUWrapper();
+				}
+				else
+				{
+					BROCCOLI.PerformGroupICADualRegressionWrapper();
+				}
+
+				free(h_Subject_Volumes);
+
+				// Write subject maps
+				nifti_image *subjectOutputData = nifti_copy_nim_info(subjectData);
+				subjectOutputData->nt = NUMBER_OF_COMPONENTS;
+				subjectOutputData->dim[4] = NUMBER_OF_COMPONENTS;
+				subjectOutputData->nvox = DATA_W * DATA_H * DATA_D * NUMBER_OF_COMPONENTS;
+				nifti_free_extensions(subjectOutputData);
+				WriteNifti(subjectOutputData,h_Subject_ICA_Maps,"_ica_maps",ADD_FILENAME,DONT_CHECK_EXISTING_FILE);
+				WriteNifti(subjectOutputData,h_Subject_ICA_Z_Maps,"_ica_zmaps",ADD_FILENAME,DONT_CHECK_EXISTING_FILE);
+				nifti_image_free(subjectOutputData);
+
+				// Write subject time courses, one column per component
+				char* filenameWithExtension;
+				CreateFilename(filenameWithExtension, subjectData, "_ica_timecourses.1D", false, NULL);
+
+			    std::ofstream timecourses;
+			    timecourses.open(filenameWithExtension);      
+
+			    if ( timecourses.good() )
+			    {
+			        timecourses.precision(6);
+			        for (size_t t = 0; t < SUBJECT_T; t++)
+			        {
+						for (size_t c = 0; c < NUMBER_OF_COMPONENTS; c++)
+						{
+				            timecourses << h_Subject_ICA_Time_Courses[t + c * SUBJECT_T] << "  ";
+						}
+						timecourses << std::endl;
+			        }
+			        timecourses.close();
+			    }
+			    else
+			    {
+			        printf("Could not open %s for writing!\n",filenameWithExtension);
+			    }
+				free(filenameWithExtension);
+
+				free(h_Subject_ICA_Time_Courses);
+				nifti_image_free(subjectData);
+			}
+		}
+		else if (DOUBLEPRECISION)
 		{
 			if (CPU)
 			{     
@@ -676,6 +1101,14 @@ int main(int argc, char ** argv)
         } 
     }
         
+	// The group maps and the subject results have already been written
+	if (GROUP)
+	{
+	    FreeAllMemory(allMemoryPointers,numberOfMemoryPointers);            
+	    FreeAllNiftiImages(allNiftiImages,numberOfNiftiImages);
+		return EXIT_SUCCESS;
+	}
+
     // Write results to file           
     startTime = GetWallTime();
 
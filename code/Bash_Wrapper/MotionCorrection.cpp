@@ -85,6 +85,7 @@ int main(int argc, char ** argv)
 	bool			VERBOS = false;
 	bool			CHANGE_OUTPUT_FILENAME = false;
 	bool			CHANGE_REFERENCE_VOLUME = false;
+	bool			TWO_PASS = false;
 	const char*		referenceVolumeFilename;
     
     size_t          DATA_W, DATA_H, DATA_D, DATA_T;
@@ -122,6 +123,7 @@ int main(int argc, char ** argv)
         printf(" -device             The OpenCL device to use for the specificed platform (default 0) \n");
         printf(" -referencevolume    Give a reference volume to align all other volumes to (default false) \n");        
         printf(" -iterations         Number of iterations for the motion correction algorithm (default 5) \n");        
+        printf(" -twopass            Align all volumes to the reference volume, and then realign all volumes to the mean of the aligned volumes (default false) \n");
         printf(" -output             Set output filename (default input_mc.nii) \n");
         printf(" -quiet              Don't print anything to the terminal (default false) \n");
         printf(" -verbose            Print extra stuff (default false) \n");
@@ -236,6 +238,11 @@ int main(int argc, char ** argv)
             }
             i += 2;
         }
+        else if (strcmp(input,"-twopass") == 0)
+        {
+            TWO_PASS = true;
+            i += 1;
+        }
         else if (strcmp(input,"-debug") == 0)
         {
             DEBUG = true;
@@ -671,6 +678,7 @@ int main(int argc, char ** argv)
         
 		BROCCOLI.SetChangeMotionCorrectionReferenceVolume(CHANGE_REFERENCE_VOLUME);
 		BROCCOLI.SetMotionCorrectionReferenceVolume(h_Reference_Volume);
+		BROCCOLI.SetMotionCorrectionTwoPass(TWO_PASS);
 
         BROCCOLI.SetImageRegistrationFilterSize(MOTION_CORRECTION_FILTER_SIZE);
         BROCCOLI.SetLinearImageRegistrationFilters(h_Quadrature_Filter_1_Real, h_Quadrature_Filter_1_Imag, h_Quadrature_Filter_2_Real, h_Quadrature_Filter_2_Imag, h_Quadrature_Filter_3_Real, h_Quadrature_Filter_3_Imag);
@@ -95,6 +95,7 @@ int main(int argc, char **argv)
 	size_t			NUMBER_OF_CONTRASTS = 1; 
     float           CLUSTER_DEFINING_THRESHOLD = 2.5f;
 	size_t			NUMBER_OF_PERMUTATIONS = 5000;
+	unsigned int	RANDOM_SEED = 0;
 	size_t			NUMBER_OF_PERMUTATIONS_PER_CONTRAST[1000];
 	float			SIGNIFICANCE_LEVEL = 0.05f;
 	int				STATISTICAL_TEST = 0;
@@ -158,6 +159,7 @@ int main(int argc, char **argv)
 	    printf(" -groupmean                 Test for group mean, using sign flipping (design and contrast not needed) \n");
         printf(" -mask                      A mask that defines which voxels to permute (default none) \n");
         printf(" -permutations              Number of permutations to use (default 5,000) \n");
+        printf(" -seed                      Seed for the random permutations (default 0) \n");
         printf(" -teststatistics            Test statistics to use, 0 = GLM t-test, 1 = GLM F-test  (default 0) \n");
         printf(" -inferencemode             Inference mode to use, 0 = voxel, 1 = cluster extent, 2 = cluster mass, 3 = TFCE (default 1) \n");
         printf(" -cdt                       Cluster defining threshold for cluster inference (default 2.5) \n");
@@ -406,6 +408,23 @@ int main(int argc, char **argv)
             DEBUG = true;
             i += 1;
         }
+        else if (strcmp(input,"-seed") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -seed !\n");
+                return EXIT_FAILURE;
+			}
+
+            RANDOM_SEED = (unsigned int)strtoul(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Seed must be a non-negative integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            i += 2;
+        }
         else if (strcmp(input,"-quiet") == 0)
         {
             PRINT = false;
@@ -1500,6 +1519,7 @@ int main(int argc, char **argv)
         BROCCOLI.SetNumberOfSubjectsGroup1(NUMBER_OF_SUBJECTS_IN_GROUP1);
         BROCCOLI.SetNumberOfSubjectsGroup2(NUMBER_OF_SUBJECTS_IN_GROUP2);
         BROCCOLI.SetNumberOfPermutations(NUMBER_OF_PERMUTATIONS);
+        BROCCOLI.SetRandomSeed(RANDOM_SEED);
         BROCCOLI.SetNumberOfGroupPermutations(NUMBER_OF_PERMUTATIONS_PER_CONTRAST);
         BROCCOLI.SetNumberOfGLMRegressors(NUMBER_OF_GLM_REGRESSORS);
         BROCCOLI.SetNumberOfContrasts(NUMBER_OF_CONTRASTS);    
@@ -51,7 +51,7 @@ int main(int argc, char **argv)
     unsigned short int        **h_Permutation_Matrices, *h_Permutation_Matrix;
 	float			*h_Sign_Matrix;
     
-    float           *h_Correct_Classes, *h_d;
+    float           *h_Correct_Classes, *h_d, *h_Blocks;
                   
     //-----------------------
     // Output
@@ -92,11 +92,19 @@ int main(int argc, char **argv)
                    
     float           CLUSTER_DEFINING_THRESHOLD = 2.5f;
 	size_t			NUMBER_OF_PERMUTATIONS = 5000;
+	unsigned int	RANDOM_SEED = 0;
 	float			SIGNIFICANCE_LEVEL = 0.05f;
 	int				INFERENCE_MODE = 1;
 	bool			MASK = false;
+	int				CLASSIFIER = 0;
+	float			RADIUS = 1.0f;
+	int				NUMBER_OF_FOLDS = 5;
+	float			REGULARIZATION = 0.1f;
+	bool			PERMUTE = false;
+	bool			BLOCKS = false;
 	const char*		MASK_NAME;
 	const char*		CLASS_FILE;
+	const char*		BLOCK_FILE;
 	const char* 	PERMUTATION_INPUT_FILE;
 	const char* 	PERMUTATION_VALUES_FILE;
 	const char* 	PERMUTATION_VECTORS_FILE;
@@ -129,13 +137,19 @@ int main(int argc, char **argv)
         printf(" -device                    The OpenCL device to use for the specificed platform (default 0) \n");
         printf(" -classes                   Classes for training and testing of the classifier \n");
         printf(" -mask                      A mask that defines which voxels to analyze (default none) \n");
-        //printf(" -radius                  Radius of search light (default 1 = 7 voxels) \n");
-        //printf(" -classifier              Classifier to use, 0 = neural network, 1 = SVM (default 1) \n");
+        printf(" -classifier                Classifier to use, 0 = perceptron (19 voxels, leave one out), 1 = regularised LDA, 2 = ridge regression (default 0) \n");
+        printf(" -radius                    Radius of the searchlight in voxels for classifier 1 and 2 (default 1 = 7 voxels, 2 = 33 voxels, 3 = 123 voxels) \n");
+        printf(" -folds                     Number of folds of consecutive volumes for classifier 1 and 2, 0 = leave one out (default 5) \n");
+        printf(" -regularization            Regularization for classifier 1 and 2, relative to the mean variance in the searchlight (default 0.1) \n");
+        printf(" -permute                   Apply a permutation test to the classifier performance, gives FWE corrected p-values (voxel level inference) \n");
+        printf(" -permutations              Number of permutations to use for the permutation test (default 5000) \n");
+        printf(" -seed                      Seed for the random permutations (default 0) \n");
+        printf(" -blocks                    Exchangeability blocks (e.g. runs), the classes are only permuted within a block, same format as the class file (default none) \n");
         //printf(" -inferencemode             Inference mode to use, 0 = voxel, 1 = cluster extent, 2 = cluster mass, 3 = TFCE (default 1) \n");
         //printf(" -cdt                       Cluster defining threshold for cluster inference (default 2.5) \n");
-        //printf(" -significance              The significance level to calculate the threshold for (default 0.05) \n");
-		//printf(" -output                    Set output filename (default volumes_perm_tvalues.nii and volumes_perm_pvalues.nii) \n");
-		//printf(" -writepermutationvalues    Write all the permutation values to a text file \n");
+        printf(" -significance              The significance level to calculate the threshold for (default 0.05) \n");
+		printf(" -output                    Set output filename (default volumes_classifier_performance.nii and volumes_perm_pvalues.nii) \n");
+		printf(" -writepermutationvalues    Write all the permutation values to a text file \n");
 		//printf(" -writepermutations         Write all the random permutations (or sign flips) to a text file \n");
 		//printf(" -permutationfile           Use a specific permutation file or sign flipping file (e.g. from FSL) \n");
         printf(" -quiet                     Don't print anything to the terminal (default false) \n");
@@ -219,6 +233,23 @@ int main(int argc, char **argv)
 			FOUND_CLASSES = true;
             i += 2;
         }
+        else if (strcmp(input,"-permute") == 0)
+        {
+            PERMUTE = true;
+            i += 1;
+        }
+        else if (strcmp(input,"-blocks") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read name after -blocks !\n");
+                return EXIT_FAILURE;
+			}
+
+            BLOCK_FILE = argv[i+1];
+			BLOCKS = true;
+            i += 2;
+        }
         else if (strcmp(input,"-permutations") == 0)
         {
 			if ( (i+1) >= argc  )
@@ -309,6 +340,94 @@ int main(int argc, char **argv)
 				return EXIT_FAILURE;
 		    }
             i += 2;
+        }
+        else if (strcmp(input,"-classifier") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -classifier !\n");
+                return EXIT_FAILURE;
+			}
+
+            CLASSIFIER = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Classifier must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if ( (CLASSIFIER != 0) && (CLASSIFIER != 1) && (CLASSIFIER != 2) )
+            {
+                printf("Classifier must be 0, 1 or 2 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-radius") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -radius !\n");
+                return EXIT_FAILURE;
+			}
+
+            RADIUS = (float)strtod(argv[i+1], &p);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Radius must be a float! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (RADIUS < 1.0f)
+            {
+                printf("Radius must be >= 1 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-folds") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -folds !\n");
+                return EXIT_FAILURE;
+			}
+
+            NUMBER_OF_FOLDS = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Number of folds must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if ( (NUMBER_OF_FOLDS < 0) || (NUMBER_OF_FOLDS == 1) )
+            {
+                printf("Number of folds must be 0 or >= 2 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-regularization") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -regularization !\n");
+                return EXIT_FAILURE;
+			}
+
+            REGULARIZATION = (float)strtod(argv[i+1], &p);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Regularization must be a float! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (REGULARIZATION < 0.0f)
+            {
+                printf("Regularization must be >= 0 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
         }
 		else if (strcmp(input,"-mask") == 0)
         {
@@ -327,6 +446,23 @@ int main(int argc, char **argv)
             DEBUG = true;
             i += 1;
         }
+        else if (strcmp(input,"-seed") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -seed !\n");
+                return EXIT_FAILURE;
+			}
+
+            RANDOM_SEED = (unsigned int)strtoul(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Seed must be a non-negative integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            i += 2;
+        }
         else if (strcmp(input,"-quiet") == 0)
         {
             PRINT = false;
@@ -540,8 +676,16 @@ int main(int argc, char **argv)
     AllocateMemory(h_Classifier_Performance, VOLUME_SIZE, allMemoryPointers, numberOfMemoryPointers, allNiftiImages, numberOfNiftiImages, allocatedHostMemory, "CLASSIFIER_PERFORMANCE");
 	AllocateMemory(h_Correct_Classes, CLASS_SIZE, allMemoryPointers, numberOfMemoryPointers, allNiftiImages, numberOfNiftiImages, allocatedHostMemory, "CLASSES");
     AllocateMemory(h_d, CLASS_SIZE, allMemoryPointers, numberOfMemoryPointers, allNiftiImages, numberOfNiftiImages, allocatedHostMemory, "D");
-                        
-	//AllocateMemory(h_P_Values, STATISTICAL_MAPS_SIZE, allMemoryPointers, numberOfMemoryPointers, allNiftiImages, numberOfNiftiImages, allocatedHostMemory, "PERMUTATION_PVALUES");
+
+	if (PERMUTE)
+	{
+		AllocateMemory(h_P_Values, VOLUME_SIZE, allMemoryPointers, numberOfMemoryPointers, allNiftiImages, numberOfNiftiImages, allocatedHostMemory, "PERMUTATION_PVALUES");
+		AllocateMemory(h_Permutation_Distribution, NUMBER_OF_PERMUTATIONS * sizeof(float), allMemoryPointers, numberOfMemoryPointers, allNiftiImages, numberOfNiftiImages, allocatedHostMemory, "PERMUTATION_DISTRIBUTION");
+	}
+	if (BLOCKS)
+	{
+		AllocateMemory(h_Blocks, CLASS_SIZE, allMemoryPointers, numberOfMemoryPointers, allNiftiImages, numberOfNiftiImages, allocatedHostMemory, "BLOCKS");
+	}
 
 	//h_Permutation_Distributions = (float**)malloc(NUMBER_OF_CONTRASTS * sizeof(float*));
 	//h_Permutation_Matrices = (unsigned short int**)malloc(NUMBER_OF_CONTRASTS * sizeof(unsigned short int*));
@@ -574,6 +718,55 @@ int main(int argc, char **argv)
     }
     design.close();
 
+	// Read exchangeability blocks from file, same format as the class file
+	if (BLOCKS)
+	{
+		std::ifstream blocks;
+	    blocks.open(BLOCK_FILE);
+
+	    if (!blocks.good())
+	    {
+	        blocks.close();
+	        printf("Unable to open block file %s. Aborting! \n",BLOCK_FILE);
+	        FreeAllMemory(allMemoryPointers,numberOfMemoryPointers);
+	        FreeAllNiftiImages(allNiftiImages,numberOfNiftiImages);
+	        return EXIT_FAILURE;
+	    }
+
+	    blocks >> tempString; // NumVolumes as string
+	    if (tempString.compare(NV) != 0)
+	    {
+	        blocks.close();
+	        printf("First element of the block file should be the string 'NumVolumes', but it is %s. Aborting! \n",tempString.c_str());
+	        FreeAllMemory(allMemoryPointers,numberOfMemoryPointers);
+	        FreeAllNiftiImages(allNiftiImages,numberOfNiftiImages);
+	        return EXIT_FAILURE;
+	    }
+	    blocks >> tempNumber;
+
+	    if ( tempNumber != NUMBER_OF_VOLUMES )
+	    {
+	        blocks.close();
+	        printf("Input data contains %zu volumes, while the block file says %i volumes. Aborting! \n",NUMBER_OF_VOLUMES,tempNumber);
+	        FreeAllMemory(allMemoryPointers,numberOfMemoryPointers);
+	        FreeAllNiftiImages(allNiftiImages,numberOfNiftiImages);
+	        return EXIT_FAILURE;
+	    }
+
+	    for (size_t v = 0; v < NUMBER_OF_VOLUMES; v++)
+	    {
+	        if (! (blocks >> h_Blocks[v]) )
+	        {
+	            blocks.close();
+	            printf("Could not read all values of the block file %s, aborting! \n",BLOCK_FILE);
+	            FreeAllMemory(allMemoryPointers,numberOfMemoryPointers);
+	            FreeAllNiftiImages(allNiftiImages,numberOfNiftiImages);
+	            return EXIT_FAILURE;
+	        }
+	    }
+	    blocks.close();
+	}
+
 	int uncensoredVolumes = 0;
 
     for (size_t v = 0; v < NUMBER_OF_VOLUMES; v++)
@@ -819,13 +1012,25 @@ int main(int argc, char **argv)
         BROCCOLI.SetClusterDefiningThreshold(CLUSTER_DEFINING_THRESHOLD);
         BROCCOLI.SetSignificanceLevel(SIGNIFICANCE_LEVEL);		
         
-        //BROCCOLI.SetNumberOfPermutations(NUMBER_OF_PERMUTATIONS);
+        BROCCOLI.SetNumberOfPermutations(NUMBER_OF_PERMUTATIONS);
+        BROCCOLI.SetRandomSeed(RANDOM_SEED);
         //BROCCOLI.SetNumberOfGroupPermutations(NUMBER_OF_PERMUTATIONS_PER_CONTRAST);
         BROCCOLI.SetCorrectClasses(h_Correct_Classes, h_d);
+        BROCCOLI.SetSearchlightClassifier(CLASSIFIER);
+        BROCCOLI.SetSearchlightRadius(RADIUS);
+        BROCCOLI.SetSearchlightFolds(NUMBER_OF_FOLDS);
+        BROCCOLI.SetSearchlightRegularization(REGULARIZATION);
+        if (BLOCKS)
+        {
+            BROCCOLI.SetSearchlightBlocks(h_Blocks);
+        }
         
         BROCCOLI.SetOutputStatisticalMapsMNI(h_Classifier_Performance);
-        //BROCCOLI.SetOutputPermutationDistributions(h_Permutation_Distributions);
-        //BROCCOLI.SetOutputPValuesMNI(h_P_Values);
+        if (PERMUTE)
+        {
+            BROCCOLI.SetOutputPermutationDistribution(h_Permutation_Distribution);
+            BROCCOLI.SetOutputPValuesMNI(h_P_Values);
+        }
 
 		//BROCCOLI.SetPermutationFileUsage(USE_PERMUTATION_FILE);
 		BROCCOLI.SetPrint(PRINT);
@@ -833,7 +1038,14 @@ int main(int argc, char **argv)
         // Run the permutation test
 
 		startTime = GetWallTime();
-        BROCCOLI.PerformSearchlightWrapper();
+        if (PERMUTE)
+        {
+            BROCCOLI.PerformSearchlightPermutationWrapper();
+        }
+        else
+        {
+            BROCCOLI.PerformSearchlightWrapper();
+        }
 		endTime = GetWallTime();
 
 		if (VERBOS)
@@ -902,6 +1114,31 @@ int main(int argc, char **argv)
         
     WriteNifti(outputNifti,h_Classifier_Performance,"_classifier_performance",ADD_FILENAME,DONT_CHECK_EXISTING_FILE);
 
+	if (PERMUTE)
+	{
+	    WriteNifti(outputNifti,h_P_Values,"_perm_pvalues",ADD_FILENAME,DONT_CHECK_EXISTING_FILE);
+	}
+
+	if (PERMUTE && WRITE_PERMUTATION_VALUES)
+	{
+		std::ofstream permutationValues;
+	    permutationValues.open(PERMUTATION_VALUES_FILE);
+
+	    if ( permutationValues.good() )
+	    {
+		    for (size_t p = 0; p < NUMBER_OF_PERMUTATIONS; p++)
+	        {
+	        	permutationValues << std::setprecision(6) << std::fixed << (double)h_Permutation_Distribution[p] << " " << std::endl;
+			}
+		    permutationValues.close();
+	    }
+	    else
+	    {
+			permutationValues.close();
+	        printf("Could not open %s for writing permutation values!\n",PERMUTATION_VALUES_FILE);
+	    }
+	}
+
 	endTime = GetWallTime();
 
 	if (VERBOS)
@@ -83,6 +83,10 @@ int main(int argc, char ** argv)
 	bool			DEFINED_SLICE_PATTERN = false;
 	bool			DEFINED_SLICE_CUSTOM_REF = false;
 	int				SLICE_CUSTOM_REF = 0;
+	int				SLICE_TIMING_INTERPOLATION = 0;
+	int				SLICE_TIMING_SINC_HALF_WIDTH = 4;
+	int				MULTIBAND_FACTOR = 1;
+	bool			SLICE_TIMINGS_JSON = false;
 	const char*		SLICE_TIMINGS_FILE;
 
 
@@ -111,6 +115,10 @@ int main(int argc, char ** argv)
         printf("                  (no slice timing correction is performed if pattern in NIFTI file is unknown and no pattern is provided) \n");        
 		printf(" -slicecustom     Provide a text file with the slice times, one value per slice, in milli seconds (0 - TR) (overrides pattern provided in NIFTI file)\n");
 		printf(" -slicecustomref  Reference slice for the custom slice times (0 - (#slices-1)) (default #slices/2)\n");
+		printf(" -sliceinterpolation Interpolation used for slice timing correction, 0 = cubic, 1 = windowed sinc, 2 = periodic sinc (exact Fourier shift, slow for long time series) (default 0)\n");
+		printf(" -sincwidth       Half width (in time points) of the windowed sinc interpolation (default 4)\n");
+		printf(" -multiband       Multiband factor, the slice pattern is applied to the slices of one band (default 1)\n");
+		printf(" -slicetimingjson Read the slice times (in seconds) from the SliceTiming field of a BIDS json file (overrides pattern provided in NIFTI file)\n");
         printf(" -output          Set output filename (default input_stc.nii) \n");
         printf(" -quiet           Don't print anything to the terminal (default false) \n");
         printf(" -verbose         Print extra stuff (default false) \n");
@@ -256,6 +264,87 @@ int main(int argc, char ** argv)
             i += 2;
 			DEFINED_SLICE_CUSTOM_REF = true;
         }
+        else if (strcmp(input,"-sliceinterpolation") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -sliceinterpolation !\n");
+                return EXIT_FAILURE;
+			}
+
+            SLICE_TIMING_INTERPOLATION = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Slice timing interpolation must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if ((SLICE_TIMING_INTERPOLATION < 0) || (SLICE_TIMING_INTERPOLATION > 2))
+            {
+                printf("Slice timing interpolation must be 0, 1 or 2 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-sincwidth") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -sincwidth !\n");
+                return EXIT_FAILURE;
+			}
+
+            SLICE_TIMING_SINC_HALF_WIDTH = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Sinc width must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (SLICE_TIMING_SINC_HALF_WIDTH < 1)
+            {
+                printf("Sinc width must be >= 1 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-multiband") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -multiband !\n");
+                return EXIT_FAILURE;
+			}
+
+            MULTIBAND_FACTOR = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Multiband factor must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (MULTIBAND_FACTOR < 1)
+            {
+                printf("Multiband factor must be >= 1 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-slicetimingjson") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -slicetimingjson !\n");
+                return EXIT_FAILURE;
+			}
+
+			SLICE_ORDER = CUSTOM;
+			SLICE_TIMINGS_FILE = argv[i+1];
+			SLICE_TIMINGS_JSON = true;
+
+            i += 2;
+			DEFINED_SLICE_PATTERN = true;
+        }
         else if (strcmp(input,"-debug") == 0)
         {
             DEBUG = true;
@@ -349,7 +438,33 @@ int main(int argc, char ** argv)
 	//---------------------------------------------	
 	// Read slice timing information from text file
 	
-	if (SLICE_ORDER == CUSTOM)
+	if ((SLICE_ORDER == CUSTOM) && SLICE_TIMINGS_JSON)
+	{
+		int numberOfSliceTimes = ReadBIDSSliceTiming(SLICE_TIMINGS_FILE, h_Custom_Slice_Times, 1000);
+
+		if (numberOfSliceTimes != DATA_D)
+		{
+	        printf("Unable to read %zu slice times from the SliceTiming field in %s, aborting! \n",DATA_D,SLICE_TIMINGS_FILE);
+			FreeAllNiftiImages(allNiftiImages,numberOfNiftiImages);
+	        return EXIT_FAILURE;
+		}
+
+		for (int slice = 0; slice < DATA_D; slice++)
+		{
+			if ((h_Custom_Slice_Times[slice] < 0.0f) || (h_Custom_Slice_Times[slice] > TR))
+			{
+	            printf("Slice time must be between 0 and the TR! Check the time for slice %i in %s ! \n",slice,SLICE_TIMINGS_FILE);
+				FreeAllNiftiImages(allNiftiImages,numberOfNiftiImages);
+	            return EXIT_FAILURE;
+			}
+
+			if (DEBUG)
+			{
+				printf("Slice time for slice %i is %f seconds \n",slice,h_Custom_Slice_Times[slice]);
+			}
+		}
+	}
+	else if (SLICE_ORDER == CUSTOM)
 	{		
 		std::ifstream slicetimes;
 		slicetimes.open(SLICE_TIMINGS_FILE);
@@ -679,6 +794,9 @@ int main(int argc, char ** argv)
         BROCCOLI.SetEPISliceOrder(SLICE_ORDER);  
 		BROCCOLI.SetCustomSliceTimes(h_Custom_Slice_Times);
 		BROCCOLI.SetCustomReferenceSlice(SLICE_CUSTOM_REF);
+		BROCCOLI.SetSliceTimingInterpolation(SLICE_TIMING_INTERPOLATION);
+		BROCCOLI.SetSliceTimingSincHalfWidth(SLICE_TIMING_SINC_HALF_WIDTH);
+		BROCCOLI.SetMultibandFactor(MULTIBAND_FACTOR);
                                 
         // Run the actual slice timing correction
 		startTime = GetWallTime();        
@@ -84,6 +84,8 @@ int main(int argc, char ** argv)
     float           EPI_SMOOTHING_AMOUNT = 6.0f;
 	bool			MASK = false;
 	bool			AUTO_MASK = false;
+	int				MASKING_METHOD = 0;
+	int				MASK_CLOSING_ITERATIONS = 2;
 	const char*		MASK_NAME;
 
     //-----------------------
@@ -107,6 +109,8 @@ int main(int argc, char ** argv)
         printf(" -fwhm            Amount of smoothing to apply (in mm, default 6 mm) \n");
         printf(" -mask            Perform smoothing inside mask (normalized convolution) \n");
         printf(" -automask        Generate a mask and perform smoothing inside mask (normalized convolution) \n");
+		printf(" -maskmethod      Method for the automatic brain mask, 0 = 90%% of mean intensity, 1 = Otsu threshold, 2 = two class Gaussian mixture (default 0)\n");
+		printf(" -maskclosing     Number of closing iterations for the automatic brain mask, only used by mask methods 1 and 2 (default 2)\n");
         printf(" -output          Set output filename (default input_sm.nii) \n");
         printf(" -quiet           Don't print anything to the terminal (default false) \n");
         printf(" -verbose         Print extra stuff (default false) \n");
@@ -226,6 +230,50 @@ int main(int argc, char ** argv)
             AUTO_MASK = true;
             i += 1;
         }
+        else if (strcmp(input,"-maskmethod") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -maskmethod !\n");
+                return EXIT_FAILURE;
+			}
+
+            MASKING_METHOD = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Mask method must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if ((MASKING_METHOD < 0) || (MASKING_METHOD > 2))
+            {
+                printf("Mask method must be 0, 1 or 2 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
+        else if (strcmp(input,"-maskclosing") == 0)
+        {
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read value after -maskclosing !\n");
+                return EXIT_FAILURE;
+			}
+
+            MASK_CLOSING_ITERATIONS = (int)strtol(argv[i+1], &p, 10);
+
+			if (!isspace(*p) && *p != 0)
+		    {
+		        printf("Number of mask closing iterations must be an integer! You provided %s \n",argv[i+1]);
+				return EXIT_FAILURE;
+		    }
+            else if (MASK_CLOSING_ITERATIONS < 0)
+            {
+                printf("Number of mask closing iterations must be >= 0 !\n");
+                return EXIT_FAILURE;
+            }
+            i += 2;
+        }
         else if (strcmp(input,"-debug") == 0)
         {
             DEBUG = true;
@@ -594,6 +642,8 @@ int main(int argc, char ** argv)
         // Set all necessary pointers and values
         BROCCOLI.SetInputfMRIVolumes(h_fMRI_Volumes);
 		BROCCOLI.SetAutoMask(AUTO_MASK);
+		BROCCOLI.SetMaskingMethod(MASKING_METHOD);
+		BROCCOLI.SetMaskClosingIterations(MASK_CLOSING_ITERATIONS);
 		BROCCOLI.SetInputCertainty(h_Certainty);
 
         BROCCOLI.SetEPISmoothingAmount(EPI_SMOOTHING_AMOUNT);
@@ -32,6 +32,62 @@
 #define CHECK_EXISTING_FILE true
 #define DONT_CHECK_EXISTING_FILE false
 
+// Reads one volume and converts it to floats, returns NULL if the volume could not be read
+float* ReadVolumeAsFloats(const char* filename, nifti_image*& inputVolume)
+{
+    inputVolume = nifti_image_read(filename,1);    
+    if (inputVolume == NULL)
+    {
+        printf("Could not open volume %s !\n",filename);
+        return NULL;
+    }
+
+	size_t N = inputVolume->nx * inputVolume->ny * inputVolume->nz * inputVolume->nt;
+	float* h_Volume = (float*)malloc(N * sizeof(float));
+	if (h_Volume == NULL)
+	{
+        printf("Could not allocate host memory for volume %s !\n",filename);
+		nifti_image_free(inputVolume);
+		inputVolume = NULL;
+        return NULL;
+	}
+
+    if ( inputVolume->datatype == DT_SIGNED_SHORT )
+    {
+        short int *p = (short int*)inputVolume->data;
+        for (size_t i = 0; i < N; i++)
+        {
+            h_Volume[i] = (float)p[i];
+        }
+    }
+    else if ( inputVolume->datatype == DT_FLOAT )
+    {
+        float *p = (float*)inputVolume->data;
+        for (size_t i = 0; i < N; i++)
+        {
+            h_Volume[i] = p[i];
+        }
+    }
+    else if ( inputVolume->datatype == DT_UINT8 )
+    {
+        unsigned char *p = (unsigned char*)inputVolume->data;
+        for (size_t i = 0; i < N; i++)
+        {
+            h_Volume[i] = (float)p[i];
+        }
+    }
+    else
+    {
+        printf("Unknown data type in volume %s !\n",filename);
+		free(h_Volume);
+		nifti_image_free(inputVolume);
+		inputVolume = NULL;
+        return NULL;
+    }
+
+	return h_Volume;
+}
+
 int main(int argc, char **argv)
 {
     //-----------------------
@@ -88,6 +144,10 @@ int main(int argc, char **argv)
 
 	const char*		outputFilename;
 
+	bool			BATCH = false;
+	const char*		batchFilename;
+	std::vector<std::string> batchFilenames;
+
 	bool			VERBOS = false;
 
     // Size parameters
@@ -121,9 +181,11 @@ int main(int argc, char **argv)
         printf(" -scaling                   A scaling to apply to each dimension \n");
         printf(" -centering                 Center the volume mass \n");
         printf(" -field                     An arbitrary deformation field in three files \n");
-		printf(" -interpolation             The interpolation to use, 0 = nearest neighbour, 1 = trilinear (default 1) \n");
+		printf(" -interpolation             The interpolation to use, 0 = nearest neighbour, 1 = trilinear, 2 = cubic B-spline, 3 = windowed sinc (default 1) \n");
 		printf(" -zcut                      Number of mm to cut from the bottom of the input volume, can be negative (default 0). Should be the same as for the call to RegisterTwoVolumes\n"); 
 		printf(" -output                    Set output filename (default volume_to_transform_warped.nii) \n");
+		printf(" -batch                     A text file with more volumes to transform with the same transformation, one filename per line. \n");
+		printf("                            The transformation is only set up once, and each output is written while the next volume is transformed (default none) \n");
         printf(" -quiet                     Don't print anything to the terminal (default false) \n");
         printf("\n\n");
         
@@ -308,9 +370,9 @@ int main(int argc, char **argv)
 		        printf("Interpolation mode must be an integer! You provided %s \n",argv[i+1]);
 				return EXIT_FAILURE;
 		    }
-			if ( (INTERPOLATION_MODE != 0) && (INTERPOLATION_MODE != 1) )
+			if ( (INTERPOLATION_MODE < 0) || (INTERPOLATION_MODE > 3) )
             {
-			    printf("Interpolation mode has to be 0 or 1!\n");
+			    printf("Interpolation mode has to be 0, 1, 2 or 3!\n");
                 return EXIT_FAILURE;          	
 			}
 			i += 2;
@@ -351,6 +413,19 @@ int main(int argc, char **argv)
             outputFilename = argv[i+1];
             i += 2;
         }
+        else if (strcmp(input,"-batch") == 0)
+        {
+			BATCH = true;
+
+			if ( (i+1) >= argc  )
+			{
+			    printf("Unable to read name after -batch !\n");
+                return EXIT_FAILURE;
+			}
+			
+            batchFilename = argv[i+1];
+            i += 2;
+        }
         else
         {
             printf("Unrecognized option! %s \n",argv[i]);
@@ -370,6 +445,58 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
 	}
 
+	if (BATCH && CENTERING)
+	{
+        printf("Centering can not be combined with -batch, as every volume has its own center!\n");
+        return EXIT_FAILURE;
+	}
+
+	if (BATCH && CHANGE_OUTPUT_FILENAME)
+	{
+        printf("Output filename can not be combined with -batch, _warped is added to the name of every volume!\n");
+        return EXIT_FAILURE;
+	}
+
+	// Read the names of all volumes to transform
+	if (BATCH)
+	{
+		std::ifstream batch;
+		batch.open(batchFilename);
+
+	    if (!batch.good())
+	    {
+	        batch.close();
+	        printf("Unable to open batch file %s. Aborting! \n",batchFilename);
+	        return EXIT_FAILURE;
+	    }
+
+		std::string name;
+		while (batch >> name)
+		{
+			std::string extension;
+			bool extensionOK;
+			CheckFileExtension(name.c_str(),extensionOK,extension);
+			if (!extensionOK)
+			{
+				batch.close();
+	            printf("File extension of %s is not .nii or .nii.gz, %s is not allowed!\n",name.c_str(),extension.c_str());
+	            return EXIT_FAILURE;
+			}
+
+	        fp = fopen(name.c_str(),"r");
+	        if (fp == NULL)
+	        {
+				batch.close();
+	            printf("Could not open file %s !\n",name.c_str());
+	            return EXIT_FAILURE;
+	        }
+	        fclose(fp);
+
+			batchFilenames.push_back(name);
+		}
+		batch.close();
+	}
+
 	// Check if BROCCOLI_DIR variable is set
 	if (getenv("BROCCOLI_DIR") == NULL)
 	{
@@ -833,6 +960,11 @@ int main(int argc, char **argv)
 		{
 			BROCCOLI.CenterVolumesWrapper();
 		}
+		else if (BATCH)
+		{
+			BROCCOLI.StartBatchedTransformation(NONLINEARTRANSFORMATION);
+			BROCCOLI.TransformVolumesBatchedWrapper();
+		}
 		else if (LINEARTRANSFORMATION)
 		{
 	        BROCCOLI.TransformVolumesLinearWrapper();
@@ -913,6 +1045,95 @@ int main(int argc, char **argv)
 		    WriteNifti(outputNifti,h_Interpolated_Volume,"",ADD_FILENAME,DONT_CHECK_EXISTING_FILE);    
 		}
 	}
+
+	// Transform the rest of the batch, the output of one volume is written while the next volume is transformed
+	if (BATCH)
+	{
+		float*			h_Batch_Input_Volume;
+		float*			h_Batch_Output_Volumes[2] = {NULL, NULL};
+		nifti_image*	batchOutputNiftis[2] = {NULL, NULL};
+		bool			BATCH_OK = true;
+
+		for (size_t f = 0; f <= batchFilenames.size(); f++)
+		{
+			int current = f % 2;
+			int previous = (f + 1) % 2;
+
+			#pragma omp parallel sections num_threads(2)
+			{
+				#pragma omp section
+				{
+					if (batchOutputNiftis[previous] != NULL)
+					{
+					    WriteNifti(batchOutputNiftis[previous],h_Batch_Output_Volumes[previous],"_warped",ADD_FILENAME,DONT_CHECK_EXISTING_FILE);
+						nifti_image_free(batchOutputNiftis[previous]);
+						free(h_Batch_Output_Volumes[previous]);
+						batchOutputNiftis[previous] = NULL;
+						h_Batch_Output_Volumes[previous] = NULL;
+					}
+				}
+
+				#pragma omp section
+				{
+					if ( BATCH_OK && (f < batchFilenames.size()) )
+					{
+						nifti_image* batchInputVolume;
+						h_Batch_Input_Volume = ReadVolumeAsFloats(batchFilenames[f].c_str(), batchInputVolume);
+						if (h_Batch_Input_Volume == NULL)
+						{
+							BATCH_OK = false;
+						}
+						else
+						{
+							size_t BATCH_DATA_T = batchInputVolume->nt;
+							h_Batch_Output_Volumes[current] = (float*)malloc(REFERENCE_DATA_W * REFERENCE_DATA_H * REFERENCE_DATA_D * BATCH_DATA_T * sizeof(float));
+
+							if (PRINT)
+							{
+								printf("Transforming %s \n",batchFilenames[f].c_str());
+							}
+
+							BROCCOLI.SetInputT1Volume(h_Batch_Input_Volume);        
+					        BROCCOLI.SetT1Width(batchInputVolume->nx);
+					        BROCCOLI.SetT1Height(batchInputVolume->ny);
+					        BROCCOLI.SetT1Depth(batchInputVolume->nz);  
+					        BROCCOLI.SetT1Timepoints(BATCH_DATA_T);  
+							BROCCOLI.SetT1VoxelSizeX(batchInputVolume->dx);
+							BROCCOLI.SetT1VoxelSizeY(batchInputVolume->dy);
+							BROCCOLI.SetT1VoxelSizeZ(batchInputVolume->dz);
+					        BROCCOLI.SetOutputInterpolatedT1Volume(h_Batch_Output_Volumes[current]);
+
+							BROCCOLI.TransformVolumesBatchedWrapper();
+
+						    // Copy information from reference volume
+							batchOutputNiftis[current] = nifti_copy_nim_info(referenceVolume);   
+							if (BATCH_DATA_T > 1)
+							{
+								batchOutputNiftis[current]->ndim = 4;
+							    batchOutputNiftis[current]->dim[0] = 4; 	
+							}
+						    batchOutputNiftis[current]->nt = BATCH_DATA_T;	
+						    batchOutputNiftis[current]->dim[4] = BATCH_DATA_T;
+						    batchOutputNiftis[current]->nvox = REFERENCE_DATA_W * REFERENCE_DATA_H * REFERENCE_DATA_D * BATCH_DATA_T;
+					    	nifti_set_filenames(batchOutputNiftis[current], batchInputVolume->fname, 0, 1);
+
+							free(h_Batch_Input_Volume);
+							nifti_image_free(batchInputVolume);
+						}
+					}
+				}
+			}
+		}
+
+		BROCCOLI.StopBatchedTransformation();
+
+		if (!BATCH_OK)
+		{
+			FreeAllMemory(allMemoryPointers,numberOfMemoryPointers);	   
+			FreeAllNiftiImages(allNiftiImages,numberOfNiftiImages);
+			return EXIT_FAILURE;
+		}
+	}
                              
     // Free all memory
 	FreeAllMemory(allMemoryPointers,numberOfMemoryPointers);	   
@@ -29,6 +29,7 @@ git add $BROCCOLI_GIT_DIRECTORY/compiled/Bash/Linux/Debug/SliceTimingCorrection
 git add $BROCCOLI_GIT_DIRECTORY/compiled/Bash/Linux/Debug/TransformVolume
 git add $BROCCOLI_GIT_DIRECTORY/compiled/Bash/Linux/Debug/GetOpenCLInfo
 git add $BROCCOLI_GIT_DIRECTORY/compiled/Bash/Linux/Debug/GetBandwidth
+git add $BROCCOLI_GIT_DIRECTORY/compiled/Bash/Linux/Debug/Benchmark
 git add $BROCCOLI_GIT_DIRECTORY/compiled/Bash/Linux/Debug/Smoothing
 git add $BROCCOLI_GIT_DIRECTORY/compiled/Bash/Linux/Debug/ICA
 git add $BROCCOLI_GIT_DIRECTORY/compiled/Bash/Linux/Debug/GLM
@@ -63,6 +64,7 @@ git add $BROCCOLI_GIT_DIRECTORY/compiled/Bash/Linux/Release/SliceTimingCorrectio
 git add $BROCCOLI_GIT_DIRECTORY/compiled/Bash/Linux/Release/TransformVolume
 git add $BROCCOLI_GIT_DIRECTORY/compiled/Bash/Linux/Release/GetOpenCLInfo
 git add $BROCCOLI_GIT_DIRECTORY/compiled/Bash/Linux/Release/GetBandwidth
+git add $BROCCOLI_GIT_DIRECTORY/compiled/Bash/Linux/Release/Benchmark
 git add $BROCCOLI_GIT_DIRECTORY/compiled/Bash/Linux/Release/Smoothing
 git add $BROCCOLI_GIT_DIRECTORY/compiled/Bash/Linux/Release/ICA
 git add $BROCCOLI_GIT_DIRECTORY/compiled/Bash/Linux/Release/GLM
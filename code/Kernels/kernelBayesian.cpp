@@ -40,84 +40,7 @@ int Calculate4DIndex(int x, int y, int z, int t, int DATA_W, int DATA_H, int DAT
 }
 
 
-#pragma OPENCL EXTENSION cl_khr_fp64: enable
-
-// Generate random uniform number by modulo operation
-
-
-double unirand(__private int* seed)
-{
-	double const a = 16807.0; //ie 7**5
-	double const m = 2147483647.0; //ie 2**31-1
-	double const reciprocal_m = 1.0/m;
-	double temp = (*seed) * a;
-	*seed = (int)(temp - m * floor(temp * reciprocal_m));
-
-	return ((double)(*seed) * reciprocal_m);
-}
-
-#define pi 3.141592653589793
-
-// Generate random normal number by Box-Muller transform
-double normalrand(__private int* seed)
-{
-	double u = unirand(seed);
-	double v = unirand(seed);
-
-	return sqrt(-2.0*log(u))*cos(2.0*pi*v);
-	//return 1.0;
-}
-
-// Generate inverse Gamma number
-double gamrnd(float a, float b, __private int* seed)
-{
-	double x = 0.0;
-	for (int i = 0; i < 2*(int)round(a); i++)
-	{
-		double rand_value = normalrand(seed);
-		x += rand_value * rand_value;
-	}
-
-	return 2.0 * b / x;
-}
-
-
-/*
-float unirand(__private int* seed)
-{
-	float const a = 16807.0f; //ie 7**5
-	float const m = 2147483647.0f; //ie 2**31-1
-	float const reciprocal_m = 1.0f/m;
-	float temp = (*seed) * a;
-	*seed = (int)(temp - m * floor(temp * reciprocal_m));
-
-	return ((float)(*seed) * reciprocal_m);
-}
-
-#define pi 3.141592653589793
-
-// Generate random normal number by Box-Muller transform
-float normalrand(__private int* seed)
-{
-	float u = unirand(seed);
-	float v = unirand(seed);
-
-	return sqrt(-2.0f*log(u))*cos(2.0f*pi*v);
-}
-
-// Generate inverse Gamma number
-float gamrnd(float a, float b, __private int* seed)
-{
-	float x = 0.0f;
-	for (int i = 0; i < 2*(int)round(a); i++)
-	{
-		float rand_value = normalrand(seed);
-		x += rand_value * rand_value;
-	}
-
-	return 2.0f * b / x;
-}
-*/
+// Random numbers are generated by the counter based generator in kernelRandom.h, one stream per voxel and iteration
 
 // Cholesky factorization, not optimized
 int Cholesky(float* cholA, float factor, __constant float* A, int N)
@@ -152,7 +75,7 @@ int Cholesky(float* cholA, float factor, __constant float* A, int N)
 	return 0;
 }
 
-int MultivariateRandomOld(float* random, float* mu, __constant float* Cov, float Sigma, int N, __private int* seed)
+int MultivariateRandomOld(float* random, float* mu, __constant float* Cov, float Sigma, int N, RandomState* state)
 {
 	float randvalues[2];
 	float cholCov[4];
@@ -161,8 +84,8 @@ int MultivariateRandomOld(float* random, float* mu, __constant float* Cov, float
 	{
 		case 2:
 			
-			randvalues[0] = normalrand(seed);
-			randvalues[1] = normalrand(seed);
+			randvalues[0] = RandomNormal(state);
+			randvalues[1] = RandomNormal(state);
 	
 			Cholesky(cholCov, Sigma, Cov, N);
 
@@ -215,25 +138,25 @@ int Cholesky2(float cholA[2][2], float factor, float A[2][2])
 
 
 
-int MultivariateRandom1(float* random, float mu, __private float Cov, float Sigma, __private int* seed)
+int MultivariateRandom1(float* random, float mu, __private float Cov, float Sigma, RandomState* state)
 {
 	float randvalues;
 	float cholCov;
 			
-	randvalues = normalrand(seed);		
+	randvalues = RandomNormal(state);		
 	Cholesky1(&cholCov, Sigma, Cov);
 	random[0] = mu + cholCov * randvalues;
 
 	return 0;
 }
 
-int MultivariateRandom2(float* random, float* mu, __private float Cov[2][2], float Sigma, __private int* seed)
+int MultivariateRandom2(float* random, float* mu, __private float Cov[2][2], float Sigma, RandomState* state)
 {
 	float randvalues[2];
 	float cholCov[2][2];
 			
-	randvalues[0] = normalrand(seed);
-	randvalues[1] = normalrand(seed);
+	randvalues[0] = RandomNormal(state);
+	randvalues[1] = RandomNormal(state);
 	
 	Cholesky2(cholCov, Sigma, Cov);
 
@@ -324,7 +247,7 @@ __kernel void CalculateStatisticalMapsGLMBayesian(__global float* Statistical_Ma
 												  __global float* AR_Estimates,
 		                                          __global const float* Volumes,
 		                                          __global const float* Mask,
-		                                          __global const int* Seeds,
+		                                          __private uint SEED,
 		                                          __constant float* c_X_GLM,
 		                                          __constant float* c_InvOmega0,
 											      __constant float* c_S00,
@@ -364,8 +287,9 @@ __kernel void CalculateStatisticalMapsGLMBayesian(__global float* Statistical_Ma
 		return;
 	}
 
-	// Get seed from host
-	int seed = Seeds[Calculate3DIndex(x,y,slice,DATA_W,DATA_H)];
+	// One random stream per voxel and iteration
+	int voxel = Calculate3DIndex(x,y,slice,DATA_W,DATA_H);
+	RandomState state;
 
 	// Prior options
 	float iota = 1.0f;                 // Decay factor for lag length in prior for rho.
@@ -481,11 +405,13 @@ __kernel void CalculateStatisticalMapsGLMBayesian(__global float* Statistical_Ma
 		temp[1] = InvOmegaT[1][0] * betaT[0] + InvOmegaT[1][1] * betaT[1];
 		bT = b0 + 0.5f * (Ytildesquared - betaT[0] * temp[0] - betaT[1] * temp[1]);
 
+		RandomInitialize(&state, SEED, (uint)voxel, (uint)i, 0);
+
 		// Block 1 - Step 1a. Update sigma2
-		sigma2 = gamrnd(aT,bT,&seed);
+		sigma2 = RandomInverseGamma(&state,aT,bT);
 		
 		// Block 1 - Step 1b. Update beta | sigma2
-		MultivariateRandom2(beta,betaT,OmegaT,sigma2,&seed);
+		MultivariateRandom2(beta,betaT,OmegaT,sigma2,&state);
 		
 		if (i > nBurnin)
 		{
@@ -542,7 +468,7 @@ __kernel void CalculateStatisticalMapsGLMBayesian(__global float* Statistical_Ma
 		float InvAT = InvA0 + zsquared / sigma2;
 		float AT = 1.0f / InvAT;
 		rhoT = AT * zu / sigma2;
-		MultivariateRandom1(&rhoProp,rhoT,AT,sigma2,&seed);
+		MultivariateRandom1(&rhoProp,rhoT,AT,sigma2,&state);
 
 		if (myabs(rhoProp) < 1.0f)
 		{
@@ -575,3 +501,1224 @@ __kernel void CalculateStatisticalMapsGLMBayesian(__global float* Statistical_Ma
 }
 
 
+
+
+
+// Cholesky factorization A = L L^T in place for a matrix in global memory, L (row i, column j at A[j + i*N]) overwrites the lower triangle
+int CholeskyGlobal(__global float* A, int N)
+{
+	for (int j = 0; j < N; j++)
+	{
+		float value = A[j + j*N];
+		for (int k = 0; k < j; k++)
+		{
+			value -= A[k + j*N] * A[k + j*N];
+		}
+
+		if (value <= 0.0f)
+		{
+			return 1;
+		}
+
+		float diagonal = sqrt(value);
+		A[j + j*N] = diagonal;
+
+		for (int i = j + 1; i < N; i++)
+		{
+			float offdiagonal = A[j + i*N];
+			for (int k = 0; k < j; k++)
+			{
+				offdiagonal -= A[k + i*N] * A[k + j*N];
+			}
+			A[j + i*N] = offdiagonal / diagonal;
+		}
+	}
+
+	return 0;
+}
+
+// Cholesky factorization for small matrices (at most 4 x 4) in private memory
+int CholeskyPrivate(float* A, int N)
+{
+	for (int j = 0; j < N; j++)
+	{
+		float value = A[j + j*N];
+		for (int k = 0; k < j; k++)
+		{
+			value -= A[k + j*N] * A[k + j*N];
+		}
+
+		if (value <= 0.0f)
+		{
+			return 1;
+		}
+
+		float diagonal = sqrt(value);
+		A[j + j*N] = diagonal;
+
+		for (int i = j + 1; i < N; i++)
+		{
+			float offdiagonal = A[j + i*N];
+			for (int k = 0; k < j; k++)
+			{
+				offdiagonal -= A[k + i*N] * A[k + j*N];
+			}
+			A[j + i*N] = offdiagonal / diagonal;
+		}
+	}
+
+	return 0;
+}
+
+// Draws sigma^2 and the regression weights given the AR parameters (Block 1). The prewhitened X'X, X'y and y'y are formed from lagged
+// cross products, such that the cost of one iteration does not depend on the number of volumes. Returns 1 if the posterior precision
+// matrix is not positive definite, the old draw is then kept
+int SampleRegressionWeightsBayesian(float* beta,
+	                                float* sigma2,
+									float* rho,
+									__global float* Lambda,
+									__global float* Mean,
+									__global const float* Data_Products,
+									__global const float* Data_Squares,
+									__global const float* Lag_Products,
+									__constant float* c_InvOmega0,
+									float a0,
+									float b0,
+									int NUMBER_OF_OBSERVATIONS,
+									int NUMBER_OF_REGRESSORS,
+									int AR_ORDER,
+									RandomState* state)
+{
+	int lags = AR_ORDER + 1;
+	int P = NUMBER_OF_REGRESSORS;
+
+	// Prewhitening filter 1 - rho_1 z^-1 - ... - rho_k z^-k
+	float filter[5];
+	filter[0] = 1.0f;
+	for (int a = 1; a < lags; a++)
+	{
+		filter[a] = -rho[a-1];
+	}
+
+	// Posterior precision matrix InvOmega0 + Xtilde'Xtilde, and Xtilde'Ytilde
+	for (int r = 0; r < P; r++)
+	{
+		for (int s = 0; s <= r; s++)
+		{
+			float value = c_InvOmega0[r + s * P];
+			for (int a = 0; a < lags; a++)
+			{
+				for (int b = 0; b < lags; b++)
+				{
+					value += filter[a] * filter[b] * Lag_Products[((a * lags + b) * P + r) * P + s];
+				}
+			}
+			Lambda[s + r * P] = value;
+			Lambda[r + s * P] = value;
+		}
+
+		float value = 0.0f;
+		for (int a = 0; a < lags; a++)
+		{
+			for (int b = 0; b < lags; b++)
+			{
+				value += filter[a] * filter[b] * Data_Products[(a * lags + b) * P + r];
+			}
+		}
+		Mean[r] = value;
+	}
+
+	float Ytildesquared = 0.0f;
+	for (int a = 0; a < lags; a++)
+	{
+		for (int b = 0; b < lags; b++)
+		{
+			Ytildesquared += filter[a] * filter[b] * Data_Squares[a * lags + b];
+		}
+	}
+
+	if (CholeskyGlobal(Lambda, P))
+	{
+		return 1;
+	}
+
+	// Forward substitution, L^-1 Xtilde'Ytilde, its squared norm is betaT' InvOmegaT betaT
+	float quadratic = 0.0f;
+	for (int i = 0; i < P; i++)
+	{
+		float value = Mean[i];
+		for (int k = 0; k < i; k++)
+		{
+			value -= Lambda[k + i * P] * Mean[k];
+		}
+		value /= Lambda[i + i * P];
+		Mean[i] = value;
+		quadratic += value * value;
+	}
+
+	// Backward substitution, posterior mean betaT
+	for (int i = P - 1; i >= 0; i--)
+	{
+		float value = Mean[i];
+		for (int k = i + 1; k < P; k++)
+		{
+			value -= Lambda[i + k * P] * Mean[k];
+		}
+		Mean[i] = value / Lambda[i + i * P];
+	}
+
+	// Block 1 - Step 1a. Update sigma2
+	float aT = a0 + (float)NUMBER_OF_OBSERVATIONS / 2.0f;
+	float bT = b0 + 0.5f * max(Ytildesquared - quadratic, 0.0f);
+	*sigma2 = RandomInverseGamma(state, aT, bT);
+
+	// Block 1 - Step 1b. Update beta | sigma2, betaT + sigma L^-T z
+	for (int i = P - 1; i >= 0; i--)
+	{
+		float value = RandomNormal(state);
+		for (int k = i + 1; k < P; k++)
+		{
+			value -= Lambda[i + k * P] * beta[k];
+		}
+		beta[i] = value / Lambda[i + i * P];
+	}
+
+	float sigma = sqrt(*sigma2);
+	for (int i = 0; i < P; i++)
+	{
+		beta[i] = Mean[i] + sigma * beta[i];
+	}
+
+	return 0;
+}
+
+// Draws the AR parameters given sigma^2 and the regression weights (Block 2). Prior N(r, c^2) for the first lag and N(0, c^2 / j^(2 iota))
+// for lag j. A draw is only accepted if |rho_1| + ... + |rho_k| < 1, which guarantees a stationary process
+void SampleARParametersBayesian(float* rho,
+	                            float* beta,
+								float sigma2,
+								__global const float* Data_Products,
+								__global const float* Data_Squares,
+								__global const float* Lag_Products,
+								float iota,
+								float r,
+								float c,
+								int NUMBER_OF_REGRESSORS,
+								int AR_ORDER,
+								RandomState* state)
+{
+	int lags = AR_ORDER + 1;
+	int P = NUMBER_OF_REGRESSORS;
+
+	// Lagged products of the residuals, sum_t e(t-a) e(t-b) = y'y - beta'X'y - beta'X'y + beta'X'X beta for lags a and b
+	float residualProducts[25];
+	for (int a = 0; a < lags; a++)
+	{
+		for (int b = a; b < lags; b++)
+		{
+			float value = Data_Squares[a * lags + b];
+			for (int i = 0; i < P; i++)
+			{
+				float Xbeta = 0.0f;
+				for (int j = 0; j < P; j++)
+				{
+					Xbeta += Lag_Products[((a * lags + b) * P + i) * P + j] * beta[j];
+				}
+				value += beta[i] * (Xbeta - Data_Products[(a * lags + b) * P + i] - Data_Products[(b * lags + a) * P + i]);
+			}
+			residualProducts[a * lags + b] = value;
+			residualProducts[b * lags + a] = value;
+		}
+	}
+
+	// Posterior precision and mean of rho
+	float A[16];
+	float mean[4];
+	for (int j = 0; j < AR_ORDER; j++)
+	{
+		float priorPrecision = pow((float)(j + 1), 2.0f * iota) / (c * c);
+
+		for (int l = 0; l < AR_ORDER; l++)
+		{
+			A[l + j * AR_ORDER] = residualProducts[(j + 1) * lags + (l + 1)] / sigma2;
+		}
+		A[j + j * AR_ORDER] += priorPrecision;
+
+		mean[j] = residualProducts[(j + 1) * lags + 0] / sigma2;
+		if (j == 0)
+		{
+			mean[j] += priorPrecision * r;
+		}
+	}
+
+	if (CholeskyPrivate(A, AR_ORDER))
+	{
+		return;
+	}
+
+	for (int i = 0; i < AR_ORDER; i++)
+	{
+		float value = mean[i];
+		for (int k = 0; k < i; k++)
+		{
+			value -= A[k + i * AR_ORDER] * mean[k];
+		}
+		mean[i] = value / A[i + i * AR_ORDER];
+	}
+
+	// Mean and random perturbation in one backward substitution, L^-T (L^-1 b + z)
+	float rhoProp[4];
+	for (int i = AR_ORDER - 1; i >= 0; i--)
+	{
+		float value = mean[i] + RandomNormal(state);
+		for (int k = i + 1; k < AR_ORDER; k++)
+		{
+			value -= A[i + k * AR_ORDER] * rhoProp[k];
+		}
+		rhoProp[i] = value / A[i + i * AR_ORDER];
+	}
+
+	float sum = 0.0f;
+	for (int i = 0; i < AR_ORDER; i++)
+	{
+		sum += fabs(rhoProp[i]);
+	}
+
+	if (sum < 1.0f)
+	{
+		for (int i = 0; i < AR_ORDER; i++)
+		{
+			rho[i] = rhoProp[i];
+		}
+	}
+}
+
+// Summarizes the draws of one chain for the split-R-hat, using the last 2h of the first S segments. For each monitored quantity the
+// mean and variance of both halves, and the variance of the segment means (batch means, for the effective sample size) are saved
+void SummarizeChainBayesian(__global float* Summary,
+	                        __global const float* Segments,
+							int S,
+							int SEGMENT_LENGTH,
+							int NUMBER_OF_MONITORED)
+{
+	int h = S / 2;
+	int start = S - 2 * h;
+	float L = (float)SEGMENT_LENGTH;
+
+	for (int m = 0; m < NUMBER_OF_MONITORED; m++)
+	{
+		float chainMean = 0.0f;
+
+		for (int half = 0; half < 2; half++)
+		{
+			float mean = 0.0f;
+			for (int s = start + half * h; s < start + (half + 1) * h; s++)
+			{
+				mean += Segments[(s * NUMBER_OF_MONITORED + m) * 2 + 0];
+			}
+			mean /= (float)h;
+
+			// Combine the within segment sums of squares with the spread of the segment means
+			float M2 = 0.0f;
+			for (int s = start + half * h; s < start + (half + 1) * h; s++)
+			{
+				float delta = Segments[(s * NUMBER_OF_MONITORED + m) * 2 + 0] - mean;
+				M2 += Segments[(s * NUMBER_OF_MONITORED + m) * 2 + 1] + L * delta * delta;
+			}
+
+			Summary[m * 5 + half * 2 + 0] = mean;
+			Summary[m * 5 + half * 2 + 1] = M2 / ((float)h * L - 1.0f);
+			chainMean += 0.5f * mean;
+		}
+
+		float batchVariance = 0.0f;
+		for (int s = start; s < S; s++)
+		{
+			float delta = Segments[(s * NUMBER_OF_MONITORED + m) * 2 + 0] - chainMean;
+			batchVariance += delta * delta;
+		}
+		Summary[m * 5 + 4] = batchVariance / (float)(2 * h - 1);
+	}
+}
+
+// Split-R-hat (largest over the monitored quantities) and effective sample size (smallest, batch means estimate of the asymptotic variance)
+// from the summaries of all chains of one voxel
+void ConvergenceDiagnosticsBayesian(float* Rhat,
+	                                float* ESS,
+									__global const float* Scratch,
+									int SCRATCH_PER_CHAIN,
+									int SUMMARY_OFFSET,
+									int S,
+									int SEGMENT_LENGTH,
+									int NUMBER_OF_MONITORED,
+									int NUMBER_OF_CHAINS)
+{
+	float n = (float)((S / 2) * SEGMENT_LENGTH);
+	float J = (float)(2 * NUMBER_OF_CHAINS);
+	float total = J * n;
+
+	*Rhat = 1.0f;
+	*ESS = total;
+
+	for (int m = 0; m < NUMBER_OF_MONITORED; m++)
+	{
+		float meanOfMeans = 0.0f;
+		float W = 0.0f;
+		float batchVariance = 0.0f;
+		for (int c = 0; c < NUMBER_OF_CHAINS; c++)
+		{
+			__global const float* Summary = Scratch + c * SCRATCH_PER_CHAIN + SUMMARY_OFFSET + m * 5;
+			meanOfMeans += Summary[0] + Summary[2];
+			W += Summary[1] + Summary[3];
+			batchVariance += Summary[4];
+		}
+		meanOfMeans /= J;
+		W /= J;
+		batchVariance /= (float)NUMBER_OF_CHAINS;
+
+		float B = 0.0f;
+		for (int c = 0; c < NUMBER_OF_CHAINS; c++)
+		{
+			__global const float* Summary = Scratch + c * SCRATCH_PER_CHAIN + SUMMARY_OFFSET + m * 5;
+			B += (Summary[0] - meanOfMeans) * (Summary[0] - meanOfMeans) + (Summary[2] - meanOfMeans) * (Summary[2] - meanOfMeans);
+		}
+		B *= n / (J - 1.0f);
+
+		float variance = (n - 1.0f) / n * W + B / n;
+
+		// Constant quantities (e.g. a contrast of zeros) have converged
+		if (W > 0.0f)
+		{
+			*Rhat = max(*Rhat, sqrt(variance / W));
+		}
+
+		float asymptoticVariance = (float)SEGMENT_LENGTH * batchVariance;
+		if (asymptoticVariance > 0.0f)
+		{
+			*ESS = min(*ESS, min(total, total * variance / asymptoticVariance));
+		}
+	}
+}
+
+// Generates posterior probability maps (PPMs) for any number of regressors (at most 25) and AR(k) noise (k at most 4), using several
+// Gibbs chains per voxel. The chains of a voxel are work-items of the same work-group (first dimension), and are stopped as soon as the
+// split-R-hat and the effective sample size of all contrasts and of log(sigma2) have converged. The draws after the burn-in are used.
+// Each chain uses the random stream (voxel, iteration, chain). Diagnostics gets the last split-R-hat and effective sample size (NaN if the
+// chains were too short to check convergence) and the number of iterations
+
+__kernel void CalculateStatisticalMapsGLMBayesianChains(__global float* Statistical_Maps,
+	                                                    __global float* Beta_Volumes,
+														__global float* AR_Estimates,
+														__global float* Diagnostics,
+														__global const float* Volumes,
+														__global float* Scratch,
+														__global const int* Voxel_Indices,
+														__global const float* Lag_Products,
+														__constant float* c_X_GLM,
+														__constant float* c_Contrasts,
+														__constant float* c_InvOmega0,
+														__local int* l_Done,
+														__private uint SEED,
+														__private int DATA_W,
+														__private int DATA_H,
+														__private int DATA_D,
+														__private int NUMBER_OF_VOLUMES,
+														__private int NUMBER_OF_REGRESSORS,
+														__private int NUMBER_OF_TOTAL_REGRESSORS,
+														__private int NUMBER_OF_CONTRASTS,
+														__private int AR_ORDER,
+														__private int NUMBER_OF_CHAINS,
+														__private int NUMBER_OF_ITERATIONS,
+														__private int NUMBER_OF_BURNIN_ITERATIONS,
+														__private int SEGMENT_LENGTH,
+														__private int MAX_SEGMENTS,
+														__private float RHAT_THRESHOLD,
+														__private float MIN_ESS,
+														__private int SCRATCH_PER_CHAIN,
+														__private int slice,
+														__private int VOXEL_OFFSET,
+														__private int NUMBER_OF_VOXELS)
+{
+	int chain = get_local_id(0);
+	int localVoxel = get_local_id(1);
+	int voxelSlot = get_global_id(1);
+	int voxel = VOXEL_OFFSET + voxelSlot;
+	int valid = (voxel < NUMBER_OF_VOXELS);
+
+	int P = NUMBER_OF_REGRESSORS;
+	int lags = AR_ORDER + 1;
+	int NUMBER_OF_MONITORED = NUMBER_OF_CONTRASTS + 1;
+	int NUMBER_OF_OBSERVATIONS = NUMBER_OF_VOLUMES - AR_ORDER;
+
+	// Prior options
+	float iota = 1.0f;                 // Decay factor for lag length in prior for rho.
+	float r = 0.5f;                    // Prior mean on rho1
+	float c = 0.3f;                    // Prior standard deviation on first lag.
+	float a0 = 0.01f;                  // First parameter in IG prior for sigma^2
+	float b0 = 0.01f;                  // Second parameter in IG prior for sigma^2
+
+	// Scratch of this chain, precision matrix, mean, lagged cross products of the data, segment statistics and summary / accumulators
+	int SUMMARY_OFFSET = P * P + P + lags * lags * (P + 1) + MAX_SEGMENTS * NUMBER_OF_MONITORED * 2;
+	__global float* Voxel_Scratch = Scratch + voxelSlot * NUMBER_OF_CHAINS * SCRATCH_PER_CHAIN;
+	__global float* Lambda = Voxel_Scratch + chain * SCRATCH_PER_CHAIN;
+	__global float* Mean = Lambda + P * P;
+	__global float* Data_Products = Mean + P;
+	__global float* Data_Squares = Data_Products + lags * lags * P;
+	__global float* Segments = Data_Squares + lags * lags;
+	__global float* Summary = Lambda + SUMMARY_OFFSET;
+	__global float* Positive_Counts = Summary + NUMBER_OF_MONITORED * 5;
+	__global float* Beta_Sums = Positive_Counts + NUMBER_OF_CONTRASTS;
+	__global float* Rho_Sum = Beta_Sums + P;
+
+	if (chain == 0)
+	{
+		l_Done[localVoxel] = !valid;
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	int index = 0;
+	int voxelIndex = 0;
+
+	float beta[25];
+	float rho[4];
+	float sigma2 = 1.0f;
+
+	// NaN until the diagnostics have been calculated at least once, a voxel that never reaches four segments does not look converged
+	float Rhat = NAN;
+	float ESS = NAN;
+	int kept = 0;
+	int iterations = 0;
+
+	RandomState state;
+
+	if (valid)
+	{
+		index = Voxel_Indices[voxel];
+		voxelIndex = index + slice * DATA_W * DATA_H;
+
+		// Lagged cross products of regressors and data, and of the data, sum_t x(t-a) y(t-b) and sum_t y(t-a) y(t-b)
+		for (int a = 0; a < lags; a++)
+		{
+			for (int b = 0; b < lags; b++)
+			{
+				for (int i = 0; i < P; i++)
+				{
+					float value = 0.0f;
+					for (int t = AR_ORDER; t < NUMBER_OF_VOLUMES; t++)
+					{
+						value += c_X_GLM[NUMBER_OF_VOLUMES * i + t - a] * Volumes[index + (t - b) * DATA_W * DATA_H];
+					}
+					Data_Products[(a * lags + b) * P + i] = value;
+				}
+
+				float value = 0.0f;
+				for (int t = AR_ORDER; t < NUMBER_OF_VOLUMES; t++)
+				{
+					value += Volumes[index + (t - a) * DATA_W * DATA_H] * Volumes[index + (t - b) * DATA_W * DATA_H];
+				}
+				Data_Squares[a * lags + b] = value;
+			}
+		}
+
+		for (int i = 0; i < NUMBER_OF_CONTRASTS + P + 1; i++)
+		{
+			Positive_Counts[i] = 0.0f;
+		}
+
+		for (int i = 0; i < P; i++)
+		{
+			beta[i] = 0.0f;
+		}
+
+		// Overdispersed starting values for rho, one per chain
+		RandomInitialize(&state, SEED, (uint)voxelIndex, (uint)NUMBER_OF_ITERATIONS, (uint)chain);
+		for (int i = 0; i < AR_ORDER; i++)
+		{
+			rho[i] = (2.0f * RandomUniform(&state) - 1.0f) * 0.8f / (float)AR_ORDER;
+		}
+	}
+
+	// Loop over iterations
+	for (int i = 0; i < NUMBER_OF_ITERATIONS; i++)
+	{
+		if (!l_Done[localVoxel])
+		{
+			RandomInitialize(&state, SEED, (uint)voxelIndex, (uint)i, (uint)chain);
+
+			SampleRegressionWeightsBayesian(beta, &sigma2, rho, Lambda, Mean, Data_Products, Data_Squares, Lag_Products, c_InvOmega0, a0, b0, NUMBER_OF_OBSERVATIONS, P, AR_ORDER, &state);
+			SampleARParametersBayesian(rho, beta, sigma2, Data_Products, Data_Squares, Lag_Products, iota, r, c, P, AR_ORDER, &state);
+			iterations = i + 1;
+
+			// Save draws after burnin, running mean and sum of squares (Welford) per segment of each monitored quantity
+			int segment = (i - NUMBER_OF_BURNIN_ITERATIONS) / SEGMENT_LENGTH;
+			if ( (i >= NUMBER_OF_BURNIN_ITERATIONS) && (segment < MAX_SEGMENTS) )
+			{
+				float n = (float)((i - NUMBER_OF_BURNIN_ITERATIONS) % SEGMENT_LENGTH + 1);
+
+				for (int m = 0; m < NUMBER_OF_MONITORED; m++)
+				{
+					float value = 0.0f;
+					if (m < NUMBER_OF_CONTRASTS)
+					{
+						for (int j = 0; j < P; j++)
+						{
+							value += c_Contrasts[NUMBER_OF_TOTAL_REGRESSORS * m + j] * beta[j];
+						}
+
+						if (value > 0.0f)
+						{
+							Positive_Counts[m] += 1.0f;
+						}
+					}
+					else
+					{
+						value = log(sigma2);
+					}
+
+					__global float* Segment = Segments + (segment * NUMBER_OF_MONITORED + m) * 2;
+					if (n == 1.0f)
+					{
+						Segment[0] = value;
+						Segment[1] = 0.0f;
+					}
+					else
+					{
+						float delta = value - Segment[0];
+						Segment[0] += delta / n;
+						Segment[1] += delta * (value - Segment[0]);
+					}
+				}
+
+				for (int j = 0; j < P; j++)
+				{
+					Beta_Sums[j] += beta[j];
+				}
+				Rho_Sum[0] += rho[0];
+				kept++;
+			}
+		}
+
+		// Check convergence at the end of every segment, when every half chain has at least two segments
+		int S = (i - NUMBER_OF_BURNIN_ITERATIONS + 1) / SEGMENT_LENGTH;
+		if ( (i >= NUMBER_OF_BURNIN_ITERATIONS) && (((i - NUMBER_OF_BURNIN_ITERATIONS + 1) % SEGMENT_LENGTH) == 0) && (S >= 4) && (S <= MAX_SEGMENTS) )
+		{
+			if (!l_Done[localVoxel])
+			{
+				SummarizeChainBayesian(Summary, Segments, S, SEGMENT_LENGTH, NUMBER_OF_MONITORED);
+			}
+			barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+
+			if ( (chain == 0) && !l_Done[localVoxel] )
+			{
+				ConvergenceDiagnosticsBayesian(&Rhat, &ESS, Voxel_Scratch, SCRATCH_PER_CHAIN, SUMMARY_OFFSET, S, SEGMENT_LENGTH, NUMBER_OF_MONITORED, NUMBER_OF_CHAINS);
+
+				if ( (Rhat < RHAT_THRESHOLD) && (ESS >= MIN_ESS) )
+				{
+					l_Done[localVoxel] = 1;
+				}
+			}
+			barrier(CLK_LOCAL_MEM_FENCE);
+
+			// Stop when all voxels of the work-group have converged
+			if ( (chain == 0) && (localVoxel == 0) )
+			{
+				int allDone = 1;
+				for (int v = 0; v < get_local_size(1); v++)
+				{
+					allDone = allDone && l_Done[v];
+				}
+				l_Done[get_local_size(1)] = allDone;
+			}
+			barrier(CLK_LOCAL_MEM_FENCE);
+
+			if (l_Done[get_local_size(1)])
+			{
+				break;
+			}
+		}
+	}
+
+	// Combine the draws of all chains
+	if (valid)
+	{
+		Rho_Sum[1] = (float)kept;
+	}
+	barrier(CLK_GLOBAL_MEM_FENCE);
+
+	if ( !valid || (chain != 0) )
+	{
+		return;
+	}
+
+	float total = 0.0f;
+	for (int ch = 0; ch < NUMBER_OF_CHAINS; ch++)
+	{
+		total += Voxel_Scratch[ch * SCRATCH_PER_CHAIN + SUMMARY_OFFSET + NUMBER_OF_MONITORED * 5 + NUMBER_OF_CONTRASTS + P + 1];
+	}
+	total = max(total, 1.0f);
+
+	for (int m = 0; m < NUMBER_OF_CONTRASTS; m++)
+	{
+		float value = 0.0f;
+		for (int ch = 0; ch < NUMBER_OF_CHAINS; ch++)
+		{
+			value += Voxel_Scratch[ch * SCRATCH_PER_CHAIN + SUMMARY_OFFSET + NUMBER_OF_MONITORED * 5 + m];
+		}
+		Statistical_Maps[voxelIndex + m * DATA_W * DATA_H * DATA_D] = value / total;
+	}
+
+	for (int j = 0; j < P; j++)
+	{
+		float value = 0.0f;
+		for (int ch = 0; ch < NUMBER_OF_CHAINS; ch++)
+		{
+			value += Voxel_Scratch[ch * SCRATCH_PER_CHAIN + SUMMARY_OFFSET + NUMBER_OF_MONITORED * 5 + NUMBER_OF_CONTRASTS + j];
+		}
+		Beta_Volumes[voxelIndex + j * DATA_W * DATA_H * DATA_D] = value / total;
+	}
+
+	float value = 0.0f;
+	for (int ch = 0; ch < NUMBER_OF_CHAINS; ch++)
+	{
+		value += Voxel_Scratch[ch * SCRATCH_PER_CHAIN + SUMMARY_OFFSET + NUMBER_OF_MONITORED * 5 + NUMBER_OF_CONTRASTS + P];
+	}
+	AR_Estimates[voxelIndex] = value / total;
+
+	Diagnostics[voxelIndex + 0 * DATA_W * DATA_H * DATA_D] = Rhat;
+	Diagnostics[voxelIndex + 1 * DATA_W * DATA_H * DATA_D] = ESS;
+	Diagnostics[voxelIndex + 2 * DATA_W * DATA_H * DATA_D] = (float)iterations;
+}
+
+
+
+
+
+// Expected outer product E[f f'] of the prewhitening filter f = [1 -rho_1 ... -rho_k], for the variational posterior of rho
+void ExpectedFilterProductsBayesianVB(float* Filter_Products,
+	                                  float* rho,
+									  float* rhoCovariance,
+									  int AR_ORDER)
+{
+	int lags = AR_ORDER + 1;
+
+	float filter[5];
+	filter[0] = 1.0f;
+	for (int a = 1; a < lags; a++)
+	{
+		filter[a] = -rho[a-1];
+	}
+
+	for (int a = 0; a < lags; a++)
+	{
+		for (int b = 0; b < lags; b++)
+		{
+			Filter_Products[a * lags + b] = filter[a] * filter[b];
+			if ( (a > 0) && (b > 0) )
+			{
+				Filter_Products[a * lags + b] += rhoCovariance[(b - 1) + (a - 1) * AR_ORDER];
+			}
+		}
+	}
+}
+
+// Element (i,j) of the posterior covariance of the weights, the diagonal is stored separately and the off-diagonal elements in the
+// upper triangle (the lower triangle holds the inverse Cholesky factor)
+float CovarianceElementBayesianVB(__global float* Covariance,
+	                              __global float* Variances,
+								  int i,
+								  int j,
+								  int P)
+{
+	if (i == j)
+	{
+		return Variances[i];
+	}
+	else if (i < j)
+	{
+		return Covariance[j + i * P];
+	}
+	else
+	{
+		return Covariance[i + j * P];
+	}
+}
+
+// Calculates the lagged cross products of regressors and data for all voxels in the mask of one slice, and initializes the
+// variational posterior of the AR parameters (zero) and the noise precision (one over the data variance). The products of the
+// voxels of the slice are stored one after the other in Statistics, the host moves them to their place in the voxel list
+__kernel void CalculateLagProductsBayesianVB(__global float* Statistics,
+	                                         __global float* State,
+											 __global const float* Volumes,
+											 __global const int* Voxel_Indices,
+											 __global const int* Slice_Positions,
+											 __constant float* c_X_GLM,
+											 __private int DATA_W,
+											 __private int DATA_H,
+											 __private int NUMBER_OF_VOLUMES,
+											 __private int NUMBER_OF_REGRESSORS,
+											 __private int AR_ORDER,
+											 __private int STATISTICS_PER_VOXEL,
+											 __private int STATE_PER_VOXEL,
+											 __private int slice,
+											 __private int NUMBER_OF_SLICE_VOXELS)
+{
+	int id = get_global_id(0);
+
+	if (id >= NUMBER_OF_SLICE_VOXELS)
+		return;
+
+	int P = NUMBER_OF_REGRESSORS;
+	int lags = AR_ORDER + 1;
+
+	int voxel = Slice_Positions[id];
+	int index = Voxel_Indices[voxel] - slice * DATA_W * DATA_H;
+
+	__global float* Data_Products = Statistics + id * STATISTICS_PER_VOXEL;
+	__global float* Data_Squares = Data_Products + lags * lags * P;
+	__global float* Voxel_State = State + voxel * STATE_PER_VOXEL;
+
+	// Lagged cross products of regressors and data, and of the data, sum_t x(t-a) y(t-b) and sum_t y(t-a) y(t-b)
+	for (int a = 0; a < lags; a++)
+	{
+		for (int b = 0; b < lags; b++)
+		{
+			for (int i = 0; i < P; i++)
+			{
+				float value = 0.0f;
+				for (int t = AR_ORDER; t < NUMBER_OF_VOLUMES; t++)
+				{
+					value += c_X_GLM[NUMBER_OF_VOLUMES * i + t - a] * Volumes[index + (t - b) * DATA_W * DATA_H];
+				}
+				Data_Products[(a * lags + b) * P + i] = value;
+			}
+
+			float value = 0.0f;
+			for (int t = AR_ORDER; t < NUMBER_OF_VOLUMES; t++)
+			{
+				value += Volumes[index + (t - a) * DATA_W * DATA_H] * Volumes[index + (t - b) * DATA_W * DATA_H];
+			}
+			Data_Squares[a * lags + b] = value;
+		}
+	}
+
+	// State, mean and covariance of rho, mean of the noise precision and the largest change of the weights
+	for (int i = 0; i < AR_ORDER + AR_ORDER * AR_ORDER; i++)
+	{
+		Voxel_State[i] = 0.0f;
+	}
+	Voxel_State[AR_ORDER + AR_ORDER * AR_ORDER] = (float)(NUMBER_OF_VOLUMES - AR_ORDER) / max(Data_Squares[0], 1e-10f);
+	Voxel_State[AR_ORDER + AR_ORDER * AR_ORDER + 1] = 1e10f;
+}
+
+// Mean field variational Bayes update for one voxel, of the regression weights, the AR parameters and the noise precision, in that
+// order. The weights have a Gaussian Markov random field prior with precision alpha_k for regressor k, such that the prior of a voxel
+// given its neighbours is N(mean of neighbours, 1 / (alpha_k * number of neighbours)). Voxels are updated in two sweeps of a
+// checkerboard pattern, the neighbours of a voxel are never updated at the same time. PPMs are calculated from the Gaussian
+// posterior of the weights. Statistics holds the lagged products of the voxels from STATISTICS_OFFSET and on (all voxels, or
+// only the current run if they do not fit into device memory). The change of a voxel is set to -1 if its precision matrix is
+// not positive definite, such voxels keep their old posterior and are left out of the convergence test
+
+__kernel void UpdateGLMBayesianVB(__global float* Statistical_Maps,
+	                              __global float* Beta_Volumes,
+								  __global float* Beta_Variances,
+								  __global float* AR_Estimates,
+								  __global float* State,
+								  __global float* Scratch,
+								  __global const float* Statistics,
+								  __global const int* Voxel_Indices,
+								  __global const float* Mask,
+								  __global const float* Lag_Products,
+								  __constant float* c_Contrasts,
+								  __constant float* c_Alpha,
+								  __private int DATA_W,
+								  __private int DATA_H,
+								  __private int DATA_D,
+								  __private int NUMBER_OF_VOLUMES,
+								  __private int NUMBER_OF_REGRESSORS,
+								  __private int NUMBER_OF_TOTAL_REGRESSORS,
+								  __private int NUMBER_OF_CONTRASTS,
+								  __private int AR_ORDER,
+								  __private int STATISTICS_PER_VOXEL,
+								  __private int STATE_PER_VOXEL,
+								  __private int VOXEL_OFFSET,
+								  __private int NUMBER_OF_VOXELS,
+								  __private int STATISTICS_OFFSET)
+{
+	int slot = get_global_id(0);
+	int voxel = VOXEL_OFFSET + slot;
+
+	if (voxel >= NUMBER_OF_VOXELS)
+		return;
+
+	int P = NUMBER_OF_REGRESSORS;
+	int lags = AR_ORDER + 1;
+	int VOLUME_SIZE = DATA_W * DATA_H * DATA_D;
+	int NUMBER_OF_OBSERVATIONS = NUMBER_OF_VOLUMES - AR_ORDER;
+
+	// Prior options, same as for the Gibbs sampler
+	float iota = 1.0f;                 // Decay factor for lag length in prior for rho.
+	float r = 0.5f;                    // Prior mean on rho1
+	float c = 0.3f;                    // Prior standard deviation on first lag.
+	float a0 = 0.01f;                  // First parameter in gamma prior for the noise precision
+	float b0 = 0.01f;                  // Second parameter in gamma prior for the noise precision
+
+	int index = Voxel_Indices[voxel];
+	int z = index / (DATA_W * DATA_H);
+	int y = (index - z * DATA_W * DATA_H) / DATA_W;
+	int x = index - z * DATA_W * DATA_H - y * DATA_W;
+
+	__global const float* Data_Products = Statistics + (voxel - STATISTICS_OFFSET) * STATISTICS_PER_VOXEL;
+	__global const float* Data_Squares = Data_Products + lags * lags * P;
+	__global float* Voxel_State = State + voxel * STATE_PER_VOXEL;
+	__global float* Covariance = Scratch + slot * (P * P + 2 * P);
+	__global float* Mean = Covariance + P * P;
+	__global float* Variances = Mean + P;
+
+	float rho[4];
+	float rhoCovariance[16];
+	for (int i = 0; i < AR_ORDER; i++)
+	{
+		rho[i] = Voxel_State[i];
+	}
+	for (int i = 0; i < AR_ORDER * AR_ORDER; i++)
+	{
+		rhoCovariance[i] = Voxel_State[AR_ORDER + i];
+	}
+	float lambda = Voxel_State[AR_ORDER + AR_ORDER * AR_ORDER];
+
+	float Filter_Products[25];
+	ExpectedFilterProductsBayesianVB(Filter_Products, rho, rhoCovariance, AR_ORDER);
+
+	// Sum of the posterior means of the neighbours (6-connectivity) in the mask
+	float neighbours = 0.0f;
+	float neighbourSums[25];
+	for (int k = 0; k < P; k++)
+	{
+		neighbourSums[k] = 0.0f;
+	}
+
+	for (int n = 0; n < 6; n++)
+	{
+		int xx = x + (n == 0) - (n == 1);
+		int yy = y + (n == 2) - (n == 3);
+		int zz = z + (n == 4) - (n == 5);
+
+		if ( (xx < 0) || (xx >= DATA_W) || (yy < 0) || (yy >= DATA_H) || (zz < 0) || (zz >= DATA_D) )
+			continue;
+
+		int neighbourIndex = Calculate3DIndex(xx,yy,zz,DATA_W,DATA_H);
+		if (Mask[neighbourIndex] != 1.0f)
+			continue;
+
+		neighbours += 1.0f;
+		for (int k = 0; k < P; k++)
+		{
+			neighbourSums[k] += Beta_Volumes[neighbourIndex + k * VOLUME_SIZE];
+		}
+	}
+
+	// Posterior precision of the weights, lambda E[Xtilde'Xtilde] + alpha * neighbours, and lambda E[Xtilde'Ytilde] + alpha * neighbour sums
+	for (int i = 0; i < P; i++)
+	{
+		for (int j = 0; j <= i; j++)
+		{
+			float value = 0.0f;
+			for (int ab = 0; ab < lags * lags; ab++)
+			{
+				value += Filter_Products[ab] * Lag_Products[(ab * P + i) * P + j];
+			}
+			value *= lambda;
+			if (i == j)
+			{
+				value += c_Alpha[i] * neighbours;
+			}
+			Covariance[j + i * P] = value;
+			Covariance[i + j * P] = value;
+		}
+
+		float value = 0.0f;
+		for (int ab = 0; ab < lags * lags; ab++)
+		{
+			value += Filter_Products[ab] * Data_Products[ab * P + i];
+		}
+		Mean[i] = lambda * value + c_Alpha[i] * neighbourSums[i];
+	}
+
+	// Keep the old posterior if the precision matrix is not positive definite, and mark the voxel as failed
+	if (CholeskyGlobal(Covariance, P))
+	{
+		Voxel_State[AR_ORDER + AR_ORDER * AR_ORDER + 1] = -1.0f;
+		return;
+	}
+
+	// Posterior mean, forward and backward substitution
+	for (int i = 0; i < P; i++)
+	{
+		float value = Mean[i];
+		for (int k = 0; k < i; k++)
+		{
+			value -= Covariance[k + i * P] * Mean[k];
+		}
+		Mean[i] = value / Covariance[i + i * P];
+	}
+
+	for (int i = P - 1; i >= 0; i--)
+	{
+		float value = Mean[i];
+		for (int k = i + 1; k < P; k++)
+		{
+			value -= Covariance[i + k * P] * Mean[k];
+		}
+		Mean[i] = value / Covariance[i + i * P];
+	}
+
+	// Inverse of the Cholesky factor, in place in the lower triangle
+	for (int j = 0; j < P; j++)
+	{
+		Covariance[j + j * P] = 1.0f / Covariance[j + j * P];
+		for (int i = j + 1; i < P; i++)
+		{
+			float value = 0.0f;
+			for (int k = j; k < i; k++)
+			{
+				value -= Covariance[k + i * P] * Covariance[j + k * P];
+			}
+			Covariance[j + i * P] = value / Covariance[i + i * P];
+		}
+	}
+
+	// Posterior covariance L^-T L^-1, diagonal separately and the rest in the upper triangle
+	for (int i = 0; i < P; i++)
+	{
+		for (int j = i; j < P; j++)
+		{
+			float value = 0.0f;
+			for (int k = j; k < P; k++)
+			{
+				value += Covariance[i + k * P] * Covariance[j + k * P];
+			}
+
+			if (i == j)
+			{
+				Variances[i] = value;
+			}
+			else
+			{
+				Covariance[j + i * P] = value;
+			}
+		}
+	}
+
+	// Largest change of the posterior means, in posterior standard deviations
+	float change = 0.0f;
+	for (int k = 0; k < P; k++)
+	{
+		change = max(change, fabs(Mean[k] - Beta_Volumes[index + k * VOLUME_SIZE]) / sqrt(Variances[k]));
+		Beta_Volumes[index + k * VOLUME_SIZE] = Mean[k];
+		Beta_Variances[index + k * VOLUME_SIZE] = Variances[k];
+	}
+
+	// Expected lagged products of the residuals, sum_t e(t-a) e(t-b) for the posterior mean plus trace(X'X(a,b) Covariance)
+	float residualProducts[25];
+	for (int a = 0; a < lags; a++)
+	{
+		for (int b = a; b < lags; b++)
+		{
+			float value = Data_Squares[a * lags + b];
+			for (int i = 0; i < P; i++)
+			{
+				float Xbeta = 0.0f;
+				float trace = 0.0f;
+				for (int j = 0; j < P; j++)
+				{
+					float XX = Lag_Products[((a * lags + b) * P + i) * P + j];
+					Xbeta += XX * Mean[j];
+					trace += XX * CovarianceElementBayesianVB(Covariance, Variances, i, j, P);
+				}
+				value += Mean[i] * (Xbeta - Data_Products[(a * lags + b) * P + i] - Data_Products[(b * lags + a) * P + i]) + trace;
+			}
+			residualProducts[a * lags + b] = value;
+			residualProducts[b * lags + a] = value;
+		}
+	}
+
+	// Posterior of rho, precision lambda E[residual products] + prior precision, prior N(r, c^2) for the first lag and N(0, c^2 / j^(2 iota)) for lag j
+	float A[16];
+	float mean[4];
+	for (int j = 0; j < AR_ORDER; j++)
+	{
+		float priorPrecision = pow((float)(j + 1), 2.0f * iota) / (c * c);
+
+		for (int l = 0; l < AR_ORDER; l++)
+		{
+			A[l + j * AR_ORDER] = lambda * residualProducts[(j + 1) * lags + (l + 1)];
+		}
+		A[j + j * AR_ORDER] += priorPrecision;
+
+		mean[j] = lambda * residualProducts[(j + 1) * lags + 0];
+		if (j == 0)
+		{
+			mean[j] += priorPrecision * r;
+		}
+	}
+
+	if (!CholeskyPrivate(A, AR_ORDER))
+	{
+		for (int i = 0; i < AR_ORDER; i++)
+		{
+			float value = mean[i];
+			for (int k = 0; k < i; k++)
+			{
+				value -= A[k + i * AR_ORDER] * mean[k];
+			}
+			mean[i] = value / A[i + i * AR_ORDER];
+		}
+
+		for (int i = AR_ORDER - 1; i >= 0; i--)
+		{
+			float value = mean[i];
+			for (int k = i + 1; k < AR_ORDER; k++)
+			{
+				value -= A[i + k * AR_ORDER] * mean[k];
+			}
+			mean[i] = value / A[i + i * AR_ORDER];
+		}
+
+		// Only accept a stationary process, |rho_1| + ... + |rho_k| < 1
+		float sum = 0.0f;
+		for (int i = 0; i < AR_ORDER; i++)
+		{
+			sum += fabs(mean[i]);
+		}
+
+		if (sum < 1.0f)
+		{
+			// Covariance of rho, L^-T L^-1
+			for (int j = 0; j < AR_ORDER; j++)
+			{
+				A[j + j * AR_ORDER] = 1.0f / A[j + j * AR_ORDER];
+				for (int i = j + 1; i < AR_ORDER; i++)
+				{
+					float value = 0.0f;
+					for (int k = j; k < i; k++)
+					{
+						value -= A[k + i * AR_ORDER] * A[j + k * AR_ORDER];
+					}
+					A[j + i * AR_ORDER] = value / A[i + i * AR_ORDER];
+				}
+			}
+
+			for (int i = 0; i < AR_ORDER; i++)
+			{
+				rho[i] = mean[i];
+				for (int j = 0; j < AR_ORDER; j++)
+				{
+					float value = 0.0f;
+					for (int k = max(i,j); k < AR_ORDER; k++)
+					{
+						value += A[i + k * AR_ORDER] * A[j + k * AR_ORDER];
+					}
+					rhoCovariance[j + i * AR_ORDER] = value;
+				}
+			}
+		}
+	}
+
+	// Posterior of the noise precision, gamma with shape a0 + N/2 and rate b0 + E[e'e]/2
+	ExpectedFilterProductsBayesianVB(Filter_Products, rho, rhoCovariance, AR_ORDER);
+
+	float squaredResiduals = 0.0f;
+	for (int ab = 0; ab < lags * lags; ab++)
+	{
+		squaredResiduals += Filter_Products[ab] * residualProducts[ab];
+	}
+	lambda = (a0 + (float)NUMBER_OF_OBSERVATIONS / 2.0f) / (b0 + 0.5f * max(squaredResiduals, 0.0f));
+
+	for (int i = 0; i < AR_ORDER; i++)
+	{
+		Voxel_State[i] = rho[i];
+	}
+	for (int i = 0; i < AR_ORDER * AR_ORDER; i++)
+	{
+		Voxel_State[AR_ORDER + i] = rhoCovariance[i];
+	}
+	Voxel_State[AR_ORDER + AR_ORDER * AR_ORDER] = lambda;
+	Voxel_State[AR_ORDER + AR_ORDER * AR_ORDER + 1] = change;
+
+	AR_Estimates[index] = rho[0];
+
+	// Posterior probability that each contrast is larger than zero
+	for (int m = 0; m < NUMBER_OF_CONTRASTS; m++)
+	{
+		float contrastMean = 0.0f;
+		float contrastVariance = 0.0f;
+		for (int i = 0; i < P; i++)
+		{
+			float ci = c_Contrasts[NUMBER_OF_TOTAL_REGRESSORS * m + i];
+			contrastMean += ci * Mean[i];
+			for (int j = 0; j < P; j++)
+			{
+				contrastVariance += ci * c_Contrasts[NUMBER_OF_TOTAL_REGRESSORS * m + j] * CovarianceElementBayesianVB(Covariance, Variances, i, j, P);
+			}
+		}
+		Statistical_Maps[index + m * VOLUME_SIZE] = 0.5f * erfc(-contrastMean / sqrt(2.0f * max(contrastVariance, 1e-20f)));
+	}
+}
+
+// Expected squared differences E[(w_i - w_j)^2] of each regressor, summed over the neighbours of a voxel in the positive x, y and z
+// directions (every pair of neighbours is counted once), used to update the spatial precisions on the host. The last value for each
+// voxel is the largest change of its weights in the last update, -1 if the update failed
+__kernel void CalculateSpatialPriorBayesianVB(__global float* Energy,
+	                                          __global const float* Beta_Volumes,
+											  __global const float* Beta_Variances,
+											  __global const float* State,
+											  __global const int* Voxel_Indices,
+											  __global const float* Mask,
+											  __private int DATA_W,
+											  __private int DATA_H,
+											  __private int DATA_D,
+											  __private int NUMBER_OF_REGRESSORS,
+											  __private int STATE_PER_VOXEL,
+											  __private int NUMBER_OF_VOXELS)
+{
+	int voxel = get_global_id(0);
+
+	if (voxel >= NUMBER_OF_VOXELS)
+		return;
+
+	int P = NUMBER_OF_REGRESSORS;
+	int VOLUME_SIZE = DATA_W * DATA_H * DATA_D;
+
+	int index = Voxel_Indices[voxel];
+	int z = index / (DATA_W * DATA_H);
+	int y = (index - z * DATA_W * DATA_H) / DATA_W;
+	int x = index - z * DATA_W * DATA_H - y * DATA_W;
+
+	for (int k = 0; k < P; k++)
+	{
+		float mean = Beta_Volumes[index + k * VOLUME_SIZE];
+		float variance = Beta_Variances[index + k * VOLUME_SIZE];
+		float energy = 0.0f;
+
+		for (int n = 0; n < 3; n++)
+		{
+			int xx = x + (n == 0);
+			int yy = y + (n == 1);
+			int zz = z + (n == 2);
+
+			if ( (xx >= DATA_W) || (yy >= DATA_H) || (zz >= DATA_D) )
+				continue;
+
+			int neighbourIndex = Calculate3DIndex(xx,yy,zz,DATA_W,DATA_H);
+			if (Mask[neighbourIndex] != 1.0f)
+				continue;
+
+			float difference = mean - Beta_Volumes[neighbourIndex + k * VOLUME_SIZE];
+			energy += difference * difference + variance + Beta_Variances[neighbourIndex + k * VOLUME_SIZE];
+		}
+
+		Energy[voxel * (P + 1) + k] = energy;
+	}
+
+	Energy[voxel * (P + 1) + P] = State[voxel * STATE_PER_VOXEL + STATE_PER_VOXEL - 1];
+}
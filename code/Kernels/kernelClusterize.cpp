@@ -655,3 +655,170 @@ __kernel void CalculatePermutationPValuesClusterMassInference(__global float* P_
 
 
 
+// Kernels for brain masking
+
+__kernel void InvertMask(__global float* Inverted_Mask,
+						 __global const float* Mask,
+						 __private int DATA_W,
+						 __private int DATA_H,
+						 __private int DATA_D)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if (x >= DATA_W || y >= DATA_H || z >= DATA_D)
+		return;
+
+	if ( Mask[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] == 1.0f )
+	{
+		Inverted_Mask[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = 0.0f;
+	}
+	else
+	{
+		Inverted_Mask[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = 1.0f;
+	}
+}
+
+// A voxel is kept if any voxel in the 3 x 3 x 3 neighbourhood is inside the mask
+__kernel void DilateMask(__global float* Dilated_Mask,
+						 __global const float* Mask,
+						 __private int DATA_W,
+						 __private int DATA_H,
+						 __private int DATA_D)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if (x >= DATA_W || y >= DATA_H || z >= DATA_D)
+		return;
+
+	float value = 0.0f;
+	for (int zz = -1; zz <= 1; zz++)
+	{
+		for (int yy = -1; yy <= 1; yy++)
+		{
+			for (int xx = -1; xx <= 1; xx++)
+			{
+				if ( IsInsideVolume(x+xx,y+yy,z+zz,DATA_W,DATA_H,DATA_D) && (Mask[Calculate3DIndex(x+xx,y+yy,z+zz,DATA_W,DATA_H)] == 1.0f) )
+				{
+					value = 1.0f;
+				}
+			}
+		}
+	}
+
+	Dilated_Mask[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = value;
+}
+
+// A voxel is kept if all voxels in the 3 x 3 x 3 neighbourhood are inside the mask, voxels outside the volume are ignored
+// (the brain often touches the first or last slice of an EPI volume)
+__kernel void ErodeMask(__global float* Eroded_Mask,
+						__global const float* Mask,
+						__private int DATA_W,
+						__private int DATA_H,
+						__private int DATA_D)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if (x >= DATA_W || y >= DATA_H || z >= DATA_D)
+		return;
+
+	float value = 1.0f;
+	for (int zz = -1; zz <= 1; zz++)
+	{
+		for (int yy = -1; yy <= 1; yy++)
+		{
+			for (int xx = -1; xx <= 1; xx++)
+			{
+				if ( IsInsideVolume(x+xx,y+yy,z+zz,DATA_W,DATA_H,DATA_D) && (Mask[Calculate3DIndex(x+xx,y+yy,z+zz,DATA_W,DATA_H)] != 1.0f) )
+				{
+					value = 0.0f;
+				}
+			}
+		}
+	}
+
+	Eroded_Mask[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = value;
+}
+
+// Keeps the voxels with a specific cluster index
+__kernel void SelectCluster(__global float* Mask,
+							__global const unsigned int* Cluster_Indices,
+							__private unsigned int clusterIndex,
+							__private int DATA_W,
+							__private int DATA_H,
+							__private int DATA_D)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if (x >= DATA_W || y >= DATA_H || z >= DATA_D)
+		return;
+
+	if ( Cluster_Indices[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] == clusterIndex )
+	{
+		Mask[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = 1.0f;
+	}
+	else
+	{
+		Mask[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = 0.0f;
+	}
+}
+
+// Flags all clusters (of the inverted mask) that touch the border of the volume
+__kernel void MarkBorderClusters(__global unsigned int* Border_Clusters,
+								 __global const unsigned int* Cluster_Indices,
+								 __private int DATA_W,
+								 __private int DATA_H,
+								 __private int DATA_D)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if (x >= DATA_W || y >= DATA_H || z >= DATA_D)
+		return;
+
+	if ( (x != 0) && (y != 0) && (z != 0) && (x != (DATA_W - 1)) && (y != (DATA_H - 1)) && (z != (DATA_D - 1)) )
+		return;
+
+	unsigned int clusterIndex = Cluster_Indices[Calculate3DIndex(x,y,z,DATA_W,DATA_H)];
+
+	// Voxels that are not part of any cluster have an index larger than the number of voxels
+	if ( clusterIndex < (unsigned int)(DATA_W * DATA_H * DATA_D) )
+	{
+		Border_Clusters[clusterIndex] = 1;
+	}
+}
+
+// Background clusters that do not touch the border of the volume are holes, add them to the mask
+__kernel void FillMaskHoles(__global float* Mask,
+							__global const unsigned int* Cluster_Indices,
+							__global const unsigned int* Border_Clusters,
+							__private int DATA_W,
+							__private int DATA_H,
+							__private int DATA_D)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if (x >= DATA_W || y >= DATA_H || z >= DATA_D)
+		return;
+
+	if ( Mask[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] == 1.0f )
+		return;
+
+	unsigned int clusterIndex = Cluster_Indices[Calculate3DIndex(x,y,z,DATA_W,DATA_H)];
+
+	if ( (clusterIndex < (unsigned int)(DATA_W * DATA_H * DATA_D)) && (Border_Clusters[clusterIndex] == 0) )
+	{
+		Mask[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = 1.0f;
+	}
+}
+
@@ -103,6 +103,57 @@ __kernel void LogitMatrixDouble(__global double* Matrix,
 	Matrix[x] = 1.0 - (2.0 / (1.0 + exp(-Matrix[x] )) );
 }
 
+// Nonlinearity of FastICA and its derivative, log cosh (g(u) = tanh(u)) or kurtosis (g(u) = u^3)
+__kernel void FastICANonlinearity(__global float* Matrix, 
+                                  __global float* Derivatives, 
+  			     			      __private int N,
+  			     			      __private int NONLINEARITY)
+{
+	int x = get_global_id(0);	
+
+	if (x >= N)
+		return;
+
+	float u = Matrix[x];
+
+	if (NONLINEARITY == 0)
+	{
+		float g = tanh(u);
+		Matrix[x] = g;
+		Derivatives[x] = 1.0f - g * g;
+	}
+	else
+	{
+		Matrix[x] = u * u * u;
+		Derivatives[x] = 3.0f * u * u;
+	}
+}
+
+__kernel void FastICANonlinearityDouble(__global double* Matrix, 
+                                        __global double* Derivatives, 
+  			     			            __private int N,
+  			     			            __private int NONLINEARITY)
+{
+	int x = get_global_id(0);	
+
+	if (x >= N)
+		return;
+
+	double u = Matrix[x];
+
+	if (NONLINEARITY == 0)
+	{
+		double g = tanh(u);
+		Matrix[x] = g;
+		Derivatives[x] = 1.0 - g * g;
+	}
+	else
+	{
+		Matrix[x] = u * u * u;
+		Derivatives[x] = 3.0 * u * u;
+	}
+}
+
 __kernel void GetSubMatrix(__global float* Small_Matrix, 
                            __global const float* Matrix, 
   			     		   __private int startRow,
@@ -708,6 +759,141 @@ __kernel void SliceTimingCorrection(__global float* Corrected_Volumes,
 	}
 }
 
+// Slice timing correction of a slab of slices for all time points, stored as x, y, z, t
+// c_Slice_Differences contains the shift (in TR) of every slice in the whole volume, SLAB_START is the first slice of the slab
+
+int ClampTimePoint(int t, int DATA_T)
+{
+	return min(max(t, 0), DATA_T - 1);
+}
+
+__kernel void SliceTimingCorrectionCubicVolumes(__global float* Corrected_Volumes, 
+                                                __global const float* Volumes, 									 
+                                                __constant float* c_Slice_Differences, 									 
+                                                __private int DATA_W, 
+                                                __private int DATA_H, 
+                                                __private int DATA_D, 
+                                                __private int DATA_T,
+                                                __private int SLAB_START)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if (x >= DATA_W || y >= DATA_H || z >= DATA_D)
+		return;
+
+	float delta = c_Slice_Differences[SLAB_START + z];
+
+	// Same neighbours as in SliceTimingCorrection, edge values are repeated
+	int offset = -1;
+	if (delta <= 0.0f)
+	{
+		delta = 1.0f + delta;
+		offset = -2;
+	}
+
+	for (int t = 0; t < DATA_T; t++)
+	{
+		float t0 = Volumes[Calculate4DIndex(x,y,z,ClampTimePoint(t + offset,DATA_T),DATA_W,DATA_H,DATA_D)];
+		float t1 = Volumes[Calculate4DIndex(x,y,z,ClampTimePoint(t + offset + 1,DATA_T),DATA_W,DATA_H,DATA_D)];
+		float t2 = Volumes[Calculate4DIndex(x,y,z,ClampTimePoint(t + offset + 2,DATA_T),DATA_W,DATA_H,DATA_D)];
+		float t3 = Volumes[Calculate4DIndex(x,y,z,ClampTimePoint(t + offset + 3,DATA_T),DATA_W,DATA_H,DATA_D)];
+
+		Corrected_Volumes[Calculate4DIndex(x,y,z,t,DATA_W,DATA_H,DATA_D)] = InterpolateCubic(t0,t1,t2,t3,delta); 
+	}
+}
+
+float Sinc(float x)
+{
+	if (fabs(x) < 1e-6f)
+		return 1.0f;
+
+	return sin(M_PI_F * x) / (M_PI_F * x);
+}
+
+// Windowed sinc (Lanczos) interpolation in time, with HALF_WIDTH time points on each side
+__kernel void SliceTimingCorrectionSincVolumes(__global float* Corrected_Volumes, 
+                                               __global const float* Volumes, 									 
+                                               __constant float* c_Slice_Differences, 									 
+                                               __private int DATA_W, 
+                                               __private int DATA_H, 
+                                               __private int DATA_D, 
+                                               __private int DATA_T,
+                                               __private int SLAB_START,
+                                               __private int HALF_WIDTH)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if (x >= DATA_W || y >= DATA_H || z >= DATA_D)
+		return;
+
+	float delta = c_Slice_Differences[SLAB_START + z];
+	int shift = (int)floor(delta);
+	float fraction = delta - (float)shift;
+
+	for (int t = 0; t < DATA_T; t++)
+	{
+		float sum = 0.0f;
+		float weightSum = 0.0f;
+
+		for (int k = -HALF_WIDTH + 1; k <= HALF_WIDTH; k++)
+		{
+			float distance = fraction - (float)k;
+			float weight = Sinc(distance) * Sinc(distance / (float)HALF_WIDTH);
+			sum += weight * Volumes[Calculate4DIndex(x,y,z,ClampTimePoint(t + shift + k,DATA_T),DATA_W,DATA_H,DATA_D)];
+			weightSum += weight;
+		}
+
+		Corrected_Volumes[Calculate4DIndex(x,y,z,t,DATA_W,DATA_H,DATA_D)] = sum / weightSum; 
+	}
+}
+
+// Periodic sinc interpolation in time, gives the same result as a Fourier phase shift but is calculated as a 
+// direct circular convolution, i.e. O(DATA_T^2) operations per voxel instead of O(DATA_T log DATA_T)
+// The time series is mirrored to FILTER_LENGTH = 2 * DATA_T time points, to avoid wrap around at the ends
+// Filters contains one filter of length FILTER_LENGTH for every group of slices acquired at the same time, 
+// c_Slice_Groups contains the group of every slice in the whole volume
+__kernel void SliceTimingCorrectionPeriodicSincVolumes(__global float* Corrected_Volumes, 
+                                                     __global const float* Volumes, 									 
+                                                     __global const float* Filters, 									 
+                                                     __private int DATA_W, 
+                                                     __private int DATA_H, 
+                                                     __private int DATA_D, 
+                                                     __private int DATA_T,
+                                                     __private int SLAB_START,
+                                                     __constant int* c_Slice_Groups)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if (x >= DATA_W || y >= DATA_H || z >= DATA_D)
+		return;
+
+	int FILTER_LENGTH = 2 * DATA_T;
+	__global const float* Filter = &Filters[c_Slice_Groups[SLAB_START + z] * FILTER_LENGTH];
+
+	for (int t = 0; t < DATA_T; t++)
+	{
+		float sum = 0.0f;
+		int n = t;
+		for (int m = 0; m < FILTER_LENGTH; m++)
+		{
+			int tt = (n < DATA_T) ? n : (FILTER_LENGTH - 1 - n);
+			sum += Filter[m] * Volumes[Calculate4DIndex(x,y,z,tt,DATA_W,DATA_H,DATA_D)];
+
+			n++;
+			if (n == FILTER_LENGTH)
+				n = 0;
+		}
+
+		Corrected_Volumes[Calculate4DIndex(x,y,z,t,DATA_W,DATA_H,DATA_D)] = sum; 
+	}
+}
+
 __kernel void CalculateMagnitudes(__global float* Magnitudes,
 	                              __global const float2* Complex,
 								  __private int DATA_W, 
@@ -725,3 +911,305 @@ __kernel void CalculateMagnitudes(__global float* Magnitudes,
 	float i = Complex[Calculate3DIndex(x,y,z,DATA_W,DATA_H)].y;
 	Magnitudes[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = sqrt(r * r + i * i);
 }
+
+// Scatters values stored for a list of brain voxels, Values[v + i * NUMBER_OF_VOXELS], back into full volumes
+__kernel void ScatterVoxelValues(__global float* Volumes,
+	                             __global const float* Values,
+								 __global const int* Voxel_Indices,
+								 __private int NUMBER_OF_VOXELS,
+								 __private int VOLUME_SIZE,
+								 __private int NUMBER_OF_VOLUMES)
+{
+	int v = get_global_id(0);
+
+	if (v >= NUMBER_OF_VOXELS)
+		return;
+
+	int idx = Voxel_Indices[v];
+
+	for (int i = 0; i < NUMBER_OF_VOLUMES; i++)
+	{
+		Volumes[idx + i * VOLUME_SIZE] = Values[v + i * NUMBER_OF_VOXELS];
+	}
+}
+
+// Copies values of brain voxels from full volumes into a compact layout, Values[v + i * NUMBER_OF_VOXELS], the inverse of ScatterVoxelValues
+__kernel void GatherVoxelValues(__global float* Values, 
+	                            __global const float* Volumes, 
+								__global const int* Voxel_Indices, 
+								__private int NUMBER_OF_VOXELS, 
+								__private int VOLUME_SIZE, 
+								__private int NUMBER_OF_VOLUMES) 
+{
+	int v = get_global_id(0);
+
+	if (v >= NUMBER_OF_VOXELS)
+		return;
+
+	int idx = Voxel_Indices[v];
+
+	for (int i = 0; i < NUMBER_OF_VOLUMES; i++)
+	{
+		Values[v + i * NUMBER_OF_VOXELS] = Volumes[idx + i * VOLUME_SIZE];
+	}
+}
+
+// Finds the maximum of values stored in a compact layout, where all values are brain voxels and no mask is needed
+__kernel void CalculateMaxAtomicCompact(volatile __global int* max_value,
+	                                    __global const float* Values,
+								        __private int NUMBER_OF_VOXELS)
+{
+	int v = get_global_id(0);	
+
+	if (v >= NUMBER_OF_VOXELS)
+		return;
+
+	int value = (int)(Values[v] * 10000.0f);
+	atomic_max(max_value, value);
+}
+
+
+
+
+// Kernels for volume statistics, each work group stores 8 partial statistics
+// (number of voxels, mean, sum of squared deviations, min, max and the intensity weighted sums of x, y and z)
+
+// Merges the running statistics (n2, mean2, M22) into (n, mean, M2), with the pairwise formula of Chan et al.
+void CombineRunningStatistics(float* n, float* mean, float* M2, float n2, float mean2, float M22)
+{
+	float n12 = *n + n2;
+
+	if (n12 == 0.0f)
+		return;
+
+	float delta = mean2 - *mean;
+	*M2 += M22 + delta * delta * (*n) * n2 / n12;
+	*mean += delta * n2 / n12;
+	*n = n12;
+}
+
+// Reduces the statistics of all work items in a group, l_Statistics holds 8 values per work item
+void ReduceStatisticsInGroup(__local float* l_Statistics)
+{
+	int tid = get_local_id(0);
+	int localSize = get_local_size(0);
+
+	for (int s = localSize / 2; s > 0; s >>= 1)
+	{
+		if (tid < s)
+		{
+			float n = l_Statistics[0 * localSize + tid];
+			float mean = l_Statistics[1 * localSize + tid];
+			float M2 = l_Statistics[2 * localSize + tid];
+
+			CombineRunningStatistics(&n, &mean, &M2, l_Statistics[0 * localSize + tid + s], l_Statistics[1 * localSize + tid + s], l_Statistics[2 * localSize + tid + s]);
+
+			l_Statistics[0 * localSize + tid] = n;
+			l_Statistics[1 * localSize + tid] = mean;
+			l_Statistics[2 * localSize + tid] = M2;
+			l_Statistics[3 * localSize + tid] = min(l_Statistics[3 * localSize + tid], l_Statistics[3 * localSize + tid + s]);
+			l_Statistics[4 * localSize + tid] = max(l_Statistics[4 * localSize + tid], l_Statistics[4 * localSize + tid + s]);
+			l_Statistics[5 * localSize + tid] += l_Statistics[5 * localSize + tid + s];
+			l_Statistics[6 * localSize + tid] += l_Statistics[6 * localSize + tid + s];
+			l_Statistics[7 * localSize + tid] += l_Statistics[7 * localSize + tid + s];
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+}
+
+// First pass, every work item loops over the volume with a stride of the global size and the work group writes its partial statistics.
+// The work group size has to be a power of two
+__kernel void CalculateVolumeStatistics(__global float* Partial_Statistics,
+	                                    __global const float* Volume,
+										__global const float* Mask,
+										__local float* l_Statistics,
+										__private int USE_MASK,
+										__private int DATA_W,
+										__private int DATA_H,
+										__private int DATA_D)
+{
+	int tid = get_local_id(0);
+	int localSize = get_local_size(0);
+	int N = DATA_W * DATA_H * DATA_D;
+
+	float n = 0.0f;
+	float mean = 0.0f;
+	float M2 = 0.0f;
+	float minValue = INFINITY;
+	float maxValue = -INFINITY;
+	float sumX = 0.0f;
+	float sumY = 0.0f;
+	float sumZ = 0.0f;
+
+	for (int i = get_global_id(0); i < N; i += get_global_size(0))
+	{
+		if ( USE_MASK && (Mask[i] != 1.0f) )
+			continue;
+
+		float value = Volume[i];
+
+		// Welford's update of the mean and the sum of squared deviations
+		n += 1.0f;
+		float delta = value - mean;
+		mean += delta / n;
+		M2 += delta * (value - mean);
+
+		minValue = min(minValue, value);
+		maxValue = max(maxValue, value);
+
+		int x = i % DATA_W;
+		int y = (i / DATA_W) % DATA_H;
+		int z = i / (DATA_W * DATA_H);
+
+		sumX += value * (float)x;
+		sumY += value * (float)y;
+		sumZ += value * (float)z;
+	}
+
+	l_Statistics[0 * localSize + tid] = n;
+	l_Statistics[1 * localSize + tid] = mean;
+	l_Statistics[2 * localSize + tid] = M2;
+	l_Statistics[3 * localSize + tid] = minValue;
+	l_Statistics[4 * localSize + tid] = maxValue;
+	l_Statistics[5 * localSize + tid] = sumX;
+	l_Statistics[6 * localSize + tid] = sumY;
+	l_Statistics[7 * localSize + tid] = sumZ;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	ReduceStatisticsInGroup(l_Statistics);
+
+	if (tid == 0)
+	{
+		for (int s = 0; s < 8; s++)
+		{
+			Partial_Statistics[get_group_id(0) * 8 + s] = l_Statistics[s * localSize];
+		}
+	}
+}
+
+// Second pass, a single work group combines the partial statistics into
+// number of voxels, mean, variance, min, max and center of mass (x, y, z)
+__kernel void ReduceVolumeStatistics(__global float* Statistics,
+	                                 __global const float* Partial_Statistics,
+									 __local float* l_Statistics,
+									 __private int NUMBER_OF_GROUPS)
+{
+	int tid = get_local_id(0);
+	int localSize = get_local_size(0);
+
+	float n = 0.0f;
+	float mean = 0.0f;
+	float M2 = 0.0f;
+	float minValue = INFINITY;
+	float maxValue = -INFINITY;
+	float sumX = 0.0f;
+	float sumY = 0.0f;
+	float sumZ = 0.0f;
+
+	for (int g = tid; g < NUMBER_OF_GROUPS; g += localSize)
+	{
+		CombineRunningStatistics(&n, &mean, &M2, Partial_Statistics[g * 8 + 0], Partial_Statistics[g * 8 + 1], Partial_Statistics[g * 8 + 2]);
+		minValue = min(minValue, Partial_Statistics[g * 8 + 3]);
+		maxValue = max(maxValue, Partial_Statistics[g * 8 + 4]);
+		sumX += Partial_Statistics[g * 8 + 5];
+		sumY += Partial_Statistics[g * 8 + 6];
+		sumZ += Partial_Statistics[g * 8 + 7];
+	}
+
+	l_Statistics[0 * localSize + tid] = n;
+	l_Statistics[1 * localSize + tid] = mean;
+	l_Statistics[2 * localSize + tid] = M2;
+	l_Statistics[3 * localSize + tid] = minValue;
+	l_Statistics[4 * localSize + tid] = maxValue;
+	l_Statistics[5 * localSize + tid] = sumX;
+	l_Statistics[6 * localSize + tid] = sumY;
+	l_Statistics[7 * localSize + tid] = sumZ;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	ReduceStatisticsInGroup(l_Statistics);
+
+	if (tid == 0)
+	{
+		n = l_Statistics[0];
+		mean = l_Statistics[1];
+		float totalMass = n * mean;
+
+		Statistics[0] = n;
+		Statistics[1] = mean;
+		Statistics[2] = (n > 1.0f) ? l_Statistics[2 * localSize] / (n - 1.0f) : 0.0f;
+		Statistics[3] = l_Statistics[3 * localSize];
+		Statistics[4] = l_Statistics[4 * localSize];
+		Statistics[5] = (totalMass != 0.0f) ? l_Statistics[5 * localSize] / totalMass : 0.0f;
+		Statistics[6] = (totalMass != 0.0f) ? l_Statistics[6 * localSize] / totalMass : 0.0f;
+		Statistics[7] = (totalMass != 0.0f) ? l_Statistics[7 * localSize] / totalMass : 0.0f;
+	}
+}
+
+// Third pass, histogram over [min, max] of the reduced statistics, bins are privatised in local memory and merged once per work group
+__kernel void CalculateVolumeHistogram(volatile __global unsigned int* Histogram,
+	                                   __global const float* Volume,
+									   __global const float* Mask,
+									   __global const float* Statistics,
+									   volatile __local unsigned int* l_Histogram,
+									   __private int USE_MASK,
+									   __private int NUMBER_OF_BINS,
+									   __private int DATA_W,
+									   __private int DATA_H,
+									   __private int DATA_D)
+{
+	int tid = get_local_id(0);
+	int localSize = get_local_size(0);
+	int N = DATA_W * DATA_H * DATA_D;
+
+	for (int bin = tid; bin < NUMBER_OF_BINS; bin += localSize)
+	{
+		l_Histogram[bin] = 0;
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	float minValue = Statistics[3];
+	float maxValue = Statistics[4];
+	float binScale = (maxValue > minValue) ? (float)NUMBER_OF_BINS / (maxValue - minValue) : 0.0f;
+
+	for (int i = get_global_id(0); i < N; i += get_global_size(0))
+	{
+		if ( USE_MASK && (Mask[i] != 1.0f) )
+			continue;
+
+		int bin = (int)((Volume[i] - minValue) * binScale);
+		bin = clamp(bin, 0, NUMBER_OF_BINS - 1);
+
+		atomic_inc(&l_Histogram[bin]);
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int bin = tid; bin < NUMBER_OF_BINS; bin += localSize)
+	{
+		if (l_Histogram[bin] != 0)
+		{
+			atomic_add(&Histogram[bin], l_Histogram[bin]);
+		}
+	}
+}
+
+// Normalizes a volume to zero mean and unit variance, with the statistics kept on the device
+__kernel void NormalizeVolumeIntensity(__global float* Volume,
+	                                   __global const float* Statistics,
+									   __private int DATA_W,
+									   __private int DATA_H,
+									   __private int DATA_D)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if (x >= DATA_W || y >= DATA_H || z >= DATA_D)
+		return;
+
+	float mean = Statistics[1];
+	float variance = Statistics[2];
+	float scale = (variance > 0.0f) ? rsqrt(variance) : 1.0f;
+
+	int idx = Calculate3DIndex(x,y,z,DATA_W,DATA_H);
+	Volume[idx] = (Volume[idx] - mean) * scale;
+}
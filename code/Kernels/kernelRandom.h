@@ -0,0 +1,216 @@
+/*
+    BROCCOLI: Software for Fast fMRI Analysis on Many-Core CPUs and GPUs
+    Copyright (C) <2013>  Anders Eklund, andek034@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+    FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+    OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+    DEALINGS IN THE SOFTWARE.
+*/
+
+// Counter based random numbers (Philox4x32-10), shared by the OpenCL kernels and the host code.
+// This file is put in front of the code of every OpenCL program, and is included by broccoli_lib.cpp.
+//
+// A stream is given by a seed and a key (stream, iteration, chain), e.g. stream = voxel index. The random
+// integers and uniform numbers of a stream are identical on all devices and on the host, normal and gamma
+// numbers agree to the accuracy of log, sqrt and cos on the device. Everything is in single precision.
+
+#ifndef KERNEL_RANDOM_H
+#define KERNEL_RANDOM_H
+
+#ifdef __OPENCL_VERSION__
+	#define RANDOM_UINT uint
+	#define RANDOM_INLINE
+	#define RANDOM_LOG log
+	#define RANDOM_SQRT sqrt
+	#define RANDOM_COS cos
+	#define RANDOM_SIN sin
+	#define RANDOM_POW pow
+#else
+	#include <stdint.h>
+	#include <math.h>
+	#define RANDOM_UINT uint32_t
+	#define RANDOM_INLINE static inline
+	#define RANDOM_LOG logf
+	#define RANDOM_SQRT sqrtf
+	#define RANDOM_COS cosf
+	#define RANDOM_SIN sinf
+	#define RANDOM_POW powf
+#endif
+
+#define RANDOM_TWO_PI 6.283185307179586f
+
+typedef struct
+{
+	RANDOM_UINT counter[4];
+	RANDOM_UINT key[2];
+	RANDOM_UINT values[4];
+	int index;
+	float normal;
+	int hasNormal;
+} RandomState;
+
+// High 32 bits of a 32 x 32 bit product
+RANDOM_INLINE RANDOM_UINT RandomMulHi(RANDOM_UINT a, RANDOM_UINT b)
+{
+#ifdef __OPENCL_VERSION__
+	return mul_hi(a, b);
+#else
+	return (RANDOM_UINT)(((uint64_t)a * (uint64_t)b) >> 32);
+#endif
+}
+
+// Philox4x32 with 10 rounds, encrypts the counter (c0,c1,c2,c3) with the key (k0,k1)
+RANDOM_INLINE void Philox4x32(RANDOM_UINT* out, RANDOM_UINT c0, RANDOM_UINT c1, RANDOM_UINT c2, RANDOM_UINT c3, RANDOM_UINT k0, RANDOM_UINT k1)
+{
+	for (int r = 0; r < 10; r++)
+	{
+		RANDOM_UINT hi0 = RandomMulHi(0xD2511F53u, c0);
+		RANDOM_UINT lo0 = 0xD2511F53u * c0;
+		RANDOM_UINT hi1 = RandomMulHi(0xCD9E8D57u, c2);
+		RANDOM_UINT lo1 = 0xCD9E8D57u * c2;
+
+		c0 = hi1 ^ c1 ^ k0;
+		c1 = lo1;
+		c2 = hi0 ^ c3 ^ k1;
+		c3 = lo0;
+
+		k0 += 0x9E3779B9u;
+		k1 += 0xBB67AE85u;
+	}
+
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+// Starts the stream (stream, iteration, chain) for a seed, the same key always gives the same numbers
+RANDOM_INLINE void RandomInitialize(RandomState* state, RANDOM_UINT seed, RANDOM_UINT stream, RANDOM_UINT iteration, RANDOM_UINT chain)
+{
+	state->counter[0] = stream;
+	state->counter[1] = iteration;
+	state->counter[2] = 0;
+	state->counter[3] = 0;
+	state->key[0] = seed;
+	state->key[1] = chain;
+	state->index = 4;
+	state->hasNormal = 0;
+	state->normal = 0.0f;
+}
+
+// Random 32 bit integer, four integers are generated per call of Philox4x32
+RANDOM_INLINE RANDOM_UINT RandomUint(RandomState* state)
+{
+	if (state->index == 4)
+	{
+		Philox4x32(state->values, state->counter[0], state->counter[1], state->counter[2], state->counter[3], state->key[0], state->key[1]);
+
+		state->counter[2]++;
+		if (state->counter[2] == 0)
+		{
+			state->counter[3]++;
+		}
+		state->index = 0;
+	}
+
+	RANDOM_UINT value = state->values[state->index];
+	state->index++;
+	return value;
+}
+
+// Uniform random number in (0,1), 24 bits such that the number is exact in single precision
+RANDOM_INLINE float RandomUniform(RandomState* state)
+{
+	return ((float)(RandomUint(state) >> 8) + 0.5f) * (1.0f / 16777216.0f);
+}
+
+// Uniform random integer in 0,...,N-1, without modulo bias
+RANDOM_INLINE RANDOM_UINT RandomInteger(RandomState* state, RANDOM_UINT N)
+{
+	RANDOM_UINT threshold = (0u - N) % N;
+	RANDOM_UINT value = RandomUint(state);
+	while (value < threshold)
+	{
+		value = RandomUint(state);
+	}
+	return value % N;
+}
+
+// Normal random number (zero mean, unit variance) by the Box-Muller transform, the second number of each pair is saved for the next call
+RANDOM_INLINE float RandomNormal(RandomState* state)
+{
+	if (state->hasNormal)
+	{
+		state->hasNormal = 0;
+		return state->normal;
+	}
+
+	float u = RandomUniform(state);
+	float v = RandomUniform(state);
+	float r = RANDOM_SQRT(-2.0f * RANDOM_LOG(u));
+
+	state->normal = r * RANDOM_SIN(RANDOM_TWO_PI * v);
+	state->hasNormal = 1;
+
+	return r * RANDOM_COS(RANDOM_TWO_PI * v);
+}
+
+// Gamma random number with shape a and scale 1 (Marsaglia and Tsang), shapes below 1 are boosted by a uniform number
+RANDOM_INLINE float RandomGamma(RandomState* state, float a)
+{
+	float boost = 1.0f;
+	if (a < 1.0f)
+	{
+		boost = RANDOM_POW(RandomUniform(state), 1.0f / a);
+		a += 1.0f;
+	}
+
+	float d = a - 1.0f / 3.0f;
+	float c = 1.0f / RANDOM_SQRT(9.0f * d);
+
+	while (1)
+	{
+		float x, v;
+		do
+		{
+			x = RandomNormal(state);
+			v = 1.0f + c * x;
+		} while (v <= 0.0f);
+
+		v = v * v * v;
+		float u = RandomUniform(state);
+
+		if (u < (1.0f - 0.0331f * x * x * x * x))
+		{
+			return d * v * boost;
+		}
+		if (RANDOM_LOG(u) < (0.5f * x * x + d * (1.0f - v + RANDOM_LOG(v))))
+		{
+			return d * v * boost;
+		}
+	}
+}
+
+// Inverse gamma random number with shape a and scale b
+RANDOM_INLINE float RandomInverseGamma(RandomState* state, float a, float b)
+{
+	return b / RandomGamma(state, a);
+}
+
+#endif
@@ -1187,7 +1187,115 @@ float bspline(float t)
 	else return 0.0f;
 }
 
+// Cubic B-spline interpolation from a texture of prefiltered B-spline coefficients,
+// the 64 weighted taps are folded into 8 trilinear fetches (one per corner of the
+// 2 x 2 x 2 block of tap pairs), Position is in texel coordinates (centers at i + 0.5)
 
+float InterpolateCubicBSpline(read_only image3d_t Coefficients, float3 Position)
+{
+	const float3 coord_grid = Position - 0.5f;
+	const float3 index = floor(coord_grid);
+	const float3 t = coord_grid - index;
+	const float3 one_t = 1.0f - t;
+	const float3 t2 = t * t;
+
+	const float3 w0 = one_t * one_t * one_t / 6.0f;
+	const float3 w1 = (3.0f * t2 * t - 6.0f * t2 + 4.0f) / 6.0f;
+	const float3 w2 = (-3.0f * t2 * t + 3.0f * t2 + 3.0f * t + 1.0f) / 6.0f;
+	const float3 w3 = t2 * t / 6.0f;
+
+	const float3 g0 = w0 + w1;
+	const float3 g1 = w2 + w3;
+	const float3 h0 = index - 0.5f + w1 / g0;
+	const float3 h1 = index + 1.5f + w3 / g1;
+
+	float tex000 = read_imagef(Coefficients, volume_sampler_linear, (float4)(h0.x, h0.y, h0.z, 0.0f)).x;
+	float tex100 = read_imagef(Coefficients, volume_sampler_linear, (float4)(h1.x, h0.y, h0.z, 0.0f)).x;
+	float tex010 = read_imagef(Coefficients, volume_sampler_linear, (float4)(h0.x, h1.y, h0.z, 0.0f)).x;
+	float tex110 = read_imagef(Coefficients, volume_sampler_linear, (float4)(h1.x, h1.y, h0.z, 0.0f)).x;
+	float tex001 = read_imagef(Coefficients, volume_sampler_linear, (float4)(h0.x, h0.y, h1.z, 0.0f)).x;
+	float tex101 = read_imagef(Coefficients, volume_sampler_linear, (float4)(h1.x, h0.y, h1.z, 0.0f)).x;
+	float tex011 = read_imagef(Coefficients, volume_sampler_linear, (float4)(h0.x, h1.y, h1.z, 0.0f)).x;
+	float tex111 = read_imagef(Coefficients, volume_sampler_linear, (float4)(h1.x, h1.y, h1.z, 0.0f)).x;
+
+	float result = g0.z * (g0.y * (g0.x * tex000 + g1.x * tex100) + g1.y * (g0.x * tex010 + g1.x * tex110))
+	             + g1.z * (g0.y * (g0.x * tex001 + g1.x * tex101) + g1.y * (g0.x * tex011 + g1.x * tex111));
+
+	return result;
+}
+
+// In-place conversion of samples to cubic B-spline coefficients along one line. The tridiagonal system
+// (1 4 1) / 6 is solved with clamped boundaries (5 1) / 6 and (1 5) / 6, to match CLK_ADDRESS_CLAMP_TO_EDGE,
+// the ratios of the forward sweep converge to 2 - sqrt(3) and are only tabulated for the first samples
+
+void BSplinePrefilterLine(__global float* Coefficients, int start, int stride, int N)
+{
+	if (N < 2)
+		return;
+
+	float ratios[16];
+	ratios[0] = 0.2f;
+	for (int n = 1; n < 16; n++)
+	{
+		ratios[n] = 1.0f / (4.0f - ratios[n-1]);
+	}
+
+	// Forward sweep
+	Coefficients[start] = 6.0f * Coefficients[start] * ratios[0];
+	for (int n = 1; n < (N - 1); n++)
+	{
+		Coefficients[start + n * stride] = (6.0f * Coefficients[start + n * stride] - Coefficients[start + (n - 1) * stride]) * ratios[min(n, 15)];
+	}
+	Coefficients[start + (N - 1) * stride] = (6.0f * Coefficients[start + (N - 1) * stride] - Coefficients[start + (N - 2) * stride]) / (5.0f - ratios[min(N - 2, 15)]);
+
+	// Back substitution
+	for (int n = N - 2; n >= 0; n--)
+	{
+		Coefficients[start + n * stride] -= ratios[min(n, 15)] * Coefficients[start + (n + 1) * stride];
+	}
+}
+
+__kernel void BSplinePrefilterX(__global float* Coefficients,
+	                            __private int DATA_W,
+	                            __private int DATA_H,
+	                            __private int DATA_D)
+{
+	int y = get_global_id(0);
+	int z = get_global_id(1);
+
+	if (y >= DATA_H || z >= DATA_D)
+		return;
+
+	BSplinePrefilterLine(Coefficients, Calculate3DIndex(0,y,z,DATA_W,DATA_H), 1, DATA_W);
+}
+
+__kernel void BSplinePrefilterY(__global float* Coefficients,
+	                            __private int DATA_W,
+	                            __private int DATA_H,
+	                            __private int DATA_D)
+{
+	int x = get_global_id(0);
+	int z = get_global_id(1);
+
+	if (x >= DATA_W || z >= DATA_D)
+		return;
+
+	BSplinePrefilterLine(Coefficients, Calculate3DIndex(x,0,z,DATA_W,DATA_H), DATA_W, DATA_H);
+}
+
+__kernel void BSplinePrefilterZ(__global float* Coefficients,
+	                            __private int DATA_W,
+	                            __private int DATA_H,
+	                            __private int DATA_D)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+
+	if (x >= DATA_W || y >= DATA_H)
+		return;
+
+	BSplinePrefilterLine(Coefficients, Calculate3DIndex(x,y,0,DATA_W,DATA_H), DATA_W * DATA_H, DATA_D);
+}
 
 __kernel void InterpolateVolumeCubicLinear(__global float* Volume,
 	                                           read_only image3d_t Original_Volume, 
@@ -1221,44 +1329,15 @@ __kernel void InterpolateVolumeCubicLinear(__global float* Volume,
 	Motion_Vector.y = y + c_Parameter_Vector[1] + c_Parameter_Vector[6] * xf + c_Parameter_Vector[7]   * yf + c_Parameter_Vector[8]  * zf + 0.5f;
 	Motion_Vector.z = z + c_Parameter_Vector[2] + c_Parameter_Vector[9] * xf + c_Parameter_Vector[10]  * yf + c_Parameter_Vector[11] * zf + 0.5f;	
 	
-
-	const float3 coord_grid = Motion_Vector - 0.5f;
-	float3 index = floor(coord_grid);
-	const float3 fraction = coord_grid - index;
-	index = index + 0.5f;  //move from [-0.5, extent-0.5] to [0, extent]
-
-	float result;
-	
-	for (float z=-1.0f; z < 2.5f; z += 1.0f)  //range [-1, 2]
-	{
-		float bsplineZ = bspline(z-fraction.z);
-		float w = index.z + z;
-		for (float y=-1.0f; y < 2.5f; y += 1.0f)
-		{
-			float bsplineYZ = bspline(y-fraction.y) * bsplineZ;
-			float v = index.y + y;
-			for (float x=-1.0f; x < 2.5f; x += 1.0f)
-			{
-				float bsplineXYZ = bspline(x-fraction.x) * bsplineYZ;
-				float u = index.x + x;
-				float4 vector;
-				vector.x = u;
-				vector.y = v;
-				vector.z = w;
-				vector.w = 0.0f;
-				float4 temp = read_imagef(Original_Volume, volume_sampler_linear, vector);
-				result += temp.x * bsplineXYZ;
-			}
-		}
-	}
-	
-	Volume[idx] = result;
+	Volume[idx] = InterpolateCubicBSpline(Original_Volume, Motion_Vector);
 }
 
 
 __kernel void InterpolateVolumeCubicNonLinear(__global float* Volume,
 	                                              read_only image3d_t Original_Volume, 
-												  __global const float* d_Displacement_Field, 
+												  __global const float* d_Displacement_Field_X, 
+												  __global const float* d_Displacement_Field_Y, 
+												  __global const float* d_Displacement_Field_Z, 
 												  __private int DATA_W, 
 												  __private int DATA_H, 
 												  __private int DATA_D, 
@@ -1271,42 +1350,122 @@ __kernel void InterpolateVolumeCubicNonLinear(__global float* Volume,
 	if (x >= DATA_W || y >= DATA_H || z >= DATA_D)
 		return;
 
-	int idx = Calculate4DIndex(x,y,z,VOLUME,DATA_W,DATA_H,DATA_D);
+	int idx4D = Calculate4DIndex(x,y,z,VOLUME,DATA_W,DATA_H,DATA_D);
+	int idx3D = Calculate3DIndex(x,y,z,DATA_W,DATA_H);
+
 	float3 Motion_Vector;
 
+	Motion_Vector.x = (float)x + d_Displacement_Field_X[idx3D] + 0.5f;
+	Motion_Vector.y = (float)y + d_Displacement_Field_Y[idx3D] + 0.5f;
+	Motion_Vector.z = (float)z + d_Displacement_Field_Z[idx3D] + 0.5f;
+
+	Volume[idx4D] = InterpolateCubicBSpline(Original_Volume, Motion_Vector);
+}
 
+// Windowed sinc (Lanczos, 3 lobes) interpolation for final resampling of output volumes,
+// operates on the raw samples (no prefiltering) and normalizes the weights to preserve the mean
+
+float lanczos3(float t)
+{
+	t = fabs(t);
+
+	if (t < 0.0001f) return 1.0f;
+	else if (t < 3.0f) return 3.0f * sin(M_PI_F * t) * sin(M_PI_F * t / 3.0f) / (M_PI_F * M_PI_F * t * t);
+	else return 0.0f;
+}
 
-	const float3 coord_grid = Motion_Vector - 0.5f;
-	float3 index = floor(coord_grid);
+float InterpolateSinc(read_only image3d_t Original_Volume, float3 Position)
+{
+	const float3 coord_grid = Position - 0.5f;
+	const float3 index = floor(coord_grid);
 	const float3 fraction = coord_grid - index;
-	index = index + 0.5f;  //move from [-0.5, extent-0.5] to [0, extent]
 
-	float result;
-	
-	for (float z=-1.0f; z < 2.5f; z += 1.0f)  //range [-1, 2]
+	float wx[6], wy[6], wz[6];
+	for (int i = 0; i < 6; i++)
 	{
-		float bsplineZ = bspline(z-fraction.z);
-		float w = index.z + z;
-		for (float y=-1.0f; y < 2.5f; y += 1.0f)
+		wx[i] = lanczos3((float)(i - 2) - fraction.x);
+		wy[i] = lanczos3((float)(i - 2) - fraction.y);
+		wz[i] = lanczos3((float)(i - 2) - fraction.z);
+	}
+
+	float result = 0.0f;
+	float weight_sum = 0.0f;
+
+	for (int zz = 0; zz < 6; zz++)
+	{
+		for (int yy = 0; yy < 6; yy++)
 		{
-			float bsplineYZ = bspline(y-fraction.y) * bsplineZ;
-			float v = index.y + y;
-			for (float x=-1.0f; x < 2.5f; x += 1.0f)
+			float wyz = wy[yy] * wz[zz];
+			for (int xx = 0; xx < 6; xx++)
 			{
-				float bsplineXYZ = bspline(x-fraction.x) * bsplineYZ;
-				float u = index.x + x;
-				float4 vector;
-				vector.x = u;
-				vector.y = v;
-				vector.z = w;
-				vector.w = 0.0f;
-				float4 temp = read_imagef(Original_Volume, volume_sampler_linear, vector);
-				result += temp.x * bsplineXYZ;
+				float w = wx[xx] * wyz;
+				float4 vector = (float4)(index.x + (float)(xx - 2) + 0.5f, index.y + (float)(yy - 2) + 0.5f, index.z + (float)(zz - 2) + 0.5f, 0.0f);
+				result += w * read_imagef(Original_Volume, volume_sampler_nearest, vector).x;
+				weight_sum += w;
 			}
 		}
 	}
-	
-	Volume[idx] = result;
+
+	return result / weight_sum;
+}
+
+__kernel void InterpolateVolumeSincLinear(__global float* Volume,
+	                                      read_only image3d_t Original_Volume,
+	                                      __constant float* c_Parameter_Vector,
+	                                      __private int DATA_W,
+	                                      __private int DATA_H,
+	                                      __private int DATA_D,
+	                                      __private int VOLUME)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if (x >= DATA_W || y >= DATA_H || z >= DATA_D)
+		return;
+
+	int idx = Calculate4DIndex(x,y,z,VOLUME,DATA_W,DATA_H,DATA_D);
+	float3 Motion_Vector;
+	float xf, yf, zf;
+
+	xf = (float)x - ((float)DATA_W - 1.0f) * 0.5f;
+	yf = (float)y - ((float)DATA_H - 1.0f) * 0.5f;
+	zf = (float)z - ((float)DATA_D - 1.0f) * 0.5f;
+
+	Motion_Vector.x = x + c_Parameter_Vector[0] + c_Parameter_Vector[3] * xf + c_Parameter_Vector[4]   * yf + c_Parameter_Vector[5]  * zf + 0.5f;
+	Motion_Vector.y = y + c_Parameter_Vector[1] + c_Parameter_Vector[6] * xf + c_Parameter_Vector[7]   * yf + c_Parameter_Vector[8]  * zf + 0.5f;
+	Motion_Vector.z = z + c_Parameter_Vector[2] + c_Parameter_Vector[9] * xf + c_Parameter_Vector[10]  * yf + c_Parameter_Vector[11] * zf + 0.5f;
+
+	Volume[idx] = InterpolateSinc(Original_Volume, Motion_Vector);
+}
+
+__kernel void InterpolateVolumeSincNonLinear(__global float* Volume,
+	                                         read_only image3d_t Original_Volume,
+	                                         __global const float* d_Displacement_Field_X,
+	                                         __global const float* d_Displacement_Field_Y,
+	                                         __global const float* d_Displacement_Field_Z,
+	                                         __private int DATA_W,
+	                                         __private int DATA_H,
+	                                         __private int DATA_D,
+	                                         __private int VOLUME)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if (x >= DATA_W || y >= DATA_H || z >= DATA_D)
+		return;
+
+	int idx4D = Calculate4DIndex(x,y,z,VOLUME,DATA_W,DATA_H,DATA_D);
+	int idx3D = Calculate3DIndex(x,y,z,DATA_W,DATA_H);
+
+	float3 Motion_Vector;
+
+	Motion_Vector.x = (float)x + d_Displacement_Field_X[idx3D] + 0.5f;
+	Motion_Vector.y = (float)y + d_Displacement_Field_Y[idx3D] + 0.5f;
+	Motion_Vector.z = (float)z + d_Displacement_Field_Z[idx3D] + 0.5f;
+
+	Volume[idx4D] = InterpolateSinc(Original_Volume, Motion_Vector);
 }
 
 __kernel void RescaleVolumeNearest(__global float* Volume,
@@ -1388,37 +1547,7 @@ __kernel void RescaleVolumeCubic(__global float* Volume,
 	Motion_Vector.y = y * VOXEL_DIFFERENCE_Y + 0.5f;
 	Motion_Vector.z = z * VOXEL_DIFFERENCE_Z + 0.5f;
 	
-	const float3 coord_grid = Motion_Vector - 0.5f;
-	float3 index = floor(coord_grid);
-	const float3 fraction = coord_grid - index;
-	index = index + 0.5f;  //move from [-0.5, extent-0.5] to [0, extent]
-
-	float result;
-
-	for (float z=-1.0f; z < 2.5f; z += 1.0f)  //range [-1, 2]
-	{
-		float bsplineZ = bspline(z-fraction.z);
-		float w = index.z + z;
-		for (float y=-1.0f; y < 2.5f; y += 1.0f)
-		{
-			float bsplineYZ = bspline(y-fraction.y) * bsplineZ;
-			float v = index.y + y;
-			for (float x=-1.0f; x < 2.5f; x += 1.0f)
-			{
-				float bsplineXYZ = bspline(x-fraction.x) * bsplineYZ;
-				float u = index.x + x;
-				float4 vector;
-				vector.x = u;
-				vector.y = v;
-				vector.z = w;
-				vector.w = 0.0f;
-				float4 temp = read_imagef(Original_Volume, volume_sampler_linear, vector);
-				result += bsplineXYZ * temp.x;
-			}
-		}
-	}
-	
-	Volume[idx] = result;
+	Volume[idx] = InterpolateCubicBSpline(Original_Volume, Motion_Vector);
 }
 
 
@@ -1676,3 +1805,454 @@ __kernel void CopyVolumeToNew(__global float* New_Volume,
 
 
 
+float3 ApplyAffineTransformation(float3 Position,
+                                 __constant float* c_Parameter_Vector,
+                                 int DATA_W,
+                                 int DATA_H,
+                                 int DATA_D)
+{
+	float3 Transformed_Position;
+	float xf, yf, zf;
+
+	// Change to coordinate system with origo in (sx - 1)/2 (sy - 1)/2 (sz - 1)/2
+	xf = Position.x - ((float)DATA_W - 1.0f) * 0.5f;
+	yf = Position.y - ((float)DATA_H - 1.0f) * 0.5f;
+	zf = Position.z - ((float)DATA_D - 1.0f) * 0.5f;
+
+	Transformed_Position.x = Position.x + c_Parameter_Vector[0] + c_Parameter_Vector[3] * xf + c_Parameter_Vector[4]   * yf + c_Parameter_Vector[5]  * zf;
+	Transformed_Position.y = Position.y + c_Parameter_Vector[1] + c_Parameter_Vector[6] * xf + c_Parameter_Vector[7]   * yf + c_Parameter_Vector[8]  * zf;
+	Transformed_Position.z = Position.z + c_Parameter_Vector[2] + c_Parameter_Vector[9] * xf + c_Parameter_Vector[10]  * yf + c_Parameter_Vector[11] * zf;
+
+	return Transformed_Position;
+}
+
+// Calculates, for every voxel in the new (MNI) volume, where to sample the original (EPI) volume
+// The chain is the same as TransformVolumesLinear (EPI start), ChangeVolumesResolutionAndSize, 
+// TransformVolumesLinear (EPI-T1 start), TransformVolumesLinear (EPI-MNI) and TransformVolumesNonLinear,
+// c_Parameter_Vectors contains the three parameter vectors in the order EPI start, EPI-T1 start, EPI-MNI
+// Voxels that fall outside the resized volume are marked with a sampling position of -100000
+__kernel void CalculateComposedSamplingMap(__global float* d_Sampling_Map_X,
+		                                   __global float* d_Sampling_Map_Y,
+		                                   __global float* d_Sampling_Map_Z,
+		                                   __global const float* d_Displacement_Field_X,
+		                                   __global const float* d_Displacement_Field_Y,
+		                                   __global const float* d_Displacement_Field_Z,
+		                                   __constant float* c_Parameter_Vectors,
+		                                   __private int NEW_DATA_W,
+		                                   __private int NEW_DATA_H,
+		                                   __private int NEW_DATA_D,
+		                                   __private int DATA_W,
+		                                   __private int DATA_H,
+		                                   __private int DATA_D,
+		                                   __private int DATA_W_INTERPOLATED,
+		                                   __private int DATA_H_INTERPOLATED,
+		                                   __private int DATA_D_INTERPOLATED,
+		                                   __private float VOXEL_DIFFERENCE_X,
+		                                   __private float VOXEL_DIFFERENCE_Y,
+		                                   __private float VOXEL_DIFFERENCE_Z,
+		                                   __private int x_diff,
+		                                   __private int y_diff,
+		                                   __private int z_diff,
+		                                   __private int MM_Z_CUT,
+		                                   __private float NEW_VOXEL_SIZE_Z,
+		                                   __private int USE_DISPLACEMENT_FIELD)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if ((x >= NEW_DATA_W) || (y >= NEW_DATA_H) || (z >= NEW_DATA_D))
+		return;
+
+	int idx = Calculate3DIndex(x,y,z,NEW_DATA_W,NEW_DATA_H);
+
+	float3 Position;
+	Position.x = (float)x;
+	Position.y = (float)y;
+	Position.z = (float)z;
+
+	// Non-linear transformation
+	if (USE_DISPLACEMENT_FIELD == 1)
+	{
+		Position.x += d_Displacement_Field_X[idx];
+		Position.y += d_Displacement_Field_Y[idx];
+		Position.z += d_Displacement_Field_Z[idx];
+	}
+
+	// EPI-MNI transformation, and the translation applied before the EPI-T1 registration
+	Position = ApplyAffineTransformation(Position, &c_Parameter_Vectors[24], NEW_DATA_W, NEW_DATA_H, NEW_DATA_D);
+	Position = ApplyAffineTransformation(Position, &c_Parameter_Vectors[12], NEW_DATA_W, NEW_DATA_H, NEW_DATA_D);
+
+	// Same offsets as in CopyVolumeToNew
+	float3 Offset;
+	Offset.x = (x_diff > 0) ? round((float)x_diff/2.0f) : -round((float)abs(x_diff)/2.0f);
+	Offset.y = (y_diff > 0) ? round((float)y_diff/2.0f) : -round((float)abs(y_diff)/2.0f);
+	Offset.z = (z_diff > 0) ? round((float)z_diff/2.0f) : -round((float)abs(z_diff)/2.0f);
+	Offset.z += round((float)MM_Z_CUT/NEW_VOXEL_SIZE_Z);
+
+	// Check if the position is outside the part of the new volume that is covered by the resized volume
+	float3 Interpolated_Position = Position + Offset;
+	if ( (Position.x < -0.5f) || (Position.y < -0.5f) || (Position.z < -0.5f) || (Position.x > ((float)NEW_DATA_W - 0.5f)) || (Position.y > ((float)NEW_DATA_H - 0.5f)) || (Position.z > ((float)NEW_DATA_D - 0.5f)) ||
+	     (Interpolated_Position.x < -0.5f) || (Interpolated_Position.y < -0.5f) || (Interpolated_Position.z < -0.5f) || (Interpolated_Position.x > ((float)DATA_W_INTERPOLATED - 0.5f)) || (Interpolated_Position.y > ((float)DATA_H_INTERPOLATED - 0.5f)) || (Interpolated_Position.z > ((float)DATA_D_INTERPOLATED - 0.5f)) )
+	{
+		d_Sampling_Map_X[idx] = -100000.0f;
+		d_Sampling_Map_Y[idx] = -100000.0f;
+		d_Sampling_Map_Z[idx] = -100000.0f;
+		return;
+	}
+
+	// Change resolution
+	Position.x = Interpolated_Position.x * VOXEL_DIFFERENCE_X;
+	Position.y = Interpolated_Position.y * VOXEL_DIFFERENCE_Y;
+	Position.z = Interpolated_Position.z * VOXEL_DIFFERENCE_Z;
+
+	// Initial translation of the original volume
+	Position = ApplyAffineTransformation(Position, &c_Parameter_Vectors[0], DATA_W, DATA_H, DATA_D);
+
+	d_Sampling_Map_X[idx] = Position.x;
+	d_Sampling_Map_Y[idx] = Position.y;
+	d_Sampling_Map_Z[idx] = Position.z;
+}
+
+__kernel void InterpolateVolumeNearestComposed(__global float* Volume,
+	                                           read_only image3d_t Original_Volume,
+	                                           __global const float* d_Sampling_Map_X,
+	                                           __global const float* d_Sampling_Map_Y,
+	                                           __global const float* d_Sampling_Map_Z,
+	                                           __private int DATA_W,
+	                                           __private int DATA_H,
+	                                           __private int DATA_D,
+	                                           __private int VOLUME)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if ((x >= DATA_W) || (y >= DATA_H) || (z >= DATA_D))
+		return;
+
+	int idx4D = Calculate4DIndex(x,y,z,VOLUME,DATA_W,DATA_H,DATA_D);
+	int idx3D = Calculate3DIndex(x,y,z,DATA_W,DATA_H);
+
+	float4 Motion_Vector;
+	Motion_Vector.x = d_Sampling_Map_X[idx3D];
+	Motion_Vector.y = d_Sampling_Map_Y[idx3D];
+	Motion_Vector.z = d_Sampling_Map_Z[idx3D];
+	Motion_Vector.w = 0.0f;
+
+	if (Motion_Vector.x < -50000.0f)
+	{
+		Volume[idx4D] = 0.0f;
+		return;
+	}
+
+	Motion_Vector.x += 0.5f;
+	Motion_Vector.y += 0.5f;
+	Motion_Vector.z += 0.5f;
+
+	float4 Interpolated_Value = read_imagef(Original_Volume, volume_sampler_nearest, Motion_Vector);
+	Volume[idx4D] = Interpolated_Value.x;
+}
+
+__kernel void InterpolateVolumeLinearComposed(__global float* Volume,
+	                                          read_only image3d_t Original_Volume,
+	                                          __global const float* d_Sampling_Map_X,
+	                                          __global const float* d_Sampling_Map_Y,
+	                                          __global const float* d_Sampling_Map_Z,
+	                                          __private int DATA_W,
+	                                          __private int DATA_H,
+	                                          __private int DATA_D,
+	                                          __private int VOLUME)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if ((x >= DATA_W) || (y >= DATA_H) || (z >= DATA_D))
+		return;
+
+	int idx4D = Calculate4DIndex(x,y,z,VOLUME,DATA_W,DATA_H,DATA_D);
+	int idx3D = Calculate3DIndex(x,y,z,DATA_W,DATA_H);
+
+	float4 Motion_Vector;
+	Motion_Vector.x = d_Sampling_Map_X[idx3D];
+	Motion_Vector.y = d_Sampling_Map_Y[idx3D];
+	Motion_Vector.z = d_Sampling_Map_Z[idx3D];
+	Motion_Vector.w = 0.0f;
+
+	if (Motion_Vector.x < -50000.0f)
+	{
+		Volume[idx4D] = 0.0f;
+		return;
+	}
+
+	Motion_Vector.x += 0.5f;
+	Motion_Vector.y += 0.5f;
+	Motion_Vector.z += 0.5f;
+
+	float4 Interpolated_Value = read_imagef(Original_Volume, volume_sampler_linear, Motion_Vector);
+	Volume[idx4D] = Interpolated_Value.x;
+}
+
+__kernel void InterpolateVolumeCubicComposed(__global float* Volume,
+	                                         read_only image3d_t Original_Volume,
+	                                         __global const float* d_Sampling_Map_X,
+	                                         __global const float* d_Sampling_Map_Y,
+	                                         __global const float* d_Sampling_Map_Z,
+	                                         __private int DATA_W,
+	                                         __private int DATA_H,
+	                                         __private int DATA_D,
+	                                         __private int VOLUME)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if ((x >= DATA_W) || (y >= DATA_H) || (z >= DATA_D))
+		return;
+
+	int idx4D = Calculate4DIndex(x,y,z,VOLUME,DATA_W,DATA_H,DATA_D);
+	int idx3D = Calculate3DIndex(x,y,z,DATA_W,DATA_H);
+
+	float3 coord_grid;
+	coord_grid.x = d_Sampling_Map_X[idx3D];
+	coord_grid.y = d_Sampling_Map_Y[idx3D];
+	coord_grid.z = d_Sampling_Map_Z[idx3D];
+
+	if (coord_grid.x < -50000.0f)
+	{
+		Volume[idx4D] = 0.0f;
+		return;
+	}
+
+	// Sampling map holds grid coordinates, move to texel coordinates
+	Volume[idx4D] = InterpolateCubicBSpline(Original_Volume, coord_grid + 0.5f);
+}
+
+__kernel void InterpolateVolumeSincComposed(__global float* Volume,
+	                                        read_only image3d_t Original_Volume,
+	                                        __global const float* d_Sampling_Map_X,
+	                                        __global const float* d_Sampling_Map_Y,
+	                                        __global const float* d_Sampling_Map_Z,
+	                                        __private int DATA_W,
+	                                        __private int DATA_H,
+	                                        __private int DATA_D,
+	                                        __private int VOLUME)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if ((x >= DATA_W) || (y >= DATA_H) || (z >= DATA_D))
+		return;
+
+	int idx4D = Calculate4DIndex(x,y,z,VOLUME,DATA_W,DATA_H,DATA_D);
+	int idx3D = Calculate3DIndex(x,y,z,DATA_W,DATA_H);
+
+	float3 coord_grid;
+	coord_grid.x = d_Sampling_Map_X[idx3D];
+	coord_grid.y = d_Sampling_Map_Y[idx3D];
+	coord_grid.z = d_Sampling_Map_Z[idx3D];
+
+	if (coord_grid.x < -50000.0f)
+	{
+		Volume[idx4D] = 0.0f;
+		return;
+	}
+
+	Volume[idx4D] = InterpolateSinc(Original_Volume, coord_grid + 0.5f);
+}
+
+
+
+
+// Kernels for linear registration with normalized mutual information
+
+// Continuous bin coordinate of a value, the histogram covers [min, max] of the statistics from CalculateVolumeStatistics
+float MutualInformationBin(float value, __global const float* Statistics, int NUMBER_OF_BINS)
+{
+	float range = Statistics[4] - Statistics[3];
+
+	if (range <= 0.0f)
+		return 0.0f;
+
+	float bin = (value - Statistics[3]) / range * (float)(NUMBER_OF_BINS - 1);
+	return clamp(bin, 0.0f, (float)(NUMBER_OF_BINS - 1) - 0.001f);
+}
+
+// Bilinear partial volume weights quantised to integers, the rounding error is moved to the largest weight such that
+// the four weights always sum to 64 (the largest weight is at least 16, so it can not become negative)
+void PartialVolumeWeights(uint* weights, float fr, float fa)
+{
+	weights[0] = (uint)(64.0f * (1.0f - fr) * (1.0f - fa) + 0.5f);
+	weights[1] = (uint)(64.0f * fr          * (1.0f - fa) + 0.5f);
+	weights[2] = (uint)(64.0f * (1.0f - fr) * fa          + 0.5f);
+	weights[3] = (uint)(64.0f * fr          * fa          + 0.5f);
+
+	int largest = 0;
+	for (int i = 1; i < 4; i++)
+	{
+		if (weights[i] > weights[largest])
+			largest = i;
+	}
+
+	weights[largest] = 64 - (weights[0] + weights[1] + weights[2] + weights[3] - weights[largest]);
+}
+
+// Joint histogram with partial volume (bilinear) weights, accumulated in local memory with integer atomics.
+// Every voxel adds 64 counts in total, Joint_Histogram[reference_bin + aligned_bin * NUMBER_OF_BINS]
+__kernel void CalculateJointHistogram(volatile __global unsigned int* Joint_Histogram,
+	                                  __global const float* Reference_Volume,
+									  __global const float* Aligned_Volume,
+									  __global const float* Reference_Statistics,
+									  __global const float* Aligned_Statistics,
+									  volatile __local unsigned int* l_Histogram,
+									  __private int NUMBER_OF_BINS,
+									  __private int DATA_W,
+									  __private int DATA_H,
+									  __private int DATA_D)
+{
+	int tid = get_local_id(0);
+	int localSize = get_local_size(0);
+	int N = DATA_W * DATA_H * DATA_D;
+
+	for (int bin = tid; bin < NUMBER_OF_BINS * NUMBER_OF_BINS; bin += localSize)
+	{
+		l_Histogram[bin] = 0;
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int i = get_global_id(0); i < N; i += get_global_size(0))
+	{
+		float r = MutualInformationBin(Reference_Volume[i], Reference_Statistics, NUMBER_OF_BINS);
+		float a = MutualInformationBin(Aligned_Volume[i], Aligned_Statistics, NUMBER_OF_BINS);
+
+		int r0 = (int)r;
+		int a0 = (int)a;
+		float fr = r - (float)r0;
+		float fa = a - (float)a0;
+
+		uint weights[4];
+		PartialVolumeWeights(weights, fr, fa);
+
+		atomic_add(&l_Histogram[r0     + a0       * NUMBER_OF_BINS], weights[0]);
+		atomic_add(&l_Histogram[r0 + 1 + a0       * NUMBER_OF_BINS], weights[1]);
+		atomic_add(&l_Histogram[r0     + (a0 + 1) * NUMBER_OF_BINS], weights[2]);
+		atomic_add(&l_Histogram[r0 + 1 + (a0 + 1) * NUMBER_OF_BINS], weights[3]);
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int bin = tid; bin < NUMBER_OF_BINS * NUMBER_OF_BINS; bin += localSize)
+	{
+		if (l_Histogram[bin] != 0)
+		{
+			atomic_add(&Joint_Histogram[bin], l_Histogram[bin]);
+		}
+	}
+}
+
+// Analytic gradient of the normalized mutual information with respect to an affine update of the aligned volume.
+// Histogram_Derivatives holds the derivative of the NMI with respect to every joint histogram entry (divided by the number of voxels),
+// every work group writes 12 partial sums, one per registration parameter
+__kernel void CalculateMutualInformationGradient(__global float* Partial_Gradients,
+	                                             __global const float* Reference_Volume,
+												 __global const float* Aligned_Volume,
+												 __global const float* Reference_Statistics,
+												 __global const float* Aligned_Statistics,
+												 __global const float* Histogram_Derivatives,
+												 __local float* l_Gradients,
+												 __private int NUMBER_OF_BINS,
+												 __private int DATA_W,
+												 __private int DATA_H,
+												 __private int DATA_D)
+{
+	int tid = get_local_id(0);
+	int localSize = get_local_size(0);
+	int N = DATA_W * DATA_H * DATA_D;
+
+	float range = Aligned_Statistics[4] - Aligned_Statistics[3];
+	float binScale = (range > 0.0f) ? (float)(NUMBER_OF_BINS - 1) / range : 0.0f;
+
+	float gradients[12];
+	for (int p = 0; p < 12; p++)
+	{
+		gradients[p] = 0.0f;
+	}
+
+	for (int i = get_global_id(0); i < N; i += get_global_size(0))
+	{
+		int x = i % DATA_W;
+		int y = (i / DATA_W) % DATA_H;
+		int z = i / (DATA_W * DATA_H);
+
+		float r = MutualInformationBin(Reference_Volume[i], Reference_Statistics, NUMBER_OF_BINS);
+		float a = MutualInformationBin(Aligned_Volume[i], Aligned_Statistics, NUMBER_OF_BINS);
+
+		// Voxels outside the histogram range are clamped to the first or last bin, a small change of their intensity does not change the histogram
+		if ((Aligned_Volume[i] < Aligned_Statistics[3]) || (Aligned_Volume[i] > Aligned_Statistics[4]))
+			continue;
+
+		int r0 = (int)r;
+		int a0 = (int)a;
+		float fr = r - (float)r0;
+
+		// Derivative of the NMI with respect to the aligned intensity, through the partial volume weights
+		float dNMI = (1.0f - fr) * (Histogram_Derivatives[r0     + (a0 + 1) * NUMBER_OF_BINS] - Histogram_Derivatives[r0     + a0 * NUMBER_OF_BINS])
+			       +         fr  * (Histogram_Derivatives[r0 + 1 + (a0 + 1) * NUMBER_OF_BINS] - Histogram_Derivatives[r0 + 1 + a0 * NUMBER_OF_BINS]);
+		dNMI *= binScale;
+
+		// Intensity gradient of the aligned volume, central differences
+		float gx = 0.5f * (Aligned_Volume[Calculate3DIndex(min(x + 1, DATA_W - 1),y,z,DATA_W,DATA_H)] - Aligned_Volume[Calculate3DIndex(max(x - 1, 0),y,z,DATA_W,DATA_H)]);
+		float gy = 0.5f * (Aligned_Volume[Calculate3DIndex(x,min(y + 1, DATA_H - 1),z,DATA_W,DATA_H)] - Aligned_Volume[Calculate3DIndex(x,max(y - 1, 0),z,DATA_W,DATA_H)]);
+		float gz = 0.5f * (Aligned_Volume[Calculate3DIndex(x,y,min(z + 1, DATA_D - 1),DATA_W,DATA_H)] - Aligned_Volume[Calculate3DIndex(x,y,max(z - 1, 0),DATA_W,DATA_H)]);
+
+		gx *= dNMI;
+		gy *= dNMI;
+		gz *= dNMI;
+
+		// Same coordinate system as in InterpolateVolumeLinearLinear
+		float xf = (float)x - ((float)DATA_W - 1.0f) * 0.5f;
+		float yf = (float)y - ((float)DATA_H - 1.0f) * 0.5f;
+		float zf = (float)z - ((float)DATA_D - 1.0f) * 0.5f;
+
+		gradients[0] += gx;
+		gradients[1] += gy;
+		gradients[2] += gz;
+		gradients[3] += gx * xf;
+		gradients[4] += gx * yf;
+		gradients[5] += gx * zf;
+		gradients[6] += gy * xf;
+		gradients[7] += gy * yf;
+		gradients[8] += gy * zf;
+		gradients[9] += gz * xf;
+		gradients[10] += gz * yf;
+		gradients[11] += gz * zf;
+	}
+
+	for (int p = 0; p < 12; p++)
+	{
+		l_Gradients[p * localSize + tid] = gradients[p];
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// The work group size is a power of two
+	for (int s = localSize / 2; s > 0; s >>= 1)
+	{
+		if (tid < s)
+		{
+			for (int p = 0; p < 12; p++)
+			{
+				l_Gradients[p * localSize + tid] += l_Gradients[p * localSize + tid + s];
+			}
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (tid == 0)
+	{
+		for (int p = 0; p < 12; p++)
+		{
+			Partial_Gradients[get_group_id(0) * 12 + p] = l_Gradients[p * localSize];
+		}
+	}
+}
@@ -366,17 +366,23 @@ __kernel void CalculateStatisticalMapSearchlight_(__global float* Classifier_Per
 
 
 
+// Perceptron searchlight for NUMBER_OF_LABELLINGS labellings of the volumes in one launch (Classes and d_Values contain one labelling after the other).
+// The performance of the first labelling is written to Classifier_Performance if WRITE_PERFORMANCE is set, and the maximum performance over voxels
+// of every labelling is saved in Max_Performance, as the bits of a float (the same way as CalculateStatisticalMapSearchlightLinear)
 __kernel void CalculateStatisticalMapSearchlight(__global float* Classifier_Performance,
                                                   __global const float* Volumes,
                                                   __global const float* Mask,
-                                                  __constant float* c_d,
-                                                  __constant float* c_Correct_Classes,
+                                                  __global const float* d_Values,
+                                                  __global const float* Classes,
                                                   __private int DATA_W,
                                                   __private int DATA_H,
                                                   __private int DATA_D,
                                                   __private int NUMBER_OF_VOLUMES,
                                                   __private float n,
-                                                  __private int EPOCS)
+                                                  __private int EPOCS,
+                                                  volatile __global int* Max_Performance,
+                                                  __private int NUMBER_OF_LABELLINGS,
+                                                  __private int WRITE_PERFORMANCE)
 
 {
     int x = get_global_id(0);
@@ -390,277 +396,300 @@ __kernel void CalculateStatisticalMapSearchlight(__global float* Classifier_Perf
     
     if ( Mask[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] != 1.0f )
     {
-        Classifier_Performance[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = 0.0f;
+        if (WRITE_PERFORMANCE)
+        {
+            Classifier_Performance[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = 0.0f;
+        }
         return;
     }
     
     if ( ((x + 1) >= DATA_W) || ((y + 1) >= DATA_H) || ((z + 1) >= DATA_D) )
     {
-        Classifier_Performance[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = 0.0f;
+        if (WRITE_PERFORMANCE)
+        {
+            Classifier_Performance[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = 0.0f;
+        }
         return;
     }
     
     
     if ( ((x - 1) < 0) || ((y - 1) < 0) || ((z - 1) < 0) )
     {
-        Classifier_Performance[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = 0.0f;
+        if (WRITE_PERFORMANCE)
+        {
+            Classifier_Performance[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = 0.0f;
+        }
         return;
     }
     
     
-    int classification_performance = 0;
+    // The labellings share the reads of the sphere through the cache
+    for (int b = 0; b < NUMBER_OF_LABELLINGS; b++)
+    {
+        __global const float* c_Correct_Classes = &Classes[b * NUMBER_OF_VOLUMES];
+        __global const float* c_d = &d_Values[b * NUMBER_OF_VOLUMES];
+
+        int classification_performance = 0;
     
-    float weights[20];
+        float weights[20];
 
-	int uncensoredVolumes = 0;
+		int uncensoredVolumes = 0;
 
-    // Leave one out cross validation
-    for (int validation = 0; validation < NUMBER_OF_VOLUMES; validation++)
-    {
-		// Skip testing with censored volumes
-        if (c_Correct_Classes[validation] == 9999.0f)
+        // Leave one out cross validation
+        for (int validation = 0; validation < NUMBER_OF_VOLUMES; validation++)
         {
-            continue;
-        } 
+			// Skip testing with censored volumes
+            if (c_Correct_Classes[validation] == 9999.0f)
+            {
+                continue;
+            } 
 
-		uncensoredVolumes++;
+			uncensoredVolumes++;
        
-        weights[0]  = 0.0f;
-        weights[1]  = 0.0f;
-        weights[2]  = 0.0f;
-        weights[3]  = 0.0f;
-        weights[4]  = 0.0f;
-        weights[5]  = 0.0f;
-        weights[6]  = 0.0f;
-        weights[7]  = 0.0f;
-        weights[8]  = 0.0f;
-        weights[9]  = 0.0f;
-        weights[10] = 0.0f;
-        weights[11] = 0.0f;
-        weights[12] = 0.0f;
-        weights[13] = 0.0f;
-        weights[14] = 0.0f;
-        weights[15] = 0.0f;
-        weights[16] = 0.0f;
-        weights[17] = 0.0f;
-        weights[18] = 0.0f;
-        weights[19] = 0.0f;
+            weights[0]  = 0.0f;
+            weights[1]  = 0.0f;
+            weights[2]  = 0.0f;
+            weights[3]  = 0.0f;
+            weights[4]  = 0.0f;
+            weights[5]  = 0.0f;
+            weights[6]  = 0.0f;
+            weights[7]  = 0.0f;
+            weights[8]  = 0.0f;
+            weights[9]  = 0.0f;
+            weights[10] = 0.0f;
+            weights[11] = 0.0f;
+            weights[12] = 0.0f;
+            weights[13] = 0.0f;
+            weights[14] = 0.0f;
+            weights[15] = 0.0f;
+            weights[16] = 0.0f;
+            weights[17] = 0.0f;
+            weights[18] = 0.0f;
+            weights[19] = 0.0f;
         
-        // Do training for a number of iterations
-        for (int epoc = 0; epoc < EPOCS; epoc++)
-        {
-            float gradient[20];
+            // Do training for a number of iterations
+            for (int epoc = 0; epoc < EPOCS; epoc++)
+            {
+                float gradient[20];
             
-            gradient[0] = 0.0f;
-            gradient[1] = 0.0f;
-            gradient[2] = 0.0f;
-            gradient[3] = 0.0f;
-            gradient[4] = 0.0f;
-            gradient[5] = 0.0f;
-            gradient[6] = 0.0f;
-            gradient[7] = 0.0f;
-            gradient[8] = 0.0f;
-            gradient[9] = 0.0f;
-            gradient[10] = 0.0f;
-            gradient[11] = 0.0f;
-            gradient[12] = 0.0f;
-            gradient[13] = 0.0f;
-            gradient[14] = 0.0f;
-            gradient[15] = 0.0f;
-            gradient[16] = 0.0f;
-            gradient[17] = 0.0f;
-            gradient[18] = 0.0f;
-            gradient[19] = 0.0f;
+                gradient[0] = 0.0f;
+                gradient[1] = 0.0f;
+                gradient[2] = 0.0f;
+                gradient[3] = 0.0f;
+                gradient[4] = 0.0f;
+                gradient[5] = 0.0f;
+                gradient[6] = 0.0f;
+                gradient[7] = 0.0f;
+                gradient[8] = 0.0f;
+                gradient[9] = 0.0f;
+                gradient[10] = 0.0f;
+                gradient[11] = 0.0f;
+                gradient[12] = 0.0f;
+                gradient[13] = 0.0f;
+                gradient[14] = 0.0f;
+                gradient[15] = 0.0f;
+                gradient[16] = 0.0f;
+                gradient[17] = 0.0f;
+                gradient[18] = 0.0f;
+                gradient[19] = 0.0f;
             
-            for (int t = 0; t < NUMBER_OF_VOLUMES; t++)
-            {
-                // Skip training with validation volume and censored volumes
-                if ((t == validation) || (c_Correct_Classes[t] == 9999.0f))
+                for (int t = 0; t < NUMBER_OF_VOLUMES; t++)
                 {
-                    continue;
-                }                                
+                    // Skip training with validation volume and censored volumes
+                    if ((t == validation) || (c_Correct_Classes[t] == 9999.0f))
+                    {
+                        continue;
+                    }                                
                 
-                // Make classification
-                float s;
-                s =  weights[0] * 1.0f;
+                    // Make classification
+                    float s;
+                    s =  weights[0] * 1.0f;
                 
-                float x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15, x16, x17, x18, x19;
-                
-                x1 = Volumes[Calculate4DIndex(x-1,y,z-1,t,DATA_W,DATA_H,DATA_D)];
-                x2 = Volumes[Calculate4DIndex(x,y-1,z-1,t,DATA_W,DATA_H,DATA_D)];
-                x3 = Volumes[Calculate4DIndex(x,y,z-1,t,DATA_W,DATA_H,DATA_D)];
-                x4 = Volumes[Calculate4DIndex(x,y+1,z-1,t,DATA_W,DATA_H,DATA_D)];
-                x5 = Volumes[Calculate4DIndex(x+1,y,z-1,t,DATA_W,DATA_H,DATA_D)];
-                
-                x6 = Volumes[Calculate4DIndex(x-1,y-1,z,t,DATA_W,DATA_H,DATA_D)];
-                x7 = Volumes[Calculate4DIndex(x-1,y,z,t,DATA_W,DATA_H,DATA_D)];
-                x8 = Volumes[Calculate4DIndex(x-1,y+1,z,t,DATA_W,DATA_H,DATA_D)];
-                x9 = Volumes[Calculate4DIndex(x,y-1,z,t,DATA_W,DATA_H,DATA_D)];
-                x10 = Volumes[Calculate4DIndex(x,y,z,t,DATA_W,DATA_H,DATA_D)];
-                x11 = Volumes[Calculate4DIndex(x,y+1,z,t,DATA_W,DATA_H,DATA_D)];
-                x12 = Volumes[Calculate4DIndex(x+1,y-1,z,t,DATA_W,DATA_H,DATA_D)];
-                x13 = Volumes[Calculate4DIndex(x+1,y,z,t,DATA_W,DATA_H,DATA_D)];
-                x14 = Volumes[Calculate4DIndex(x+1,y+1,z,t,DATA_W,DATA_H,DATA_D)];
-                
-                x15 = Volumes[Calculate4DIndex(x-1,y,z+1,t,DATA_W,DATA_H,DATA_D)];
-                x16 = Volumes[Calculate4DIndex(x,y-1,z+1,t,DATA_W,DATA_H,DATA_D)];
-                x17 = Volumes[Calculate4DIndex(x,y,z+1,t,DATA_W,DATA_H,DATA_D)];
-                x18 = Volumes[Calculate4DIndex(x,y+1,z+1,t,DATA_W,DATA_H,DATA_D)];
-                x19 = Volumes[Calculate4DIndex(x+1,y,z+1,t,DATA_W,DATA_H,DATA_D)];
+                    float x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15, x16, x17, x18, x19;
                 
-                // z - 1
-                s += weights[1] * x1;
-                s += weights[2] * x2;
-                s += weights[3] * x3;
-                s += weights[4] * x4;
-                s += weights[5] * x5;
+                    x1 = Volumes[Calculate4DIndex(x-1,y,z-1,t,DATA_W,DATA_H,DATA_D)];
+                    x2 = Volumes[Calculate4DIndex(x,y-1,z-1,t,DATA_W,DATA_H,DATA_D)];
+                    x3 = Volumes[Calculate4DIndex(x,y,z-1,t,DATA_W,DATA_H,DATA_D)];
+                    x4 = Volumes[Calculate4DIndex(x,y+1,z-1,t,DATA_W,DATA_H,DATA_D)];
+                    x5 = Volumes[Calculate4DIndex(x+1,y,z-1,t,DATA_W,DATA_H,DATA_D)];
                 
-                // z
-                s += weights[6] * x6;
-                s += weights[7] * x7;
-                s += weights[8] * x8;
-                s += weights[9] * x9;
-                s += weights[10] * x10;
-                s += weights[11] * x11;
-                s += weights[12] * x12;
-                s += weights[13] * x13;
-                s += weights[14] * x14;
+                    x6 = Volumes[Calculate4DIndex(x-1,y-1,z,t,DATA_W,DATA_H,DATA_D)];
+                    x7 = Volumes[Calculate4DIndex(x-1,y,z,t,DATA_W,DATA_H,DATA_D)];
+                    x8 = Volumes[Calculate4DIndex(x-1,y+1,z,t,DATA_W,DATA_H,DATA_D)];
+                    x9 = Volumes[Calculate4DIndex(x,y-1,z,t,DATA_W,DATA_H,DATA_D)];
+                    x10 = Volumes[Calculate4DIndex(x,y,z,t,DATA_W,DATA_H,DATA_D)];
+                    x11 = Volumes[Calculate4DIndex(x,y+1,z,t,DATA_W,DATA_H,DATA_D)];
+                    x12 = Volumes[Calculate4DIndex(x+1,y-1,z,t,DATA_W,DATA_H,DATA_D)];
+                    x13 = Volumes[Calculate4DIndex(x+1,y,z,t,DATA_W,DATA_H,DATA_D)];
+                    x14 = Volumes[Calculate4DIndex(x+1,y+1,z,t,DATA_W,DATA_H,DATA_D)];
                 
-                // z + 1
-                s += weights[15] * x15;
-                s += weights[16] * x16;
-                s += weights[17] * x17;
-                s += weights[18] * x18;
-                s += weights[19] * x19;
+                    x15 = Volumes[Calculate4DIndex(x-1,y,z+1,t,DATA_W,DATA_H,DATA_D)];
+                    x16 = Volumes[Calculate4DIndex(x,y-1,z+1,t,DATA_W,DATA_H,DATA_D)];
+                    x17 = Volumes[Calculate4DIndex(x,y,z+1,t,DATA_W,DATA_H,DATA_D)];
+                    x18 = Volumes[Calculate4DIndex(x,y+1,z+1,t,DATA_W,DATA_H,DATA_D)];
+                    x19 = Volumes[Calculate4DIndex(x+1,y,z+1,t,DATA_W,DATA_H,DATA_D)];
                 
-                // Calculate contribution to gradient
-                gradient[0] += (s - c_d[t]) * 1.0f;
+                    // z - 1
+                    s += weights[1] * x1;
+                    s += weights[2] * x2;
+                    s += weights[3] * x3;
+                    s += weights[4] * x4;
+                    s += weights[5] * x5;
                 
-                // z - 1
-                gradient[1]  += (s - c_d[t]) * x1;
-                gradient[2]  += (s - c_d[t]) * x2;
-                gradient[3]  += (s - c_d[t]) * x3;
-                gradient[4]  += (s - c_d[t]) * x4;
-                gradient[5]  += (s - c_d[t]) * x5;
+                    // z
+                    s += weights[6] * x6;
+                    s += weights[7] * x7;
+                    s += weights[8] * x8;
+                    s += weights[9] * x9;
+                    s += weights[10] * x10;
+                    s += weights[11] * x11;
+                    s += weights[12] * x12;
+                    s += weights[13] * x13;
+                    s += weights[14] * x14;
                 
-                // z
-                gradient[6]  += (s - c_d[t]) * x6;
-                gradient[7]  += (s - c_d[t]) * x7;
-                gradient[8]  += (s - c_d[t]) * x8;
-                gradient[9]  += (s - c_d[t]) * x9;
-                gradient[10] += (s - c_d[t]) * x10;
-                gradient[11] += (s - c_d[t]) * x11;
-                gradient[12] += (s - c_d[t]) * x12;
-                gradient[13] += (s - c_d[t]) * x13;
-                gradient[14] += (s - c_d[t]) * x14;
+                    // z + 1
+                    s += weights[15] * x15;
+                    s += weights[16] * x16;
+                    s += weights[17] * x17;
+                    s += weights[18] * x18;
+                    s += weights[19] * x19;
                 
-                // z + 1
-                gradient[15] += (s - c_d[t]) * x15;
-                gradient[16] += (s - c_d[t]) * x16;
-                gradient[17] += (s - c_d[t]) * x17;
-                gradient[18] += (s - c_d[t]) * x18;
-                gradient[19] += (s - c_d[t]) * x19;
+                    // Calculate contribution to gradient
+                    gradient[0] += (s - c_d[t]) * 1.0f;
                 
-                // end for t
-            }
+                    // z - 1
+                    gradient[1]  += (s - c_d[t]) * x1;
+                    gradient[2]  += (s - c_d[t]) * x2;
+                    gradient[3]  += (s - c_d[t]) * x3;
+                    gradient[4]  += (s - c_d[t]) * x4;
+                    gradient[5]  += (s - c_d[t]) * x5;
+                
+                    // z
+                    gradient[6]  += (s - c_d[t]) * x6;
+                    gradient[7]  += (s - c_d[t]) * x7;
+                    gradient[8]  += (s - c_d[t]) * x8;
+                    gradient[9]  += (s - c_d[t]) * x9;
+                    gradient[10] += (s - c_d[t]) * x10;
+                    gradient[11] += (s - c_d[t]) * x11;
+                    gradient[12] += (s - c_d[t]) * x12;
+                    gradient[13] += (s - c_d[t]) * x13;
+                    gradient[14] += (s - c_d[t]) * x14;
+                
+                    // z + 1
+                    gradient[15] += (s - c_d[t]) * x15;
+                    gradient[16] += (s - c_d[t]) * x16;
+                    gradient[17] += (s - c_d[t]) * x17;
+                    gradient[18] += (s - c_d[t]) * x18;
+                    gradient[19] += (s - c_d[t]) * x19;
+                
+                    // end for t
+                }
             
-            // Update weights
-            weights[0] -= n/(float)NUMBER_OF_VOLUMES * gradient[0];
-            weights[1] -= n/(float)NUMBER_OF_VOLUMES * gradient[1];
-            weights[2] -= n/(float)NUMBER_OF_VOLUMES * gradient[2];
-            weights[3] -= n/(float)NUMBER_OF_VOLUMES * gradient[3];
-            weights[4] -= n/(float)NUMBER_OF_VOLUMES * gradient[4];
-            weights[5] -= n/(float)NUMBER_OF_VOLUMES * gradient[5];
-            weights[6] -= n/(float)NUMBER_OF_VOLUMES * gradient[6];
-            weights[7] -= n/(float)NUMBER_OF_VOLUMES * gradient[7];
-            weights[8] -= n/(float)NUMBER_OF_VOLUMES * gradient[8];
-            weights[9] -= n/(float)NUMBER_OF_VOLUMES * gradient[9];
-            weights[10] -= n/(float)NUMBER_OF_VOLUMES * gradient[10];
-            weights[11] -= n/(float)NUMBER_OF_VOLUMES * gradient[11];
-            weights[12] -= n/(float)NUMBER_OF_VOLUMES * gradient[12];
-            weights[13] -= n/(float)NUMBER_OF_VOLUMES * gradient[13];
-            weights[14] -= n/(float)NUMBER_OF_VOLUMES * gradient[14];
-            weights[15] -= n/(float)NUMBER_OF_VOLUMES * gradient[15];
-            weights[16] -= n/(float)NUMBER_OF_VOLUMES * gradient[16];
-            weights[17] -= n/(float)NUMBER_OF_VOLUMES * gradient[17];
-            weights[18] -= n/(float)NUMBER_OF_VOLUMES * gradient[18];
-            weights[19] -= n/(float)NUMBER_OF_VOLUMES * gradient[19];
+                // Update weights
+                weights[0] -= n/(float)NUMBER_OF_VOLUMES * gradient[0];
+                weights[1] -= n/(float)NUMBER_OF_VOLUMES * gradient[1];
+                weights[2] -= n/(float)NUMBER_OF_VOLUMES * gradient[2];
+                weights[3] -= n/(float)NUMBER_OF_VOLUMES * gradient[3];
+                weights[4] -= n/(float)NUMBER_OF_VOLUMES * gradient[4];
+                weights[5] -= n/(float)NUMBER_OF_VOLUMES * gradient[5];
+                weights[6] -= n/(float)NUMBER_OF_VOLUMES * gradient[6];
+                weights[7] -= n/(float)NUMBER_OF_VOLUMES * gradient[7];
+                weights[8] -= n/(float)NUMBER_OF_VOLUMES * gradient[8];
+                weights[9] -= n/(float)NUMBER_OF_VOLUMES * gradient[9];
+                weights[10] -= n/(float)NUMBER_OF_VOLUMES * gradient[10];
+                weights[11] -= n/(float)NUMBER_OF_VOLUMES * gradient[11];
+                weights[12] -= n/(float)NUMBER_OF_VOLUMES * gradient[12];
+                weights[13] -= n/(float)NUMBER_OF_VOLUMES * gradient[13];
+                weights[14] -= n/(float)NUMBER_OF_VOLUMES * gradient[14];
+                weights[15] -= n/(float)NUMBER_OF_VOLUMES * gradient[15];
+                weights[16] -= n/(float)NUMBER_OF_VOLUMES * gradient[16];
+                weights[17] -= n/(float)NUMBER_OF_VOLUMES * gradient[17];
+                weights[18] -= n/(float)NUMBER_OF_VOLUMES * gradient[18];
+                weights[19] -= n/(float)NUMBER_OF_VOLUMES * gradient[19];
         
-            // end for epocs
-        }
+                // end for epocs
+            }
         
-        // Make classification
-        float s;
-        s =  weights[0] * 1.0f;
+            // Make classification
+            float s;
+            s =  weights[0] * 1.0f;
         
-        float x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15, x16, x17, x18, x19;
-        
-        x1 = Volumes[Calculate4DIndex(x-1,y,z-1,validation,DATA_W,DATA_H,DATA_D)];
-        x2 = Volumes[Calculate4DIndex(x,y-1,z-1,validation,DATA_W,DATA_H,DATA_D)];
-        x3 = Volumes[Calculate4DIndex(x,y,z-1,validation,DATA_W,DATA_H,DATA_D)];
-        x4 = Volumes[Calculate4DIndex(x,y+1,z-1,validation,DATA_W,DATA_H,DATA_D)];
-        x5 = Volumes[Calculate4DIndex(x+1,y,z-1,validation,DATA_W,DATA_H,DATA_D)];
-        
-        x6 = Volumes[Calculate4DIndex(x-1,y-1,z,validation,DATA_W,DATA_H,DATA_D)];
-        x7 = Volumes[Calculate4DIndex(x-1,y,z,validation,DATA_W,DATA_H,DATA_D)];
-        x8 = Volumes[Calculate4DIndex(x-1,y+1,z,validation,DATA_W,DATA_H,DATA_D)];
-        x9 = Volumes[Calculate4DIndex(x,y-1,z,validation,DATA_W,DATA_H,DATA_D)];
-        x10 = Volumes[Calculate4DIndex(x,y,z,validation,DATA_W,DATA_H,DATA_D)];
-        x11 = Volumes[Calculate4DIndex(x,y+1,z,validation,DATA_W,DATA_H,DATA_D)];
-        x12 = Volumes[Calculate4DIndex(x+1,y-1,z,validation,DATA_W,DATA_H,DATA_D)];
-        x13 = Volumes[Calculate4DIndex(x+1,y,z,validation,DATA_W,DATA_H,DATA_D)];
-        x14 = Volumes[Calculate4DIndex(x+1,y+1,z,validation,DATA_W,DATA_H,DATA_D)];
-        
-        x15 = Volumes[Calculate4DIndex(x-1,y,z+1,validation,DATA_W,DATA_H,DATA_D)];
-        x16 = Volumes[Calculate4DIndex(x,y-1,z+1,validation,DATA_W,DATA_H,DATA_D)];
-        x17 = Volumes[Calculate4DIndex(x,y,z+1,validation,DATA_W,DATA_H,DATA_D)];
-        x18 = Volumes[Calculate4DIndex(x,y+1,z+1,validation,DATA_W,DATA_H,DATA_D)];
-        x19 = Volumes[Calculate4DIndex(x+1,y,z+1,validation,DATA_W,DATA_H,DATA_D)];
+            float x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15, x16, x17, x18, x19;
         
-        // z - 1
-        s += weights[1] * x1;
-        s += weights[2] * x2;
-        s += weights[3] * x3;
-        s += weights[4] * x4;
-        s += weights[5] * x5;
+            x1 = Volumes[Calculate4DIndex(x-1,y,z-1,validation,DATA_W,DATA_H,DATA_D)];
+            x2 = Volumes[Calculate4DIndex(x,y-1,z-1,validation,DATA_W,DATA_H,DATA_D)];
+            x3 = Volumes[Calculate4DIndex(x,y,z-1,validation,DATA_W,DATA_H,DATA_D)];
+            x4 = Volumes[Calculate4DIndex(x,y+1,z-1,validation,DATA_W,DATA_H,DATA_D)];
+            x5 = Volumes[Calculate4DIndex(x+1,y,z-1,validation,DATA_W,DATA_H,DATA_D)];
         
-        // z
-        s += weights[6] * x6;
-        s += weights[7] * x7;
-        s += weights[8] * x8;
-        s += weights[9] * x9;
-        s += weights[10] * x10;
-        s += weights[11] * x11;
-        s += weights[12] * x12;
-        s += weights[13] * x13;
-        s += weights[14] * x14;
+            x6 = Volumes[Calculate4DIndex(x-1,y-1,z,validation,DATA_W,DATA_H,DATA_D)];
+            x7 = Volumes[Calculate4DIndex(x-1,y,z,validation,DATA_W,DATA_H,DATA_D)];
+            x8 = Volumes[Calculate4DIndex(x-1,y+1,z,validation,DATA_W,DATA_H,DATA_D)];
+            x9 = Volumes[Calculate4DIndex(x,y-1,z,validation,DATA_W,DATA_H,DATA_D)];
+            x10 = Volumes[Calculate4DIndex(x,y,z,validation,DATA_W,DATA_H,DATA_D)];
+            x11 = Volumes[Calculate4DIndex(x,y+1,z,validation,DATA_W,DATA_H,DATA_D)];
+            x12 = Volumes[Calculate4DIndex(x+1,y-1,z,validation,DATA_W,DATA_H,DATA_D)];
+            x13 = Volumes[Calculate4DIndex(x+1,y,z,validation,DATA_W,DATA_H,DATA_D)];
+            x14 = Volumes[Calculate4DIndex(x+1,y+1,z,validation,DATA_W,DATA_H,DATA_D)];
         
-        // z + 1
-        s += weights[15] * x15;
-        s += weights[16] * x16;
-        s += weights[17] * x17;
-        s += weights[18] * x18;
-        s += weights[19] * x19;
+            x15 = Volumes[Calculate4DIndex(x-1,y,z+1,validation,DATA_W,DATA_H,DATA_D)];
+            x16 = Volumes[Calculate4DIndex(x,y-1,z+1,validation,DATA_W,DATA_H,DATA_D)];
+            x17 = Volumes[Calculate4DIndex(x,y,z+1,validation,DATA_W,DATA_H,DATA_D)];
+            x18 = Volumes[Calculate4DIndex(x,y+1,z+1,validation,DATA_W,DATA_H,DATA_D)];
+            x19 = Volumes[Calculate4DIndex(x+1,y,z+1,validation,DATA_W,DATA_H,DATA_D)];
         
-        float classification;
-        if (s > 0.0f)
-        {
-            classification = 0.0f;
-        }
-        else
-        {
-            classification = 1.0f;
-        }
+            // z - 1
+            s += weights[1] * x1;
+            s += weights[2] * x2;
+            s += weights[3] * x3;
+            s += weights[4] * x4;
+            s += weights[5] * x5;
         
-        if (classification == c_Correct_Classes[validation])
+            // z
+            s += weights[6] * x6;
+            s += weights[7] * x7;
+            s += weights[8] * x8;
+            s += weights[9] * x9;
+            s += weights[10] * x10;
+            s += weights[11] * x11;
+            s += weights[12] * x12;
+            s += weights[13] * x13;
+            s += weights[14] * x14;
+        
+            // z + 1
+            s += weights[15] * x15;
+            s += weights[16] * x16;
+            s += weights[17] * x17;
+            s += weights[18] * x18;
+            s += weights[19] * x19;
+        
+            float classification;
+            if (s > 0.0f)
+            {
+                classification = 0.0f;
+            }
+            else
+            {
+                classification = 1.0f;
+            }
+        
+            if (classification == c_Correct_Classes[validation])
+            {
+                classification_performance++;
+            }
+        
+            // end for validation
+        }
+
+        float performance = (float)classification_performance / (float)uncensoredVolumes;
+
+        if (WRITE_PERFORMANCE && (b == 0))
         {
-            classification_performance++;
+            Classifier_Performance[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = performance;
         }
-        
-        // end for validation
+
+        atomic_max(&Max_Performance[b], as_int(performance));
     }
-    
-    Classifier_Performance[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = (float)classification_performance / (float)uncensoredVolumes;
 }
 
 
@@ -975,3 +1004,526 @@ __kernel void CalculateStatisticalMapSearchlight___(__global float* Classifier_P
     Classifier_Performance[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = (float)classification_performance / (float)uncensoredVolumes;
 }
 
+
+#define SEARCHLIGHT_LDA 1
+#define SEARCHLIGHT_RIDGE 2
+
+// Reads feature f of the sphere around voxel (x,y,z), voxels outside the volume are zero
+float ReadSearchlightFeature(__global const float* Volumes,
+	                         __local const int* l_Offsets,
+							 int f,
+							 int x,
+							 int y,
+							 int z,
+							 int v,
+							 int DATA_W,
+							 int DATA_H,
+							 int DATA_D)
+{
+	int xx = x + l_Offsets[3 * f + 0];
+	int yy = y + l_Offsets[3 * f + 1];
+	int zz = z + l_Offsets[3 * f + 2];
+
+	if ( (xx < 0) || (yy < 0) || (zz < 0) || (xx >= DATA_W) || (yy >= DATA_H) || (zz >= DATA_D) )
+	{
+		return 0.0f;
+	}
+
+	return Volumes[Calculate4DIndex(xx,yy,zz,v,DATA_W,DATA_H,DATA_D)];
+}
+
+// Reads the (mean subtracted) features of the volumes v0 to v0 + TILE_VOLUMES - 1 into local memory, censored volumes are set to zero
+void ReadSearchlightTile(__local float* l_Features,
+	                     __local const float* l_Means,
+						 __local const int* l_Offsets,
+						 __global const float* Volumes,
+						 __global const float* Classes,
+						 int v0,
+						 int TILE_VOLUMES,
+						 int x,
+						 int y,
+						 int z,
+						 int DATA_W,
+						 int DATA_H,
+						 int DATA_D,
+						 int NUMBER_OF_FEATURES)
+{
+	int p = NUMBER_OF_FEATURES;
+
+	for (int e = get_local_id(0); e < TILE_VOLUMES * p; e += get_local_size(0))
+	{
+		int t = e / p;
+		int f = e - t * p;
+
+		if (Classes[v0 + t] != 9999.0f)
+		{
+			l_Features[e] = ReadSearchlightFeature(Volumes, l_Offsets, f, x, y, z, v0 + t, DATA_W, DATA_H, DATA_D) - l_Means[f];
+		}
+		else
+		{
+			l_Features[e] = 0.0f;
+		}
+	}
+}
+
+// For the volumes START_VOLUME to STOP_VOLUME - 1, adds SIGN times the sums of products of the features to the lower triangle of Matrix,
+// the sums of the features to l_Sums and the sums of the features of class 0 (d > 0) for every labelling to Class_Sums
+void AccumulateSearchlightProducts(__global float* Matrix,
+	                               __local float* l_Sums,
+								   __global float* Class_Sums,
+								   __local float* l_Features,
+								   __local const float* l_Means,
+								   __local const int* l_Offsets,
+								   __global const float* Volumes,
+								   __global const float* d_Values,
+								   __global const float* Classes,
+								   float SIGN,
+								   int START_VOLUME,
+								   int STOP_VOLUME,
+								   int x,
+								   int y,
+								   int z,
+								   int DATA_W,
+								   int DATA_H,
+								   int DATA_D,
+								   int NUMBER_OF_VOLUMES,
+								   int NUMBER_OF_FEATURES,
+								   int NUMBER_OF_TILE_VOLUMES,
+								   int NUMBER_OF_PERMUTATIONS)
+{
+	int tid = get_local_id(0);
+	int localSize = get_local_size(0);
+	int p = NUMBER_OF_FEATURES;
+
+	for (int v0 = START_VOLUME; v0 < STOP_VOLUME; v0 += NUMBER_OF_TILE_VOLUMES)
+	{
+		int tileVolumes = min(NUMBER_OF_TILE_VOLUMES, STOP_VOLUME - v0);
+
+		ReadSearchlightTile(l_Features, l_Means, l_Offsets, Volumes, Classes, v0, tileVolumes, x, y, z, DATA_W, DATA_H, DATA_D, p);
+		barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+
+		for (int e = tid; e < p * p; e += localSize)
+		{
+			int i = e / p;
+			int j = e - i * p;
+
+			if (j > i)
+				continue;
+
+			float sum = 0.0f;
+			for (int t = 0; t < tileVolumes; t++)
+			{
+				sum += l_Features[t * p + i] * l_Features[t * p + j];
+			}
+			Matrix[e] += SIGN * sum;
+		}
+
+		for (int f = tid; f < p; f += localSize)
+		{
+			float sum = 0.0f;
+			for (int t = 0; t < tileVolumes; t++)
+			{
+				sum += l_Features[t * p + f];
+			}
+			l_Sums[f] += sum;
+		}
+
+		for (int e = tid; e < NUMBER_OF_PERMUTATIONS * p; e += localSize)
+		{
+			int b = e / p;
+			int f = e - b * p;
+
+			float sum = 0.0f;
+			for (int t = 0; t < tileVolumes; t++)
+			{
+				if (d_Values[b * NUMBER_OF_VOLUMES + v0 + t] > 0.0f)
+				{
+					sum += l_Features[t * p + f];
+				}
+			}
+			Class_Sums[e] += sum;
+		}
+		barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+	}
+}
+
+// Cholesky factorization of a symmetric positive definite matrix, the lower triangle is overwritten with the factor
+void CholeskyInGroup(__global float* Matrix,
+	                 int N)
+{
+	int tid = get_local_id(0);
+	int localSize = get_local_size(0);
+
+	for (int k = 0; k < N; k++)
+	{
+		if (tid == 0)
+		{
+			Matrix[k * N + k] = sqrt(max(Matrix[k * N + k], 1e-20f));
+		}
+		barrier(CLK_GLOBAL_MEM_FENCE);
+
+		float diagonal = Matrix[k * N + k];
+		for (int i = k + 1 + tid; i < N; i += localSize)
+		{
+			Matrix[i * N + k] /= diagonal;
+		}
+		barrier(CLK_GLOBAL_MEM_FENCE);
+
+		// Update the remaining lower triangle
+		int m = N - k - 1;
+		for (int e = tid; e < m * m; e += localSize)
+		{
+			int i = k + 1 + e / m;
+			int j = k + 1 + e % m;
+
+			if (j > i)
+				continue;
+
+			Matrix[i * N + j] -= Matrix[i * N + k] * Matrix[j * N + k];
+		}
+		barrier(CLK_GLOBAL_MEM_FENCE);
+	}
+}
+
+// Solves L L^T x = b for NUMBER_OF_VECTORS right hand sides at the same time, the solutions overwrite the right hand sides (one vector of length N after the other)
+void SolveCholeskyInGroup(__global const float* Factor,
+	                      __global float* Vectors,
+						  int NUMBER_OF_VECTORS,
+						  int N)
+{
+	int tid = get_local_id(0);
+	int localSize = get_local_size(0);
+
+	// Forward substitution, L y = b
+	for (int k = 0; k < N; k++)
+	{
+		for (int b = tid; b < NUMBER_OF_VECTORS; b += localSize)
+		{
+			Vectors[b * N + k] /= Factor[k * N + k];
+		}
+		barrier(CLK_GLOBAL_MEM_FENCE);
+
+		int m = N - k - 1;
+		for (int e = tid; e < NUMBER_OF_VECTORS * m; e += localSize)
+		{
+			int b = e / m;
+			int i = k + 1 + e % m;
+			Vectors[b * N + i] -= Factor[i * N + k] * Vectors[b * N + k];
+		}
+		barrier(CLK_GLOBAL_MEM_FENCE);
+	}
+
+	// Backward substitution, L^T x = y
+	for (int k = N - 1; k >= 0; k--)
+	{
+		for (int b = tid; b < NUMBER_OF_VECTORS; b += localSize)
+		{
+			Vectors[b * N + k] /= Factor[k * N + k];
+		}
+		barrier(CLK_GLOBAL_MEM_FENCE);
+
+		for (int e = tid; e < NUMBER_OF_VECTORS * k; e += localSize)
+		{
+			int b = e / k;
+			int i = e % k;
+			Vectors[b * N + i] -= Factor[k * N + i] * Vectors[b * N + k];
+		}
+		barrier(CLK_GLOBAL_MEM_FENCE);
+	}
+}
+
+// Searchlight with a closed form linear classifier, regularised LDA or ridge regression on the labels d (1 for class 0 and -1 for class 1),
+// for NUMBER_OF_PERMUTATIONS labellings at the same time (d_Values and Classes are NUMBER_OF_PERMUTATIONS x NUMBER_OF_VOLUMES, censored volumes
+// have class 9999 and must be the same for all labellings). One work group processes one voxel of the list Voxel_Indices.
+//
+// The sums of products of the features are calculated once, the contributions of the volumes in each fold are then subtracted to get the
+// total scatter matrix of the training data, which does not depend on the labels. It is regularised and Cholesky factorised once per fold, and
+// used for all labellings. Ridge regression uses the total scatter directly, and for LDA the within class scatter is the total scatter minus a
+// rank one term along the difference of the class means, which only changes the length of the discriminant (not the classification).
+// Fold f contains the volumes c_Fold_Boundaries[f] to c_Fold_Boundaries[f + 1] - 1. Every work group uses 2 x NUMBER_OF_FEATURES^2 +
+// 3 x NUMBER_OF_PERMUTATIONS x NUMBER_OF_FEATURES floats of Scratch. The classifier performance of the first labelling is written to
+// Classifier_Performance if WRITE_PERFORMANCE is set, and the maximum performance over voxels of every labelling is saved in Max_Performance
+// (as the bits of a float, which works with integer atomics since the performance is positive)
+__kernel void CalculateStatisticalMapSearchlightLinear(__global float* Classifier_Performance,
+	                                                   volatile __global int* Max_Performance,
+	                                                   __global const float* Volumes,
+													   __global float* Scratch,
+													   __global const int* Voxel_Indices,
+													   __global const float* d_Values,
+													   __global const float* Classes,
+													   __constant int* c_Sphere_Offsets,
+													   __constant int* c_Fold_Boundaries,
+													   __local int* l_Offsets,
+													   __local float* l_Features,
+													   __local float* l_Vectors,
+													   __local int* l_Counts,
+													   __private int DATA_W,
+													   __private int DATA_H,
+													   __private int DATA_D,
+													   __private int NUMBER_OF_VOLUMES,
+													   __private int NUMBER_OF_FEATURES,
+													   __private int NUMBER_OF_FOLDS,
+													   __private int NUMBER_OF_TILE_VOLUMES,
+													   __private int CLASSIFIER,
+													   __private float REGULARIZATION,
+													   __private int NUMBER_OF_PERMUTATIONS,
+													   __private int WRITE_PERFORMANCE,
+													   __private int VOXEL_OFFSET,
+													   __private int NUMBER_OF_VOXELS)
+{
+	int tid = get_local_id(0);
+	int localSize = get_local_size(0);
+	int group = get_group_id(0);
+	int p = NUMBER_OF_FEATURES;
+	int B = NUMBER_OF_PERMUTATIONS;
+
+	if ((VOXEL_OFFSET + group) >= NUMBER_OF_VOXELS)
+		return;
+
+	int voxel = Voxel_Indices[VOXEL_OFFSET + group];
+	int z = voxel / (DATA_W * DATA_H);
+	int y = (voxel - z * DATA_W * DATA_H) / DATA_W;
+	int x = voxel - z * DATA_W * DATA_H - y * DATA_W;
+
+	__global float* Total_Products = &Scratch[group * (2 * p * p + 3 * B * p)];
+	__global float* Matrix = &Total_Products[p * p];
+	__global float* Class_Sums = &Total_Products[2 * p * p];
+	__global float* Fold_Class_Sums = &Total_Products[2 * p * p + B * p];
+	__global float* Weights = &Total_Products[2 * p * p + 2 * B * p];
+
+	__local float* l_Means = &l_Vectors[0];
+	__local float* l_Sums = &l_Vectors[p];
+	__local float* l_Fold_Sums = &l_Vectors[2 * p];
+
+	// Correct classifications, tested volumes and training volumes of class 0, for every labelling
+	__local int* l_Correct = &l_Counts[0];
+	__local int* l_Tested = &l_Counts[B];
+	__local int* l_Training_Class_0 = &l_Counts[2 * B];
+
+	__local float l_Ridge;
+
+	for (int i = tid; i < 3 * p; i += localSize)
+	{
+		l_Offsets[i] = c_Sphere_Offsets[i];
+	}
+	for (int b = tid; b < B; b += localSize)
+	{
+		l_Correct[b] = 0;
+		l_Tested[b] = 0;
+	}
+
+	int uncensoredVolumes = 0;
+	for (int v = 0; v < NUMBER_OF_VOLUMES; v++)
+	{
+		if (Classes[v] != 9999.0f)
+		{
+			uncensoredVolumes++;
+		}
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// Subtract the mean of each feature, to avoid cancellation when the means are removed from the sums of products
+	for (int f = tid; f < p; f += localSize)
+	{
+		float sum = 0.0f;
+		for (int v = 0; v < NUMBER_OF_VOLUMES; v++)
+		{
+			if (Classes[v] != 9999.0f)
+			{
+				sum += ReadSearchlightFeature(Volumes, l_Offsets, f, x, y, z, v, DATA_W, DATA_H, DATA_D);
+			}
+		}
+		l_Means[f] = sum / (float)max(uncensoredVolumes, 1);
+		l_Sums[f] = 0.0f;
+	}
+	for (int e = tid; e < p * p; e += localSize)
+	{
+		Total_Products[e] = 0.0f;
+	}
+	for (int e = tid; e < B * p; e += localSize)
+	{
+		Class_Sums[e] = 0.0f;
+	}
+	barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+
+	AccumulateSearchlightProducts(Total_Products, l_Sums, Class_Sums, l_Features, l_Means, l_Offsets, Volumes, d_Values, Classes, 1.0f, 0, NUMBER_OF_VOLUMES, x, y, z, DATA_W, DATA_H, DATA_D, NUMBER_OF_VOLUMES, p, NUMBER_OF_TILE_VOLUMES, B);
+
+	for (int fold = 0; fold < NUMBER_OF_FOLDS; fold++)
+	{
+		int start = c_Fold_Boundaries[fold];
+		int stop = c_Fold_Boundaries[fold + 1];
+
+		int n = uncensoredVolumes;
+		for (int v = start; v < stop; v++)
+		{
+			if (Classes[v] != 9999.0f)
+			{
+				n--;
+			}
+		}
+
+		if (n < 2)
+			continue;
+
+		for (int b = tid; b < B; b += localSize)
+		{
+			int n0 = 0;
+			for (int v = 0; v < NUMBER_OF_VOLUMES; v++)
+			{
+				if ( ((v < start) || (v >= stop)) && (Classes[v] != 9999.0f) && (d_Values[b * NUMBER_OF_VOLUMES + v] > 0.0f) )
+				{
+					n0++;
+				}
+			}
+			l_Training_Class_0[b] = n0;
+		}
+
+		// Training data is all data minus the fold
+		for (int e = tid; e < p * p; e += localSize)
+		{
+			Matrix[e] = Total_Products[e];
+		}
+		for (int f = tid; f < p; f += localSize)
+		{
+			l_Fold_Sums[f] = 0.0f;
+		}
+		for (int e = tid; e < B * p; e += localSize)
+		{
+			Fold_Class_Sums[e] = 0.0f;
+		}
+		barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+
+		AccumulateSearchlightProducts(Matrix, l_Fold_Sums, Fold_Class_Sums, l_Features, l_Means, l_Offsets, Volumes, d_Values, Classes, -1.0f, start, stop, x, y, z, DATA_W, DATA_H, DATA_D, NUMBER_OF_VOLUMES, p, NUMBER_OF_TILE_VOLUMES, B);
+
+		// Total scatter of the training data
+		for (int e = tid; e < p * p; e += localSize)
+		{
+			int i = e / p;
+			int j = e - i * p;
+
+			if (j > i)
+				continue;
+
+			Matrix[e] -= (l_Sums[i] - l_Fold_Sums[i]) * (l_Sums[j] - l_Fold_Sums[j]) / (float)n;
+		}
+
+		// Right hand side for every labelling, zero if one of the classes is missing in the training data
+		for (int e = tid; e < B * p; e += localSize)
+		{
+			int b = e / p;
+			int f = e - b * p;
+
+			int n0 = l_Training_Class_0[b];
+			int n1 = n - n0;
+
+			float t = l_Sums[f] - l_Fold_Sums[f];
+			float t0 = Class_Sums[e] - Fold_Class_Sums[e];
+			float t1 = t - t0;
+
+			if ((n0 == 0) || (n1 == 0))
+			{
+				Weights[e] = 0.0f;
+			}
+			else if (CLASSIFIER == SEARCHLIGHT_LDA)
+			{
+				Weights[e] = t0 / (float)n0 - t1 / (float)n1;
+			}
+			else
+			{
+				Weights[e] = t0 - t1 - (float)(n0 - n1) / (float)n * t;
+			}
+		}
+		barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+
+		// Regularisation relative to the mean variance of the features
+		if (tid == 0)
+		{
+			float trace = 0.0f;
+			for (int f = 0; f < p; f++)
+			{
+				trace += Matrix[f * p + f];
+			}
+			l_Ridge = REGULARIZATION * trace / (float)p + 1e-6f;
+		}
+		barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+
+		for (int f = tid; f < p; f += localSize)
+		{
+			Matrix[f * p + f] += l_Ridge;
+		}
+		barrier(CLK_GLOBAL_MEM_FENCE);
+
+		CholeskyInGroup(Matrix, p);
+		SolveCholeskyInGroup(Matrix, Weights, B, p);
+
+		// Test, one work item per labelling and volume in the fold
+		for (int v0 = start; v0 < stop; v0 += NUMBER_OF_TILE_VOLUMES)
+		{
+			int tileVolumes = min(NUMBER_OF_TILE_VOLUMES, stop - v0);
+
+			ReadSearchlightTile(l_Features, l_Means, l_Offsets, Volumes, Classes, v0, tileVolumes, x, y, z, DATA_W, DATA_H, DATA_D, p);
+			barrier(CLK_LOCAL_MEM_FENCE);
+
+			for (int e = tid; e < B * tileVolumes; e += localSize)
+			{
+				int b = e / tileVolumes;
+				int t = e - b * tileVolumes;
+				int v = v0 + t;
+
+				int n0 = l_Training_Class_0[b];
+				int n1 = n - n0;
+
+				if ( (Classes[v] == 9999.0f) || (n0 == 0) || (n1 == 0) )
+					continue;
+
+				// The LDA threshold is between the class means, ridge regression predicts the centered labels
+				float s = 0.0f;
+				for (int f = 0; f < p; f++)
+				{
+					float total = l_Sums[f] - l_Fold_Sums[f];
+					float t0 = Class_Sums[b * p + f] - Fold_Class_Sums[b * p + f];
+					float t1 = total - t0;
+
+					float center;
+					if (CLASSIFIER == SEARCHLIGHT_LDA)
+					{
+						center = 0.5f * (t0 / (float)n0 + t1 / (float)n1);
+					}
+					else
+					{
+						center = total / (float)n;
+					}
+
+					s += Weights[b * p + f] * (l_Features[t * p + f] - center);
+				}
+
+				if (CLASSIFIER == SEARCHLIGHT_RIDGE)
+				{
+					s += (float)(n0 - n1) / (float)n;
+				}
+
+				float classification = (s > 0.0f) ? 0.0f : 1.0f;
+
+				if (classification == Classes[b * NUMBER_OF_VOLUMES + v])
+				{
+					atomic_inc(&l_Correct[b]);
+				}
+				atomic_inc(&l_Tested[b]);
+			}
+			barrier(CLK_LOCAL_MEM_FENCE);
+		}
+		barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+	}
+
+	for (int b = tid; b < B; b += localSize)
+	{
+		float performance = (l_Tested[b] > 0) ? (float)l_Correct[b] / (float)l_Tested[b] : 0.0f;
+
+		if (WRITE_PERFORMANCE && (b == 0))
+		{
+			Classifier_Performance[voxel] = performance;
+		}
+
+		atomic_max(&Max_Performance[b], as_int(performance));
+	}
+}
@@ -1555,6 +1555,37 @@ __kernel void CalculateStatisticalMapsGLMTTest(__global float* Statistical_Maps,
 	}
 }
 
+// Transforms t-values to z-values (same tail probability), using the approximation by Wallace (1959) which is accurate 
+// to about 0.01 for 30 degrees of freedom or more, avoids the incomplete beta function in every voxel
+
+__kernel void TransformTToZ(__global float* Statistical_Maps,
+		                    __global const float* Mask,
+		                    __private int DATA_W,
+		                    __private int DATA_H,
+		                    __private int DATA_D,
+		                    __private int NUMBER_OF_MAPS,
+		                    __private float DEGREES_OF_FREEDOM)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int z = get_global_id(2);
+
+	if (x >= DATA_W || y >= DATA_H || z >= DATA_D)
+		return;
+
+	if ( Mask[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] != 1.0f )
+		return;
+
+	float scale = (8.0f * DEGREES_OF_FREEDOM + 1.0f) / (8.0f * DEGREES_OF_FREEDOM + 3.0f);
+
+	for (int m = 0; m < NUMBER_OF_MAPS; m++)
+	{
+		float t = Statistical_Maps[Calculate4DIndex(x,y,z,m,DATA_W,DATA_H,DATA_D)];
+		float zvalue = scale * sqrt(DEGREES_OF_FREEDOM * log(1.0f + t * t / DEGREES_OF_FREEDOM));
+		Statistical_Maps[Calculate4DIndex(x,y,z,m,DATA_W,DATA_H,DATA_D)] = (t < 0.0f) ? -zvalue : zvalue;
+	}
+}
+
 // Unoptimized kernel for calculating F-values, not a problem for regular first and second level analysis
 
 __kernel void CalculateStatisticalMapsGLMFTest(__global float* Statistical_Maps,
@@ -1828,3 +1859,203 @@ __kernel void RemoveLinearFitSlice(__global float* Residual_Volumes,
 
 
 
+// The chunk kernels below operate on a tile of brain voxels, stored with the voxel index running fastest,
+// i.e. Volumes[v + t * NUMBER_OF_VOXELS], so that neighbouring work items read neighbouring addresses.
+// The voxel-specific models are stored in the same way, d_xtxxt_GLM[v + (r * NUMBER_OF_VOLUMES + t) * NUMBER_OF_VOXELS]
+
+__kernel void CalculateBetaWeightsGLMFirstLevelChunk(__global float* Betas, 
+													 __global const float* Volumes, 
+													 __global const float* d_xtxxt_GLM, 
+													 __private int NUMBER_OF_VOXELS, 
+													 __private int NUMBER_OF_VOLUMES, 
+													 __private int NUMBER_OF_REGRESSORS,
+													 __private int NUMBER_OF_INVALID_TIMEPOINTS)
+{
+	int v = get_global_id(0);
+
+	if (v >= NUMBER_OF_VOXELS)
+		return;
+
+	int NUMBER_OF_REGRESSORS_PER_CHUNK = 25;
+	int REGRESSOR_GROUPS = (int)ceil((float)NUMBER_OF_REGRESSORS / (float)NUMBER_OF_REGRESSORS_PER_CHUNK);
+	int NUMBER_OF_REGRESSORS_IN_CURRENT_CHUNK = 0;
+
+	// Loop over chunks of 25 regressors at a time, since it is not possible to use for example 400 registers per thread
+	for (int regressor_group = 0; regressor_group < REGRESSOR_GROUPS; regressor_group++)
+	{
+		// Check how many regressors that are left
+		if ( (NUMBER_OF_REGRESSORS - regressor_group * NUMBER_OF_REGRESSORS_PER_CHUNK) >= 25 )
+		{
+			NUMBER_OF_REGRESSORS_IN_CURRENT_CHUNK = 25;
+		}	
+		else
+		{
+			NUMBER_OF_REGRESSORS_IN_CURRENT_CHUNK = NUMBER_OF_REGRESSORS - regressor_group * NUMBER_OF_REGRESSORS_PER_CHUNK;
+		}
+
+		float beta[25];
+	
+		// Reset beta weights
+		for (int r = 0; r < 25; r++)
+		{
+			beta[r] = 0.0f;
+		}
+
+		// Calculate betahat, i.e. multiply (x^T x)^(-1) x^T with Y
+		// Loop over volumes
+		for (int t = NUMBER_OF_INVALID_TIMEPOINTS; t < NUMBER_OF_VOLUMES; t++)
+		{
+			float temp = Volumes[v + t * NUMBER_OF_VOXELS];
+
+			// Loop over regressors
+			for (int r = 0; r < NUMBER_OF_REGRESSORS_IN_CURRENT_CHUNK; r++)
+			{
+				beta[r] += temp * d_xtxxt_GLM[v + ((r + regressor_group * NUMBER_OF_REGRESSORS_PER_CHUNK) * NUMBER_OF_VOLUMES + t) * NUMBER_OF_VOXELS];
+			}
+		}
+
+		// Save beta values for the current chunk of regressors
+		for (int r = 0; r < NUMBER_OF_REGRESSORS_IN_CURRENT_CHUNK; r++)
+		{
+			Betas[v + (r + regressor_group * NUMBER_OF_REGRESSORS_PER_CHUNK) * NUMBER_OF_VOXELS] = beta[r];
+		}
+	}
+}
+
+__kernel void CalculateGLMResidualsChunk(__global float* Residuals,
+		                                 __global const float* Volumes,
+		                                 __global const float* Betas,
+		                                 __constant float *c_X_GLM,
+		                                 __private int NUMBER_OF_VOXELS,
+		                                 __private int NUMBER_OF_VOLUMES,
+		                                 __private int NUMBER_OF_REGRESSORS)
+{
+	int v = get_global_id(0);
+
+	if (v >= NUMBER_OF_VOXELS)
+		return;
+
+	float eps;
+
+	// Special case for low number of regressors, store beta scores in registers for faster performance
+	if (NUMBER_OF_REGRESSORS <= 25)
+	{
+		float beta[25];
+
+		// Load beta values into registers
+	    for (int r = 0; r < NUMBER_OF_REGRESSORS; r++)
+		{
+			beta[r] = Betas[v + r * NUMBER_OF_VOXELS];
+		}
+
+		// Calculate the residual
+		for (int t = 0; t < NUMBER_OF_VOLUMES; t++)
+		{
+			eps = Volumes[v + t * NUMBER_OF_VOXELS];
+			for (int r = 0; r < NUMBER_OF_REGRESSORS; r++)
+			{
+				eps -= c_X_GLM[NUMBER_OF_VOLUMES * r + t] * beta[r];
+			}
+
+			Residuals[v + t * NUMBER_OF_VOXELS] = eps;			
+		}
+	}
+	// General case for large number of regressors (slower)
+	else
+	{
+		// Calculate the residual
+		for (int t = 0; t < NUMBER_OF_VOLUMES; t++)
+		{
+			eps = Volumes[v + t * NUMBER_OF_VOXELS];
+			for (int r = 0; r < NUMBER_OF_REGRESSORS; r++)
+			{
+				eps -= c_X_GLM[NUMBER_OF_VOLUMES * r + t] * Betas[v + r * NUMBER_OF_VOXELS];
+			}
+
+			Residuals[v + t * NUMBER_OF_VOXELS] = eps;			
+		}
+	}
+}
+
+__kernel void CalculateStatisticalMapsGLMTTestFirstLevelChunk(__global float* Statistical_Maps,
+															  __global float* Contrast_Values,
+		                                       	   	   	 	  __global float* Residuals,
+		                                       	   	   	 	  __global float* Residual_Variances,
+		                                       	   	   	 	  __global const float* Volumes,
+		                                       	   	   	 	  __global const float* Betas,
+		                                       	   	   	 	  __global const float* d_X_GLM,
+		                                       	   	   	 	  __global const float* d_GLM_Scalars,
+		                                       	   	   	 	  __constant float* c_Contrasts,
+		                                       	   	   	 	  __constant float* c_Censored_Timepoints,
+		                                       	   	   	 	  __private int NUMBER_OF_VOXELS,
+		                                       	   	   	 	  __private int NUMBER_OF_VOLUMES,
+		                                       	   	   	 	  __private int NUMBER_OF_REGRESSORS,
+		                                       	   	   	 	  __private int NUMBER_OF_CONTRASTS)
+{
+	int v = get_global_id(0);
+
+	if (v >= NUMBER_OF_VOXELS)
+		return;
+
+	float eps, meaneps, vareps;
+	float beta[25];
+	
+	// Load beta values into registers, for a low number of regressors
+	if (NUMBER_OF_REGRESSORS <= 25)
+	{
+	    for (int r = 0; r < NUMBER_OF_REGRESSORS; r++)
+		{
+			beta[r] = Betas[v + r * NUMBER_OF_VOXELS];
+		}
+	}
+
+	// Calculate the residuals and their mean, using voxel-specific design models
+	meaneps = 0.0f;
+	for (int t = 0; t < NUMBER_OF_VOLUMES; t++)
+	{
+		eps = Volumes[v + t * NUMBER_OF_VOXELS];
+
+		if (NUMBER_OF_REGRESSORS <= 25)
+		{
+			for (int r = 0; r < NUMBER_OF_REGRESSORS; r++)
+			{
+				eps -= d_X_GLM[v + (r * NUMBER_OF_VOLUMES + t) * NUMBER_OF_VOXELS] * beta[r];
+			}
+		}
+		else
+		{
+			for (int r = 0; r < NUMBER_OF_REGRESSORS; r++)
+			{
+				eps -= d_X_GLM[v + (r * NUMBER_OF_VOLUMES + t) * NUMBER_OF_VOXELS] * Betas[v + r * NUMBER_OF_VOXELS];
+			}
+		}
+		eps *= c_Censored_Timepoints[t];
+		meaneps += eps;
+	
+		Residuals[v + t * NUMBER_OF_VOXELS] = eps;		
+	}
+	meaneps /= ((float)NUMBER_OF_VOLUMES);
+
+	// Now calculate the variance of the residuals, which are already stored
+	vareps = 0.0f;
+	for (int t = 0; t < NUMBER_OF_VOLUMES; t++)
+	{
+		eps = Residuals[v + t * NUMBER_OF_VOXELS];
+		vareps += (eps - meaneps) * (eps - meaneps) * c_Censored_Timepoints[t];
+	}
+	vareps /= ((float)NUMBER_OF_VOLUMES - 1.0f);
+	Residual_Variances[v] = vareps;
+
+	// Loop over contrasts and calculate t-values, using a voxel-specific GLM scalar
+	for (int c = 0; c < NUMBER_OF_CONTRASTS; c++)
+	{
+		float contrast_value = 0.0f;
+		for (int r = 0; r < NUMBER_OF_REGRESSORS; r++)
+		{
+			contrast_value += c_Contrasts[NUMBER_OF_REGRESSORS * c + r] * Betas[v + r * NUMBER_OF_VOXELS];
+		}
+		Contrast_Values[v + c * NUMBER_OF_VOXELS] = contrast_value;
+		Statistical_Maps[v + c * NUMBER_OF_VOXELS] = contrast_value * rsqrt(vareps * d_GLM_Scalars[v + c * NUMBER_OF_VOXELS]);
+	}
+}
+
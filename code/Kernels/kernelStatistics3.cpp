@@ -2193,3 +2193,62 @@ __kernel void CalculateStatisticalMapsGLMTTestFirstLevelPermutation(__global flo
     Statistical_Maps[Calculate3DIndex(x,y,z,DATA_W,DATA_H)] = contrast_value * rsqrt(vareps * c_ctxtxc_GLM[contrast]);	
 }
 
+
+// Calculates a permuted t-map for first level analysis, for brain voxels stored in a compact layout as Volumes[v + t * NUMBER_OF_VOXELS]
+__kernel void CalculateStatisticalMapsGLMTTestFirstLevelPermutationCompact(__global float* Statistical_Maps,
+                                                                           __global const float* Volumes,
+                                                                           __constant float* c_X_GLM,
+                                                                           __constant float* c_xtxxt_GLM,
+                                                                           __constant float* c_Contrasts,	
+                                                                           __constant float* c_ctxtxc_GLM,
+                                                                           __private int NUMBER_OF_VOXELS,
+                                                                           __private int NUMBER_OF_VOLUMES,
+                                                                           __private int NUMBER_OF_REGRESSORS,
+                                                                           __private int NUMBER_OF_CONTRASTS,
+                                                                           __private int contrast)
+{	
+    int i = get_global_id(0);
+    
+    if (i >= NUMBER_OF_VOXELS)
+        return;
+    
+    float eps, meaneps, vareps;
+    float beta[25];
+    
+    // Reset beta weights
+    for (int r = 0; r < 25; r++)
+    {
+        beta[r] = 0.0f;
+    }
+    
+    // Calculate betahat, i.e. multiply (x^T x)^(-1) x^T with Y
+    // Loop over volumes, consecutive work items read consecutive voxels
+    for (int v = 0; v < NUMBER_OF_VOLUMES; v++)
+    {
+        float value = Volumes[i + v * NUMBER_OF_VOXELS];
+        
+        // Loop over regressors using unrolled code for performance
+        CalculateBetaWeightsFirstLevel(beta, value, c_xtxxt_GLM, v, NUMBER_OF_VOLUMES, NUMBER_OF_REGRESSORS);
+    }
+    
+    // Calculate the mean and variance of the error eps
+    meaneps = 0.0f;
+    vareps = 0.0f;
+    float n = 0.0f;
+    for (int v = 0; v < NUMBER_OF_VOLUMES; v++)
+    {
+        eps = Volumes[i + v * NUMBER_OF_VOXELS];
+        eps = CalculateEpsFirstLevel(eps, beta, c_X_GLM, v, NUMBER_OF_VOLUMES, NUMBER_OF_REGRESSORS);
+        
+        n += 1.0f;
+        float delta = eps - meaneps;
+        meaneps += delta/n;
+        vareps += delta * (eps - meaneps);
+    }
+    vareps = vareps / (n - 1.0f);
+    
+    // Calculate t-values
+    float contrast_value = CalculateContrastValue(beta, c_Contrasts, contrast, NUMBER_OF_REGRESSORS);
+    Statistical_Maps[i] = contrast_value * rsqrt(vareps * c_ctxtxc_GLM[contrast]);	
+}
+
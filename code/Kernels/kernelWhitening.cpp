@@ -536,3 +536,218 @@ __kernel void GeneratePermutedVolumesFirstLevel(__global float* Permuted_fMRI_Vo
 
 
 
+// Estimates voxel specific AR(4) models, for a chunk of brain voxels stored as Residuals[v + t * NUMBER_OF_VOXELS]
+__kernel void EstimateAR4ModelsChunk(__global float* AR1_Estimates, 
+                                     __global float* AR2_Estimates, 
+								     __global float* AR3_Estimates, 
+								     __global float* AR4_Estimates, 
+								     __global const float* Residuals, 
+								     __private int NUMBER_OF_VOXELS, 
+								     __private int DATA_T,
+								     __private int INVALID_TIMEPOINTS)
+{
+	int v = get_global_id(0);
+
+    if (v >= NUMBER_OF_VOXELS)
+        return;
+
+    int t = 0;
+	float old_value_1, old_value_2, old_value_3, old_value_4, old_value_5;
+	float c0 = 0.0f;
+    float c1 = 0.0f;
+    float c2 = 0.0f;
+    float c3 = 0.0f;
+    float c4 = 0.0f;
+
+    old_value_1 = Residuals[v + (0 + INVALID_TIMEPOINTS) * NUMBER_OF_VOXELS];
+	c0 += old_value_1 * old_value_1;
+    old_value_2 = Residuals[v + (1 + INVALID_TIMEPOINTS) * NUMBER_OF_VOXELS];
+	c0 += old_value_2 * old_value_2;
+    c1 += old_value_2 * old_value_1;
+    old_value_3 = Residuals[v + (2 + INVALID_TIMEPOINTS) * NUMBER_OF_VOXELS];
+	c0 += old_value_3 * old_value_3;
+    c1 += old_value_3 * old_value_2;
+    c2 += old_value_3 * old_value_1;
+    old_value_4 = Residuals[v + (3 + INVALID_TIMEPOINTS) * NUMBER_OF_VOXELS];
+	c0 += old_value_4 * old_value_4;
+    c1 += old_value_4 * old_value_3;
+    c2 += old_value_4 * old_value_2;
+    c3 += old_value_4 * old_value_1;
+
+    // Estimate c0, c1, c2, c3, c4
+    for (t = 4 + INVALID_TIMEPOINTS; t < DATA_T; t++)
+    {
+        // Read data into register
+        old_value_5 = Residuals[v + t * NUMBER_OF_VOXELS];
+		
+        // Sum and multiply the values in fast registers
+        c0 += old_value_5 * old_value_5;
+        c1 += old_value_5 * old_value_4;
+        c2 += old_value_5 * old_value_3;
+        c3 += old_value_5 * old_value_2;
+        c4 += old_value_5 * old_value_1;
+
+		// Save old values
+        old_value_1 = old_value_2;
+        old_value_2 = old_value_3;
+        old_value_3 = old_value_4;
+        old_value_4 = old_value_5;
+    }
+
+    c0 /= ((float)DATA_T - 1.0f - (float)INVALID_TIMEPOINTS);
+    c1 /= ((float)DATA_T - 2.0f - (float)INVALID_TIMEPOINTS);
+    c2 /= ((float)DATA_T - 3.0f - (float)INVALID_TIMEPOINTS);
+    c3 /= ((float)DATA_T - 4.0f - (float)INVALID_TIMEPOINTS);
+    c4 /= ((float)DATA_T - 5.0f - (float)INVALID_TIMEPOINTS);
+
+    // Calculate alphas
+    float4 r, alphas;
+
+    if (c0 != 0.0f)
+    {
+        r.x = c1/c0;
+        r.y = c2/c0;
+        r.z = c3/c0;
+        r.w = c4/c0;
+
+        float matrix[4][4];
+        matrix[0][0] = 1.0f;
+        matrix[1][0] = r.x + 0.001f;
+        matrix[2][0] = r.y + 0.001f;
+        matrix[3][0] = r.z + 0.001f;
+
+        matrix[0][1] = r.x + 0.001f;
+        matrix[1][1] = 1.0f;
+        matrix[2][1] = r.x + 0.001f;
+        matrix[3][1] = r.y + 0.001f;
+
+        matrix[0][2] = r.y + 0.001f;
+        matrix[1][2] = r.x + 0.001f;
+        matrix[2][2] = 1.0f;
+        matrix[3][2] = r.x + 0.001f;
+
+        matrix[0][3] = r.z + 0.001f;
+        matrix[1][3] = r.y + 0.001f;
+        matrix[2][3] = r.x + 0.001f;
+        matrix[3][3] = 1.0f;
+
+		float inv_matrix[4][4];
+
+        Invert_4x4(matrix, inv_matrix);
+
+        alphas.x = inv_matrix[0][0] * r.x + inv_matrix[0][1] * r.y + inv_matrix[0][2] * r.z + inv_matrix[0][3] * r.w;
+        alphas.y = inv_matrix[1][0] * r.x + inv_matrix[1][1] * r.y + inv_matrix[1][2] * r.z + inv_matrix[1][3] * r.w;
+        alphas.z = inv_matrix[2][0] * r.x + inv_matrix[2][1] * r.y + inv_matrix[2][2] * r.z + inv_matrix[2][3] * r.w;
+        alphas.w = inv_matrix[3][0] * r.x + inv_matrix[3][1] * r.y + inv_matrix[3][2] * r.z + inv_matrix[3][3] * r.w;
+
+        AR1_Estimates[v] = alphas.x;
+		AR2_Estimates[v] = alphas.y;
+		AR3_Estimates[v] = alphas.z;
+		AR4_Estimates[v] = alphas.w;
+    }
+    else
+    {
+		AR1_Estimates[v] = 0.0f;
+        AR2_Estimates[v] = 0.0f;
+		AR3_Estimates[v] = 0.0f;
+		AR4_Estimates[v] = 0.0f;
+    }
+}
+
+// Applies voxel specific AR(4) whitening, for a chunk of brain voxels
+__kernel void ApplyWhiteningAR4Chunk(__global float* Whitened_Volumes, 
+                                     __global const float* Volumes, 
+								     __global const float* AR1_Estimates, 
+								     __global const float* AR2_Estimates, 
+								     __global const float* AR3_Estimates, 
+								     __global const float* AR4_Estimates, 
+								     __private int NUMBER_OF_VOXELS, 
+								     __private int DATA_T)
+{
+	int v = get_global_id(0);
+
+    if (v >= NUMBER_OF_VOXELS)
+        return;
+
+    int t = 0;
+	float old_value_1, old_value_2, old_value_3, old_value_4, old_value_5;
+    float4 alphas;
+	alphas.x = AR1_Estimates[v];
+    alphas.y = AR2_Estimates[v];
+    alphas.z = AR3_Estimates[v];
+    alphas.w = AR4_Estimates[v];
+
+    // Calculate the whitened timeseries
+    old_value_1 = Volumes[v + 0 * NUMBER_OF_VOXELS];	
+    Whitened_Volumes[v + 0 * NUMBER_OF_VOXELS] = old_value_1;
+    old_value_2 = Volumes[v + 1 * NUMBER_OF_VOXELS];
+    Whitened_Volumes[v + 1 * NUMBER_OF_VOXELS] = old_value_2  - alphas.x * old_value_1;
+    old_value_3 = Volumes[v + 2 * NUMBER_OF_VOXELS];
+    Whitened_Volumes[v + 2 * NUMBER_OF_VOXELS] = old_value_3 - alphas.x * old_value_2 - alphas.y * old_value_1;
+    old_value_4 = Volumes[v + 3 * NUMBER_OF_VOXELS];
+    Whitened_Volumes[v + 3 * NUMBER_OF_VOXELS] = old_value_4 - alphas.x * old_value_3 - alphas.y * old_value_2 - alphas.z * old_value_1;
+    
+    for (t = 4; t < DATA_T; t++)
+    {
+        old_value_5 = Volumes[v + t * NUMBER_OF_VOXELS];
+        Whitened_Volumes[v + t * NUMBER_OF_VOXELS] = old_value_5 - alphas.x * old_value_4 - alphas.y * old_value_3 - alphas.z * old_value_2 - alphas.w * old_value_1;
+        
+		// Save old values
+        old_value_1 = old_value_2;
+        old_value_2 = old_value_3;
+        old_value_3 = old_value_4;
+        old_value_4 = old_value_5;
+    }
+}
+
+
+// Generates permuted fMRI data for brain voxels stored in a compact layout as Volumes[v + t * NUMBER_OF_VOXELS], through inverse whitening
+__kernel void GeneratePermutedVolumesFirstLevelCompact(__global float* Permuted_fMRI_Volumes, 
+                                                       __global const float* Whitened_fMRI_Volumes, 
+												       __global const float* AR1_Estimates, 
+												       __global const float* AR2_Estimates, 
+												       __global const float* AR3_Estimates, 
+												       __global const float* AR4_Estimates, 
+												       __constant unsigned short int *c_Permutation_Vector, 
+												       __private int NUMBER_OF_VOXELS, 
+												       __private int DATA_T)
+{
+	int v = get_global_id(0);
+
+    if (v >= NUMBER_OF_VOXELS)
+        return;
+
+    int t = 0;
+	float old_value_1, old_value_2, old_value_3, old_value_4, old_value_5;
+	float4 alphas;
+	alphas.x = AR1_Estimates[v];
+    alphas.y = AR2_Estimates[v];
+    alphas.z = AR3_Estimates[v];
+    alphas.w = AR4_Estimates[v];
+
+    old_value_1 = Whitened_fMRI_Volumes[v + c_Permutation_Vector[0] * NUMBER_OF_VOXELS];
+	old_value_2 = alphas.x * old_value_1  + Whitened_fMRI_Volumes[v + c_Permutation_Vector[1] * NUMBER_OF_VOXELS];
+	old_value_3 = alphas.x * old_value_2  + alphas.y * old_value_1 + Whitened_fMRI_Volumes[v + c_Permutation_Vector[2] * NUMBER_OF_VOXELS];
+	old_value_4 = alphas.x * old_value_3  + alphas.y * old_value_2 + alphas.z * old_value_1 + Whitened_fMRI_Volumes[v + c_Permutation_Vector[3] * NUMBER_OF_VOXELS];
+
+    Permuted_fMRI_Volumes[v + 0 * NUMBER_OF_VOXELS] =  old_value_1;
+    Permuted_fMRI_Volumes[v + 1 * NUMBER_OF_VOXELS] =  old_value_2;
+    Permuted_fMRI_Volumes[v + 2 * NUMBER_OF_VOXELS] =  old_value_3;
+    Permuted_fMRI_Volumes[v + 3 * NUMBER_OF_VOXELS] =  old_value_4;
+
+    // Read the data in a permuted order and apply an inverse whitening transform
+    for (t = 4; t < DATA_T; t++)
+    {
+        // Calculate the unwhitened, permuted, timeseries
+        old_value_5 = alphas.x * old_value_4 + alphas.y * old_value_3 + alphas.z * old_value_2 + alphas.w * old_value_1 + Whitened_fMRI_Volumes[v + c_Permutation_Vector[t] * NUMBER_OF_VOXELS];
+			
+        Permuted_fMRI_Volumes[v + t * NUMBER_OF_VOXELS] = old_value_5;
+
+        // Save old values
+		old_value_1 = old_value_2;
+        old_value_2 = old_value_3;
+        old_value_3 = old_value_4;
+        old_value_4 = old_value_5;
+    }
+}
+